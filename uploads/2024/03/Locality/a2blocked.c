@@ -1,16 +1,23 @@
 #include <string.h>
+#include <assert.h>
 
 #include <a2blocked.h>
 #include "uarray2b.h"
+#include "blocktune.h"
+#include "uarray2b_pow2.h"
+#include "a2blocked_pow2.h"
+#include "threadpool.h"
+#include "memnode.h"
 #include <stdio.h>
 
 // define a private version of each function in A2Methods_T that we implement
 
 typedef A2Methods_UArray2 A2;   // private abbreviation
 
+/* the block edge suits this machine's caches; see blocktune.h */
 static A2 new(int width, int height, int size)
 {
-        return UArray2b_new_64K_block(width, height, size);
+        return UArray2b_new(width, height, size, BlockTune_blocksize(size));
 }
 
 static A2 new_with_blocksize(int width, int height, int size, int blocksize)
@@ -52,25 +59,61 @@ static void map_block_major(A2 array2, A2Methods_applyfun apply, void *cl)
         UArray2b_map(array2, (applyfun *) apply, cl);
 }
 
-struct small_closure {
-        A2Methods_smallapplyfun *apply;
-        void *cl;
+// the client's apply is called straight from the traversal loop
+static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
+                                  void *cl)
+{
+        UArray2b_small_map(a2, apply, cl);
+}
+
+typedef void blockapplyfun(int col, int row, int width, int height,
+                           void *elems, int colstride, int rowstride,
+                           UArray2b_T array2b, void *cl);
+
+static void map_blocks(A2 array2, A2Methods_blockapplyfun apply, void *cl)
+{
+        UArray2b_map_blocks(array2, (blockapplyfun *) apply, cl);
+}
+
+// one task per block; worker w hands its blocks cls[w]
+struct parallel_closure {
+        A2 array2;
+        applyfun *apply;
+        void **cls;
 };
 
-static void apply_small(int i, int j, UArray2b_T array2, void *elem, void *vcl)
+static void map_one_block(int n, int worker, void *vcl)
 {
-        struct small_closure *cl = vcl;
-        (void)i;
-        (void)j;
-        (void)array2;
-        cl->apply(elem, cl->cl);
+        struct parallel_closure *p = vcl;
+        UArray2b_map_block_range(p->array2, n, n + 1, p->apply,
+                                 p->cls[worker]);
 }
 
-static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
-                                  void *cl)
+static void map_block_major_parallel(A2 array2, A2Methods_applyfun apply,
+                                     void *cls[], int nthreads)
 {
-        struct small_closure mycl = { apply, cl };
-        UArray2b_map(a2, apply_small, &mycl);
+        struct parallel_closure p = { array2, (applyfun *) apply, cls };
+        ThreadPool_for(ThreadPool_shared(nthreads),
+                       UArray2b_blockcount(array2), nthreads,
+                       map_one_block, &p);
+}
+
+static int block_node(A2 array2, int i, int j)
+{
+        return MemNode_of(UArray2b_at(array2, i, j));
+}
+
+static A2 view(A2 array2, int i, int j, int width, int height)
+{
+        return UArray2b_view(array2, i, j, width, height);
+}
+
+// a cursor walks the blocks that map_blocks hands out, one at a time
+static int begin(A2 array2, A2Methods_Cursor *cursor)
+{
+        return A2Methods_begin_runs(array2, UArray2b_blockcount(array2),
+                                    (A2Methods_runfun *)UArray2b_block,
+                                    cursor);
 }
 
 static struct A2Methods_T uarray2_methods_blocked_struct = {
@@ -90,8 +133,107 @@ static struct A2Methods_T uarray2_methods_blocked_struct = {
         NULL,                   // small_map_col_major
         small_map_block_major,
         small_map_block_major,  // small_map_default
+        map_blocks,
+        NULL,                   // map_row_major_parallel
+        NULL,                   // map_col_major_parallel
+        map_block_major_parallel,
+        map_block_major_parallel, // map_default_parallel
+        NULL,                   // new_first_touch: blocks are separate mallocs
+        block_node,
+        view,
+        NULL,                   // map_recursive
+        NULL,                   // get
+        begin,
 };
 
 // finally the payoff: here is the exported pointer to the struct
 
 A2Methods_T uarray2_methods_blocked = &uarray2_methods_blocked_struct;
+
+/*
+ * Suites for power-of-two block edges. Each one shares the generic width,
+ * height, size, blocksize, free, map_blocks, parallel map, view and begin
+ * methods, and swaps in the accessor and maps that were compiled for its
+ * edge.
+ */
+#define A2BLOCKED_POW2(EDGE)                                                 \
+static A2 new##EDGE(int width, int height, int size)                         \
+{                                                                            \
+        return UArray2b_new(width, height, size, EDGE);                      \
+}                                                                            \
+                                                                             \
+static A2 new_with_blocksize##EDGE(int width, int height, int size,          \
+                                   int blocksize)                            \
+{                                                                            \
+        assert(blocksize == EDGE);                                           \
+        (void)blocksize;                                                     \
+        return UArray2b_new(width, height, size, EDGE);                      \
+}                                                                            \
+                                                                             \
+static A2Methods_Object *at##EDGE(A2 array2, int i, int j)                   \
+{                                                                            \
+        return UArray2b_at##EDGE(array2, i, j);                              \
+}                                                                            \
+                                                                             \
+static void map_block_major##EDGE(A2 array2, A2Methods_applyfun apply,       \
+                                  void *cl)                                  \
+{                                                                            \
+        UArray2b_map##EDGE(array2, (applyfun *) apply, cl);                  \
+}                                                                            \
+                                                                             \
+static void small_map_block_major##EDGE(A2 a2, A2Methods_smallapplyfun apply,\
+                                        void *cl)                            \
+{                                                                            \
+        UArray2b_small_map##EDGE(a2, apply, cl);                             \
+}                                                                            \
+                                                                             \
+static struct A2Methods_T uarray2_methods_blocked##EDGE##_struct = {         \
+        new##EDGE,                                                           \
+        new_with_blocksize##EDGE,                                            \
+        a2free,                                                              \
+        width,                                                               \
+        height,                                                              \
+        size,                                                                \
+        blocksize,                                                           \
+        at##EDGE,                                                            \
+        NULL,                                                                \
+        NULL,                                                                \
+        map_block_major##EDGE,                                               \
+        map_block_major##EDGE,                                               \
+        NULL,                                                                \
+        NULL,                                                                \
+        small_map_block_major##EDGE,                                         \
+        small_map_block_major##EDGE,                                         \
+        map_blocks,                                                          \
+        NULL,                                                                \
+        NULL,                                                                \
+        map_block_major_parallel,                                            \
+        map_block_major_parallel,                                            \
+        NULL,                                                                \
+        block_node,                                                          \
+        view,                                                                \
+        NULL,                   /* map_recursive */                          \
+        NULL,                   /* get */                                    \
+        begin,                                                               \
+};                                                                           \
+                                                                             \
+A2Methods_T uarray2_methods_blocked##EDGE =                                  \
+        &uarray2_methods_blocked##EDGE##_struct;
+
+A2BLOCKED_POW2(8)
+A2BLOCKED_POW2(16)
+A2BLOCKED_POW2(32)
+A2BLOCKED_POW2(64)
+
+#undef A2BLOCKED_POW2
+
+A2Methods_T uarray2_methods_blocked_pow2(int blocksize)
+{
+        switch (blocksize) {
+        case 8:  return uarray2_methods_blocked8;
+        case 16: return uarray2_methods_blocked16;
+        case 32: return uarray2_methods_blocked32;
+        case 64: return uarray2_methods_blocked64;
+        default: return NULL;
+        }
+}
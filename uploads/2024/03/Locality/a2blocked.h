@@ -0,0 +1,9 @@
+#ifndef A2BLOCKED_INCLUDED
+#define A2BLOCKED_INCLUDED
+
+#include "a2methods.h"
+
+/* methods for blocked UArray2bs; block-major maps only */
+extern A2Methods_T uarray2_methods_blocked;
+
+#endif
@@ -0,0 +1,25 @@
+/*
+ *     a2blocked_pow2.h
+ *     locality
+ *
+ *     Blocked A2Methods suites specialized for power-of-two block edges.
+ *     Every array created through one of these suites has exactly that
+ *     blocksize (it is a checked runtime error to pass new_with_blocksize
+ *     any other), and its at and map functions index with shifts and
+ *     masks.
+ */
+
+#ifndef A2BLOCKED_POW2_INCLUDED
+#define A2BLOCKED_POW2_INCLUDED
+
+#include "a2methods.h"
+
+extern A2Methods_T uarray2_methods_blocked8;
+extern A2Methods_T uarray2_methods_blocked16;
+extern A2Methods_T uarray2_methods_blocked32;
+extern A2Methods_T uarray2_methods_blocked64;
+
+/* the suite for the given edge, or NULL if it is not 8, 16, 32 or 64 */
+extern A2Methods_T uarray2_methods_blocked_pow2(int blocksize);
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ *     a2mapped.c
+ *     locality
+ *
+ *     Implementation of private methods on file-backed blocked arrays for
+ *     the A2Methods methods suite
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "a2mapped.h"
+#include "uarray2bmapped.h"
+
+typedef A2Methods_UArray2 A2;   // private abbreviation
+
+static A2 new(int width, int height, int size)
+{
+        return UArray2bMapped_new_64K_block(width, height, size);
+}
+
+static A2 new_with_blocksize(int width, int height, int size, int blocksize)
+{
+        return UArray2bMapped_new(width, height, size, blocksize);
+}
+
+static void a2free(A2 * array2p)
+{
+        UArray2bMapped_free((UArray2bMapped_T *) array2p);
+}
+
+static int width(A2 array2)
+{
+        return UArray2bMapped_width(array2);
+}
+static int height(A2 array2)
+{
+        return UArray2bMapped_height(array2);
+}
+static int size(A2 array2)
+{
+        return UArray2bMapped_size(array2);
+}
+static int blocksize(A2 array2)
+{
+        return UArray2bMapped_blocksize(array2);
+}
+
+static A2Methods_Object *at(A2 array2, int i, int j)
+{
+        return UArray2bMapped_at(array2, i, j);
+}
+
+typedef void applyfun(int i, int j, UArray2bMapped_T array2b, void *elem,
+                      void *cl);
+
+static void map_block_major(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+        UArray2bMapped_map(array2, (applyfun *) apply, cl);
+}
+
+struct small_closure {
+        A2Methods_smallapplyfun *apply;
+        void *cl;
+};
+
+static void apply_small(int i, int j, UArray2bMapped_T array2, void *elem,
+                        void *vcl)
+{
+        struct small_closure *cl = vcl;
+        (void)i;
+        (void)j;
+        (void)array2;
+        cl->apply(elem, cl->cl);
+}
+
+static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
+                                  void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        UArray2bMapped_map(a2, apply_small, &mycl);
+}
+
+typedef void blockapplyfun(int col, int row, int width, int height,
+                           void *elems, int colstride, int rowstride,
+                           UArray2bMapped_T array2b, void *cl);
+
+static void map_blocks(A2 array2, A2Methods_blockapplyfun apply, void *cl)
+{
+        UArray2bMapped_map_blocks(array2, (blockapplyfun *) apply, cl);
+}
+
+// a cursor walks the blocks that map_blocks hands out, one at a time
+static int begin(A2 array2, A2Methods_Cursor *cursor)
+{
+        return A2Methods_begin_runs(array2, UArray2bMapped_blockcount(array2),
+                                    (A2Methods_runfun *)UArray2bMapped_block,
+                                    cursor);
+}
+
+static struct A2Methods_T uarray2_methods_mapped_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        NULL,                   // map_row_major
+        NULL,                   // map_col_major
+        map_block_major,
+        map_block_major,        // map_default
+        NULL,                   // small_map_row_major
+        NULL,                   // small_map_col_major
+        small_map_block_major,
+        small_map_block_major,  // small_map_default
+        map_blocks,
+        NULL,                   // map_row_major_parallel
+        NULL,                   // map_col_major_parallel
+        NULL,                   // map_block_major_parallel
+        NULL,                   // map_default_parallel
+        NULL,                   // new_first_touch
+        NULL,                   // block_node
+        NULL,                   // view
+        NULL,                   // map_recursive
+        NULL,                   // get
+        begin,
+};
+
+// finally the payoff: here is the exported pointer to the struct
+
+A2Methods_T uarray2_methods_mapped = &uarray2_methods_mapped_struct;
+
+size_t a2mapped_threshold(void)
+{
+        const char *mb = getenv("A2MAPPED_THRESHOLD_MB");
+        if (mb != NULL && *mb != '\0') {
+                return (size_t)strtoull(mb, NULL, 10) << 20;
+        }
+        long pages = sysconf(_SC_PHYS_PAGES);
+        long page = sysconf(_SC_PAGESIZE);
+        if (pages <= 0 || page <= 0) {
+                return (size_t)-1;      /* unknown: never switch */
+        }
+        return (size_t)pages * (size_t)page / 2;
+}
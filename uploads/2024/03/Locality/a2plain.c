@@ -11,6 +11,8 @@
 
 #include <a2plain.h>
 #include "uarray2.h"
+#include "threadpool.h"
+#include "memnode.h"
 #include <stdio.h>
 typedef A2Methods_UArray2 A2;
 
@@ -209,35 +211,175 @@ static void map_col_major(A2Methods_UArray2 uarray2,
         UArray2_map_col_major(uarray2, (applyfun*)apply, cl);
 }
 
-struct small_closure {
-        A2Methods_smallapplyfun *apply; 
-        void                    *cl;
-};
-
-static void apply_small(int i, int j, UArray2_T uarray2,
-                        void *elem, void *vcl)
-{
-        struct small_closure *cl = vcl;
-        (void)i;
-        (void)j;
-        (void)uarray2;
-        cl->apply(elem, cl->cl);
-}
-
+// the client's apply is called straight from the traversal loop
 static void small_map_row_major(A2Methods_UArray2        a2,
                                 A2Methods_smallapplyfun  apply,
                                 void *cl)
 {
-        struct small_closure mycl = { apply, cl };
-        UArray2_map_row_major(a2, apply_small, &mycl);
+        UArray2_small_map_row_major(a2, apply, cl);
 }
 
 static void small_map_col_major(A2Methods_UArray2        a2,
                                 A2Methods_smallapplyfun  apply,
                                 void *cl)
 {
-        struct small_closure mycl = { apply, cl };
-        UArray2_map_col_major(a2, apply_small, &mycl);
+        UArray2_small_map_col_major(a2, apply, cl);
+}
+
+typedef void rowapplyfun(int col, int row, int width, int height,
+                         void *elems, int colstride, int rowstride,
+                         UArray2_T array2, void *cl);
+
+/*************map_blocks***********************************
+*
+* Traverses the UArray2 one row at a time and calls the apply function once
+* for each row with a pointer to its first element
+*
+* Parameters: A2Methods_UArray2 uarray2: a UArray2 that has been initialized 
+*          void apply: a function called with the origin of the row, its
+*          extent (width x 1), a pointer to its first element and the byte
+*          distance between neighbouring columns and rows
+*          void *cl: a closure statement for the map function 
+*
+* Return: nothing, but apply function affects elements of array and closure
+*
+*********************************************************************/
+static void map_blocks(A2Methods_UArray2 uarray2,
+                       A2Methods_blockapplyfun apply,
+                       void *cl)
+{
+        UArray2_map_rows(uarray2, (rowapplyfun *)apply, cl);
+}
+
+// a cursor walks the rows that map_blocks hands out, one at a time
+static int begin(A2Methods_UArray2 uarray2, A2Methods_Cursor *cursor)
+{
+        int rows = UArray2_width(uarray2) > 0 ? UArray2_height(uarray2) : 0;
+        return A2Methods_begin_runs(uarray2, rows,
+                                    (A2Methods_runfun *)UArray2_row_run,
+                                    cursor);
+}
+
+/* a parallel map hands out bands of rows or columns about this large */
+#define BAND_BYTES (64 * 1024)
+
+/*
+Closure shared by the tasks of a parallel map. Task n covers lines
+[n * band, (n + 1) * band) of the array, where a line is a row or a column,
+and worker w passes cls[w] to apply.
+*/
+struct parallel_closure {
+        A2 array2;
+        applyfun *apply;
+        void **cls;
+        int band;
+        int lines;
+};
+
+static void map_row_band(int n, int worker, void *vcl)
+{
+        struct parallel_closure *p = vcl;
+        int first = n * p->band;
+        int last = first + p->band < p->lines ? first + p->band : p->lines;
+        UArray2_map_row_band(p->array2, first, last, p->apply, p->cls[worker]);
+}
+
+static void map_col_band(int n, int worker, void *vcl)
+{
+        struct parallel_closure *p = vcl;
+        int first = n * p->band;
+        int last = first + p->band < p->lines ? first + p->band : p->lines;
+        UArray2_map_col_band(p->array2, first, last, p->apply, p->cls[worker]);
+}
+
+/*************map_parallel***********************************
+*
+* Splits a row-major or column-major traversal of the UArray2 into bands of
+* whole rows or columns and maps the bands on nthreads workers
+*
+* Parameters: A2Methods_UArray2 uarray2: a UArray2 that has been initialized 
+*          void apply: the function called for each element
+*          void *cls[]: one closure per worker
+*          int nthreads: the number of workers
+*          int lines: the number of rows or columns to split
+*          int lineBytes: the bytes in one row or column
+*          void band: maps one band, either map_row_band or map_col_band
+*
+* Return: nothing, but apply function affects elements of array and closures
+*
+*********************************************************************/
+static void map_parallel(A2Methods_UArray2 uarray2, A2Methods_applyfun apply,
+                         void *cls[], int nthreads, int lines, int lineBytes,
+                         void band(int n, int worker, void *cl))
+{
+        struct parallel_closure p = { uarray2, (applyfun *)apply, cls, 1,
+                                      lines };
+        if (lineBytes > 0 && lineBytes < BAND_BYTES) {
+                p.band = BAND_BYTES / lineBytes;
+        }
+        ThreadPool_for(ThreadPool_shared(nthreads),
+                       (lines + p.band - 1) / p.band, nthreads, band, &p);
+}
+
+static void map_row_major_parallel(A2Methods_UArray2 uarray2,
+                                   A2Methods_applyfun apply,
+                                   void *cls[], int nthreads)
+{
+        map_parallel(uarray2, apply, cls, nthreads, UArray2_height(uarray2),
+                     UArray2_width(uarray2) * UArray2_size(uarray2),
+                     map_row_band);
+}
+
+static void map_col_major_parallel(A2Methods_UArray2 uarray2,
+                                   A2Methods_applyfun apply,
+                                   void *cls[], int nthreads)
+{
+        map_parallel(uarray2, apply, cls, nthreads, UArray2_width(uarray2),
+                     UArray2_height(uarray2) * UArray2_size(uarray2),
+                     map_col_band);
+}
+
+static int block_node(A2Methods_UArray2 uarray2, int col, int row)
+{
+        return MemNode_of(UArray2_at(uarray2, col, row));
+}
+
+/*************view******************************************************
+*
+* Function that makes a window onto part of a UArray2 without copying it
+*
+* Parameters: A2Methods_UArray2 uarray2: a UArray2 or a view of one
+*             int col, row: the cell of uarray2 that becomes (0, 0)
+*             int width, height: the dimensions of the window
+*
+* Return: a UArray2 sharing uarray2's rows
+*
+* Expects: the window lies inside uarray2
+*
+*********************************************************************/
+static A2 view(A2Methods_UArray2 uarray2, int col, int row, int width,
+               int height)
+{
+        return UArray2_view(uarray2, col, row, width, height);
+}
+
+/*************map_recursive*********************************************
+*
+* Function that maps through a UArray2 in a cache-oblivious order, one
+* quadrant at a time
+*
+* Parameters: A2Methods_UArray2 uarray2: the UArray2 to be mapped
+*             A2Methods_applyfun apply: apply function to be called on each
+*                   element
+*             void *cl: closure variable
+*
+* Return: nothing, but apply affects elements of the array and closure
+*
+*********************************************************************/
+static void map_recursive(A2Methods_UArray2 uarray2, A2Methods_applyfun apply,
+                          void *cl)
+{
+        UArray2_map_recursive(uarray2, (UArray2_applyfun *)apply, cl);
 }
 
 /*
@@ -261,6 +403,17 @@ static struct A2Methods_T uarray2_methods_plain_struct = {
         small_map_col_major,
         NULL,
         small_map_row_major, /*small map default*/
+        map_blocks,
+        map_row_major_parallel,
+        map_col_major_parallel,
+        NULL,
+        map_row_major_parallel, /*default parallel mapping*/
+        NULL,
+        block_node,
+        view,
+        map_recursive,
+        NULL,                   /* get */
+        begin,
 };
 
 // finally the payoff: here is the exported pointer to the struct
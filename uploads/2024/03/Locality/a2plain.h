@@ -0,0 +1,9 @@
+#ifndef A2PLAIN_INCLUDED
+#define A2PLAIN_INCLUDED
+
+#include "a2methods.h"
+
+/* methods for plain, unblocked UArray2s; no block-major map */
+extern A2Methods_T uarray2_methods_plain;
+
+#endif
@@ -0,0 +1,188 @@
+/*
+ *     a2slab.c
+ *     locality
+ *
+ *     Implementation of private methods on slab-backed blocked arrays for the
+ *     A2Methods methods suite
+ */
+
+#include <stddef.h>
+
+#include "a2slab.h"
+#include "uarray2bslab.h"
+#include "threadpool.h"
+#include "memnode.h"
+
+typedef A2Methods_UArray2 A2;   // private abbreviation
+
+static A2 new(int width, int height, int size)
+{
+        return UArray2bSlab_new_64K_block(width, height, size);
+}
+
+static A2 new_with_blocksize(int width, int height, int size, int blocksize)
+{
+        return UArray2bSlab_new(width, height, size, blocksize);
+}
+
+static void a2free(A2 * array2p)
+{
+        UArray2bSlab_free((UArray2bSlab_T *) array2p);
+}
+
+static int width(A2 array2)
+{
+        return UArray2bSlab_width(array2);
+}
+static int height(A2 array2)
+{
+        return UArray2bSlab_height(array2);
+}
+static int size(A2 array2)
+{
+        return UArray2bSlab_size(array2);
+}
+static int blocksize(A2 array2)
+{
+        return UArray2bSlab_blocksize(array2);
+}
+
+static A2Methods_Object *at(A2 array2, int i, int j)
+{
+        return UArray2bSlab_at(array2, i, j);
+}
+
+typedef void applyfun(int i, int j, UArray2bSlab_T array2b, void *elem,
+                      void *cl);
+
+static void map_block_major(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+        UArray2bSlab_map(array2, (applyfun *) apply, cl);
+}
+
+struct small_closure {
+        A2Methods_smallapplyfun *apply;
+        void *cl;
+};
+
+static void apply_small(int i, int j, UArray2bSlab_T array2, void *elem,
+                        void *vcl)
+{
+        struct small_closure *cl = vcl;
+        (void)i;
+        (void)j;
+        (void)array2;
+        cl->apply(elem, cl->cl);
+}
+
+static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
+                                  void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        UArray2bSlab_map(a2, apply_small, &mycl);
+}
+
+typedef void blockapplyfun(int col, int row, int width, int height,
+                           void *elems, int colstride, int rowstride,
+                           UArray2bSlab_T array2b, void *cl);
+
+static void map_blocks(A2 array2, A2Methods_blockapplyfun apply, void *cl)
+{
+        UArray2bSlab_map_blocks(array2, (blockapplyfun *) apply, cl);
+}
+
+// one task per block; worker w hands its blocks cls[w]
+struct parallel_closure {
+        A2 array2;
+        applyfun *apply;
+        void **cls;
+};
+
+static void map_one_block(int n, int worker, void *vcl)
+{
+        struct parallel_closure *p = vcl;
+        UArray2bSlab_map_block_range(p->array2, n, n + 1, p->apply,
+                                     p->cls[worker]);
+}
+
+// a first-touch slab is split as it was cleared, so each block is mapped on
+// the CPU whose node holds it; any other slab is balanced by stealing
+static void map_block_major_parallel(A2 array2, A2Methods_applyfun apply,
+                                     void *cls[], int nthreads)
+{
+        struct parallel_closure p = { array2, (applyfun *) apply, cls };
+        ThreadPool_T pool = ThreadPool_shared(nthreads);
+        int nblocks = UArray2bSlab_blockcount(array2);
+        if (UArray2bSlab_touchers(array2) == nthreads) {
+                ThreadPool_for_static(pool, nblocks, nthreads, map_one_block,
+                                      &p);
+        } else {
+                ThreadPool_for(pool, nblocks, nthreads, map_one_block, &p);
+        }
+}
+
+static void clear_one_block(int n, int worker, void *array2)
+{
+        (void)worker;
+        UArray2bSlab_clear_block_range(array2, n, n + 1);
+}
+
+// the clearing job and later parallel maps with the same nthreads share one
+// static split, and the pool keeps each worker on one CPU
+static A2 new_first_touch(int width, int height, int size, int nthreads)
+{
+        UArray2bSlab_T array = UArray2bSlab_new_unzeroed(width, height, size,
+                                        UArray2bSlab_blocksize_64K(size));
+        ThreadPool_for_static(ThreadPool_shared(nthreads),
+                              UArray2bSlab_blockcount(array), nthreads,
+                              clear_one_block, array);
+        UArray2bSlab_set_touchers(array, nthreads);
+        return array;
+}
+
+static int block_node(A2 array2, int i, int j)
+{
+        return MemNode_of(UArray2bSlab_at(array2, i, j));
+}
+
+// a cursor walks the blocks that map_blocks hands out, one at a time
+static int begin(A2 array2, A2Methods_Cursor *cursor)
+{
+        return A2Methods_begin_runs(array2, UArray2bSlab_blockcount(array2),
+                                    (A2Methods_runfun *)UArray2bSlab_block,
+                                    cursor);
+}
+
+static struct A2Methods_T uarray2_methods_slab_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        NULL,                   // map_row_major
+        NULL,                   // map_col_major
+        map_block_major,
+        map_block_major,        // map_default
+        NULL,                   // small_map_row_major
+        NULL,                   // small_map_col_major
+        small_map_block_major,
+        small_map_block_major,  // small_map_default
+        map_blocks,
+        NULL,                   // map_row_major_parallel
+        NULL,                   // map_col_major_parallel
+        map_block_major_parallel,
+        map_block_major_parallel, // map_default_parallel
+        new_first_touch,
+        block_node,
+        NULL,                   // view
+        NULL,                   // map_recursive
+        NULL,                   // get
+        begin,
+};
+
+// finally the payoff: here is the exported pointer to the struct
+
+A2Methods_T uarray2_methods_slab = &uarray2_methods_slab_struct;
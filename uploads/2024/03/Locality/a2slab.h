@@ -0,0 +1,17 @@
+/*
+ *     a2slab.h
+ *     locality
+ *
+ *     A2Methods suite for blocked arrays stored in one contiguous slab
+ *     (see uarray2bslab.h). Supports the same operations as
+ *     uarray2_methods_blocked: block-major mapping only.
+ */
+
+#ifndef A2SLAB_INCLUDED
+#define A2SLAB_INCLUDED
+
+#include "a2methods.h"
+
+extern A2Methods_T uarray2_methods_slab;
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ *     a2sparse.c
+ *     locality
+ *
+ *     Implementation of private methods on lazily allocated blocked arrays
+ *     for the A2Methods methods suite
+ */
+
+#include <stddef.h>
+
+#include "a2sparse.h"
+#include "uarray2bsparse.h"
+#include "blocktune.h"
+#include "threadpool.h"
+
+typedef A2Methods_UArray2 A2;   // private abbreviation
+
+static A2 new(int width, int height, int size)
+{
+        return UArray2bSparse_new(width, height, size,
+                                  BlockTune_blocksize(size));
+}
+
+static A2 new_with_blocksize(int width, int height, int size, int blocksize)
+{
+        return UArray2bSparse_new(width, height, size, blocksize);
+}
+
+static void a2free(A2 * array2p)
+{
+        UArray2bSparse_free((UArray2bSparse_T *) array2p);
+}
+
+static int width(A2 array2)
+{
+        return UArray2bSparse_width(array2);
+}
+static int height(A2 array2)
+{
+        return UArray2bSparse_height(array2);
+}
+static int size(A2 array2)
+{
+        return UArray2bSparse_size(array2);
+}
+static int blocksize(A2 array2)
+{
+        return UArray2bSparse_blocksize(array2);
+}
+
+static A2Methods_Object *at(A2 array2, int i, int j)
+{
+        return UArray2bSparse_at(array2, i, j);
+}
+
+static const A2Methods_Object *get(A2 array2, int i, int j)
+{
+        return UArray2bSparse_get(array2, i, j);
+}
+
+typedef void applyfun(int i, int j, UArray2bSparse_T array2b, void *elem,
+                      void *cl);
+
+static void map_block_major(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+        UArray2bSparse_map(array2, (applyfun *) apply, cl);
+}
+
+struct small_closure {
+        A2Methods_smallapplyfun *apply;
+        void *cl;
+};
+
+static void apply_small(int i, int j, UArray2bSparse_T array2, void *elem,
+                        void *vcl)
+{
+        struct small_closure *cl = vcl;
+        (void)i;
+        (void)j;
+        (void)array2;
+        cl->apply(elem, cl->cl);
+}
+
+static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
+                                  void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        UArray2bSparse_map(a2, apply_small, &mycl);
+}
+
+// one task per block, so no two workers ever make or settle the same block
+struct parallel_closure {
+        A2 array2;
+        applyfun *apply;
+        void **cls;
+};
+
+static void map_one_block(int n, int worker, void *vcl)
+{
+        struct parallel_closure *p = vcl;
+        UArray2bSparse_map_block_range(p->array2, n, n + 1, p->apply,
+                                       p->cls[worker]);
+}
+
+static void map_block_major_parallel(A2 array2, A2Methods_applyfun apply,
+                                     void *cls[], int nthreads)
+{
+        struct parallel_closure p = { array2, (applyfun *) apply, cls };
+        ThreadPool_for(ThreadPool_shared(nthreads),
+                       UArray2bSparse_blockcount(array2), nthreads,
+                       map_one_block, &p);
+}
+
+// a cursor walks unmade blocks in scratch, as the maps do, so reading
+// through it makes nothing
+static int begin(A2 array2, A2Methods_Cursor *cursor)
+{
+        return A2Methods_begin_runs(array2, UArray2bSparse_blockcount(array2),
+                                    (A2Methods_runfun *)UArray2bSparse_block,
+                                    cursor);
+}
+
+static struct A2Methods_T uarray2_methods_sparse_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        NULL,                   // map_row_major
+        NULL,                   // map_col_major
+        map_block_major,
+        map_block_major,        // map_default
+        NULL,                   // small_map_row_major
+        NULL,                   // small_map_col_major
+        small_map_block_major,
+        small_map_block_major,  // small_map_default
+        NULL,                   // map_blocks
+        NULL,                   // map_row_major_parallel
+        NULL,                   // map_col_major_parallel
+        map_block_major_parallel,
+        map_block_major_parallel, // map_default_parallel
+        NULL,                   // new_first_touch
+        NULL,                   // block_node
+        NULL,                   // view
+        NULL,                   // map_recursive
+        get,
+        begin,
+};
+
+// finally the payoff: here is the exported pointer to the struct
+
+A2Methods_T uarray2_methods_sparse = &uarray2_methods_sparse_struct;
@@ -0,0 +1,18 @@
+/*
+ *     a2sparse.h
+ *     locality
+ *
+ *     A2Methods suite for blocked arrays whose blocks are made on first
+ *     write (see uarray2bsparse.h). Supports block-major mapping only, like
+ *     uarray2_methods_blocked, and offers get, so code that reads through
+ *     the suite leaves blocks that were never written unmade.
+ */
+
+#ifndef A2SPARSE_INCLUDED
+#define A2SPARSE_INCLUDED
+
+#include "a2methods.h"
+
+extern A2Methods_T uarray2_methods_sparse;
+
+#endif
@@ -1,18 +1,54 @@
+/* the checks below are asserts, so make fast must not compile them out */
+#undef NDEBUG
+
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include "assert.h"
 #include "a2methods.h"
 #include "a2plain.h"
 #include "a2blocked.h"
+#include "a2slab.h"
+#include "a2tiled.h"
+#include "a2blocked_pow2.h"
+#include "a2zorder.h"
+#include "a2mapped.h"
+#include "a2sparse.h"
+#include "uarray2bsparse.h"
+#include "uarray2bmapped.h"
+#include "bigalloc.h"
+#include "memnode.h"
 
 
 #define W 13
 #define H 15
 #define BS 4
 
+/* big enough that the storage is mapped from the kernel */
+#define BIG_W 1031
+#define BIG_H 611
+
+/* wider than one 64K block of struct rgb, so conversions see edge blocks */
+#define CW 300
+#define CH 200
+
+struct rgb {
+        unsigned red, green, blue;
+};
+
 static A2Methods_T methods;
 typedef A2Methods_UArray2 A2;
 
+/* BS, except for a power-of-two suite, which takes only its own edge */
+static int blocksize_for(A2Methods_T m)
+{
+        for (int edge = 8; edge <= 64; edge *= 2)
+                if (m == uarray2_methods_blocked_pow2(edge))
+                        return edge;
+        return BS;
+}
+
 static void check_and_increment(int i, int j, A2 a, void *elem, void *cl) 
 {
         (void)i;
@@ -37,7 +73,8 @@ static void small_check_and_increment(void *elem, void *cl)
 static void double_row_major_plus()
 {
         /* store increasing integers in row-major order */
-        A2 array = methods->new_with_blocksize(W, H, sizeof(int), BS);
+        A2 array = methods->new_with_blocksize(W, H, sizeof(int),
+                                               blocksize_for(methods));
         int counter = 1;
         for (int j = 0; j < H; j++) { 
                 for (int i = 0; i < W; i++) { /* col index varies faster */
@@ -120,6 +157,211 @@ static inline void copy_unsigned(A2Methods_T methods, A2 a,
         *p = n;
 }
 
+/* checks every cell of a run against 1000 * i + j and counts the cells */
+static void check_run(int col, int row, int width, int height, void *elems,
+                      int colstride, int rowstride, A2 a, void *cl)
+{
+        int *cells = cl;
+        assert(col >= 0 && row >= 0);
+        assert(col + width <= methods->width(a));
+        assert(row + height <= methods->height(a));
+        for (int j = 0; j < height; j++) {
+                for (int i = 0; i < width; i++) {
+                        unsigned *p = (unsigned *)((char *)elems
+                                                   + i * colstride
+                                                   + j * rowstride);
+                        assert(p == methods->at(a, col + i, row + j));
+                        assert(*p == 1000u * (col + i) + row + j);
+                }
+        }
+        *cells += width * height;
+}
+
+/* checks one cell against 1000 * i + j and counts it in this worker's total */
+static void check_and_count(int i, int j, A2 a, void *elem, void *cl)
+{
+        (void)a;
+        assert(*(unsigned *)elem == 1000u * i + j);
+        *(int *)cl += 1;
+}
+
+#define NTHREADS 3
+
+/* every parallel map must visit each cell exactly once across workers */
+static void check_parallel(A2 array, A2Methods_parallelmapfun *map)
+{
+        if (map == NULL)
+                return;
+        int counts[NTHREADS] = { 0 };
+        void *cls[NTHREADS];
+        for (int w = 0; w < NTHREADS; w++)
+                cls[w] = &counts[w];
+        map(array, check_and_count, cls, NTHREADS);
+        int cells = 0;
+        for (int w = 0; w < NTHREADS; w++)
+                cells += counts[w];
+        assert(cells == methods->width(array) * methods->height(array));
+}
+
+/*
+ * 3 workers of 32 blocks of 128 x 128 unsigneds each: every worker's share
+ * of a first-touch slab is then a whole number of 2 MB pages, so even with
+ * transparent huge pages no page is shared by two workers
+ */
+#define FT_W 1536
+#define FT_H 1024
+
+/* what a worker of a first-touch map knows: its number and the blocks */
+struct toucher {
+        int worker;
+        int blocksWide, nblocks;
+};
+
+/* checks that the block of an origin cell is in this worker's share of the
+   static split, and that its pages are on the node the worker runs on */
+static void check_placement(int i, int j, A2 a, void *elem, void *cl)
+{
+        struct toucher *t = cl;
+        int bs = methods->blocksize(a);
+        assert(*(unsigned *)elem == 0);
+        if (i % bs != 0 || j % bs != 0)
+                return;
+        int n = j / bs * t->blocksWide + i / bs;
+        assert((long)t->nblocks * t->worker / NTHREADS <= n);
+        assert(n < (long)t->nblocks * (t->worker + 1) / NTHREADS);
+        int here = MemNode_current();
+        int there = methods->block_node(a, i, j);
+        assert(here < 0 || there < 0 || here == there);
+}
+
+/* a first-touch array starts zeroed, and its parallel map hands each block
+   to the worker that cleared it */
+static void check_first_touch(void)
+{
+        if (methods->new_first_touch == NULL)
+                return;
+        assert(methods->block_node != NULL);
+        A2 touched = methods->new_first_touch(FT_W, FT_H, sizeof(unsigned),
+                                              NTHREADS);
+        int bs = methods->blocksize(touched);
+        int blocksWide = (FT_W + bs - 1) / bs;
+        int blocksHigh = (FT_H + bs - 1) / bs;
+        struct toucher touchers[NTHREADS];
+        void *cls[NTHREADS];
+        for (int w = 0; w < NTHREADS; w++) {
+                touchers[w] = (struct toucher){ w, blocksWide,
+                                                blocksWide * blocksHigh };
+                cls[w] = &touchers[w];
+        }
+        methods->map_default_parallel(touched, check_placement, cls,
+                                      NTHREADS);
+        methods->free(&touched);
+}
+
+/* the cells of an array in the order map_default visits them */
+struct visit_order {
+        int cells;
+        int col[W * H], row[W * H];
+};
+
+static void record_cell(int i, int j, A2 a, void *elem, void *cl)
+{
+        struct visit_order *order = cl;
+        (void)a;
+        (void)elem;
+        order->col[order->cells] = i;
+        order->row[order->cells] = j;
+        order->cells++;
+}
+
+/* a cursor visits the cells in map_default's order and keeps col, row and
+   ptr in agreement */
+static void check_cursor(A2 array)
+{
+        if (methods->begin == NULL)
+                return;
+        struct visit_order order = { 0, { 0 }, { 0 } };
+        methods->map_default(array, record_cell, &order);
+
+        A2Methods_Cursor c;
+        int cells = 0;
+        for (int more = methods->begin(array, &c); more;
+             more = A2Methods_next(&c)) {
+                assert(cells < order.cells);
+                assert(c.col == order.col[cells] && c.row == order.row[cells]);
+                assert(c.ptr == methods->at(array, c.col, c.row));
+                assert(*(unsigned *)c.ptr == 1000u * c.col + c.row);
+                cells++;
+        }
+        assert(cells == order.cells);
+}
+
+/* cursors on an array and on a new one like it move in lockstep; a view is
+   not like a new array, since its blocks are cut off where the view is */
+static void check_lockstep(A2 array)
+{
+        if (methods->begin == NULL)
+                return;
+        int w = methods->width(array), h = methods->height(array);
+        A2 copy = methods->new_with_blocksize(w, h, sizeof(unsigned),
+                                              methods->blocksize(array));
+        A2Methods_Cursor s, d;
+        for (int more = methods->begin(array, &s) && methods->begin(copy, &d);
+             more; more = A2Methods_next(&s) && A2Methods_next(&d)) {
+                assert(s.col == d.col && s.row == d.row);
+                *(unsigned *)d.ptr = *(unsigned *)s.ptr;
+        }
+        for (int i = 0; i < w; i++)
+                for (int j = 0; j < h; j++)
+                        check(copy, i, j, 1000 * i + j);
+        methods->free(&copy);
+}
+
+/* the window check_view looks through, away from every edge */
+#define VX 3
+#define VY 2
+#define VW 7
+#define VH 9
+
+/* a view sees, and writes through to, exactly its window of the array */
+static void check_view(A2 array)
+{
+        if (methods->view == NULL)
+                return;
+        A2 view = methods->view(array, VX, VY, VW, VH);
+        assert(methods->width(view) == VW && methods->height(view) == VH);
+        for (int i = 0; i < VW; i++)
+                for (int j = 0; j < VH; j++)
+                        copy_unsigned(methods, view, i, j, 1000 * i + j);
+
+        int cells = 0;
+        methods->map_default(view, check_and_count, &cells);
+        assert(cells == VW * VH);
+        if (methods->map_blocks) {
+                cells = 0;
+                methods->map_blocks(view, check_run, &cells);
+                assert(cells == VW * VH);
+        }
+        check_parallel(view, methods->map_default_parallel);
+        check_cursor(view);
+
+        A2 inner = methods->view(view, 1, 2, VW - 2, VH - 3);
+        check(inner, 0, 0, 1000 * 1 + 2);
+        check(inner, VW - 3, VH - 4, 1000 * (VW - 2) + VH - 2);
+        methods->free(&inner);
+        methods->free(&view);
+
+        for (int i = 0; i < W; i++) {
+                for (int j = 0; j < H; j++) {
+                        bool inside = i >= VX && i < VX + VW
+                                      && j >= VY && j < VY + VH;
+                        check(array, i, j, inside ? 1000 * (i - VX) + j - VY
+                                                  : 1000 * i + j);
+                        copy_unsigned(methods, array, i, j, 1000 * i + j);
+                }
+        }
+}
+
 static void test_methods(A2Methods_T methods_under_test) 
 {
         methods = methods_under_test;
@@ -135,7 +377,8 @@ static void test_methods(A2Methods_T methods_under_test)
         if (!(has_plain_methods(methods) || has_blocked_methods(methods)))
                 fprintf(stderr, "Some full mapping methods are missing\n");
 
-        A2 array = methods->new_with_blocksize(W, H, sizeof(unsigned), BS);
+        A2 array = methods->new_with_blocksize(W, H, sizeof(unsigned),
+                                               blocksize_for(methods));
         copy_unsigned(methods, array,  2,  1, 99);
         copy_unsigned(methods, array,  3,  3, 88);
         copy_unsigned(methods, array, 10, 10, 77);
@@ -157,16 +400,379 @@ static void test_methods(A2Methods_T methods_under_test)
                         assert(*p == n);
                 }
         }
+        if (methods->map_blocks) {
+                int cells = 0;
+                methods->map_blocks(array, check_run, &cells);
+                assert(cells == W * H);
+        }
+        if (methods->map_recursive) {
+                int cells = 0;
+                methods->map_recursive(array, check_and_count, &cells);
+                assert(cells == W * H);
+        }
+        check_parallel(array, methods->map_row_major_parallel);
+        check_parallel(array, methods->map_col_major_parallel);
+        check_parallel(array, methods->map_block_major_parallel);
+        check_parallel(array, methods->map_default_parallel);
+        check_cursor(array);
+        check_lockstep(array);
+        check_view(array);
+        check_first_touch();
         double_row_major_plus();
         methods->free(&array);
 }
 
+/* Z-order cursors on arrays wider than high, higher than wide and one cell
+   across, where the quads are laid out differently from W x H */
+static void check_zorder_shapes(void)
+{
+        static const int shapes[][2] = {
+                { 15, 5 }, { 5, 15 }, { 1, 13 }, { 13, 1 }, { 1, 1 }
+        };
+        methods = uarray2_methods_zorder;
+        for (size_t k = 0; k < sizeof(shapes) / sizeof(shapes[0]); k++) {
+                int w = shapes[k][0], h = shapes[k][1];
+                A2 array = methods->new(w, h, sizeof(unsigned));
+                for (int i = 0; i < w; i++)
+                        for (int j = 0; j < h; j++)
+                                copy_unsigned(methods, array, i, j,
+                                              1000 * i + j);
+                check_cursor(array);
+                check_lockstep(array);
+                methods->free(&array);
+        }
+}
+
+/* a large array starts zeroed and keeps what is written at its far end */
+static void check_big(A2Methods_T methods)
+{
+        A2 array = methods->new(BIG_W, BIG_H, sizeof(unsigned));
+        unsigned *first = methods->at(array, 0, 0);
+        unsigned *last = methods->at(array, BIG_W - 1, BIG_H - 1);
+        assert(*first == 0 && *last == 0);
+        *first = 1;
+        *last = 2;
+        assert(*(unsigned *)methods->at(array, 0, 0) == 1);
+        assert(*(unsigned *)methods->at(array, BIG_W - 1, BIG_H - 1) == 2);
+        methods->free(&array);
+}
+
+/* reading through get makes no blocks; writing one cell makes one */
+/* adds up the cells it is given and counts them */
+struct sum_closure {
+        unsigned sum;
+        int cells;
+};
+
+static void sum_cell(int i, int j, A2 array, void *elem, void *cl)
+{
+        (void)i; (void)j; (void)array;
+        struct sum_closure *scl = cl;
+        scl->sum += *(unsigned *)elem;
+        scl->cells++;
+}
+
+static void sum_small(void *elem, void *cl)
+{
+        sum_cell(0, 0, NULL, elem, cl);
+}
+
+static void sum_sparse(int i, int j, UArray2bSparse_T array, void *elem,
+                       void *cl)
+{
+        sum_cell(i, j, array, elem, cl);
+}
+
+/* writes 5 to the cell at the origin only */
+static void mark_origin(int i, int j, A2 array, void *elem, void *cl)
+{
+        (void)array; (void)cl;
+        if (i == 0 && j == 0)
+                *(unsigned *)elem = 5;
+}
+
+/* maps and cursors that only read a sparse array make none of its blocks,
+   and keep a block only once something is written to it */
+static void check_sparse_maps(void)
+{
+        A2Methods_T sparse = uarray2_methods_sparse;
+        A2 array = sparse->new_with_blocksize(BIG_W, BIG_H, sizeof(unsigned),
+                                              BS);
+        *(unsigned *)sparse->at(array, BIG_W - 1, BIG_H - 1) = 3;
+        assert(UArray2bSparse_madecount(array) == 1);
+
+        struct sum_closure scl = { 0, 0 };
+        sparse->map_default(array, sum_cell, &scl);
+        assert(scl.sum == 3 && scl.cells == BIG_W * BIG_H);
+        assert(UArray2bSparse_madecount(array) == 1);
+
+        scl = (struct sum_closure){ 0, 0 };
+        sparse->small_map_default(array, sum_small, &scl);
+        assert(scl.sum == 3 && scl.cells == BIG_W * BIG_H);
+        assert(UArray2bSparse_madecount(array) == 1);
+
+        struct sum_closure per[NTHREADS] = { { 0, 0 } };
+        void *cls[NTHREADS];
+        for (int t = 0; t < NTHREADS; t++)
+                cls[t] = &per[t];
+        sparse->map_default_parallel(array, sum_cell, cls, NTHREADS);
+        scl = (struct sum_closure){ 0, 0 };
+        for (int t = 0; t < NTHREADS; t++) {
+                scl.sum += per[t].sum;
+                scl.cells += per[t].cells;
+        }
+        assert(scl.sum == 3 && scl.cells == BIG_W * BIG_H);
+        assert(UArray2bSparse_madecount(array) == 1);
+
+        A2Methods_Cursor c;
+        scl = (struct sum_closure){ 0, 0 };
+        for (int more = sparse->begin(array, &c); more;
+             more = A2Methods_next(&c))
+                sum_cell(c.col, c.row, array, c.ptr, &scl);
+        assert(scl.sum == 3 && scl.cells == BIG_W * BIG_H);
+        assert(UArray2bSparse_madecount(array) == 1);
+
+        /* map_made sees only the corner block, clipped by the edges */
+        scl = (struct sum_closure){ 0, 0 };
+        UArray2bSparse_map_made(array, sum_sparse, &scl);
+        assert(scl.sum == 3
+               && scl.cells == (BIG_W - (BIG_W - 1) / BS * BS)
+                               * (BIG_H - (BIG_H - 1) / BS * BS));
+
+        /* a map that writes makes the block it writes to, and only that */
+        sparse->map_default(array, mark_origin, NULL);
+        assert(UArray2bSparse_madecount(array) == 2);
+        assert(*(const unsigned *)sparse->get(array, 0, 0) == 5);
+
+        /* so does a cursor, once anything looks at the array again */
+        for (int more = sparse->begin(array, &c); more;
+             more = A2Methods_next(&c)) {
+                if (c.col == BS && c.row == BS)
+                        *(unsigned *)c.ptr = 7;
+        }
+        assert(*(const unsigned *)sparse->get(array, BS, BS) == 7);
+        assert(UArray2bSparse_madecount(array) == 3);
+        scl = (struct sum_closure){ 0, 0 };
+        UArray2bSparse_map_made(array, sum_sparse, &scl);
+        assert(scl.sum == 3 + 5 + 7);
+        sparse->free(&array);
+}
+
+static void check_sparse(void)
+{
+        A2Methods_T sparse = uarray2_methods_sparse;
+        A2 array = sparse->new_with_blocksize(BIG_W, BIG_H, sizeof(unsigned),
+                                              BS);
+        for (int i = 0; i < BIG_W; i += 7) {
+                for (int j = 0; j < BIG_H; j += 5) {
+                        assert(*(const unsigned *)sparse->get(array, i, j)
+                               == 0);
+                }
+        }
+        assert(UArray2bSparse_madecount(array) == 0);
+        *(unsigned *)sparse->at(array, BIG_W - 1, BIG_H - 1) = 3;
+        assert(UArray2bSparse_madecount(array) == 1);
+        assert(*(const unsigned *)sparse->get(array, BIG_W - 1, BIG_H - 1)
+               == 3);
+        assert(*(const unsigned *)sparse->get(array, 0, 0) == 0);
+        assert(UArray2bSparse_madecount(array) == 1);
+        sparse->free(&array);
+}
+
+/* a saved array loads back with its cells and tag, and writing to the
+   loaded copy leaves the file alone; other files are not snapshots */
+static void check_snapshot(void)
+{
+        UArray2bMapped_T array = UArray2bMapped_new(W, H, sizeof(unsigned),
+                                                    BS);
+        for (int i = 0; i < W; i++) {
+                for (int j = 0; j < H; j++) {
+                        *(unsigned *)UArray2bMapped_at(array, i, j)
+                                = i * 1000 + j;
+                }
+        }
+        FILE *fp = tmpfile();
+        assert(fp != NULL);
+        unsigned tag = 0;
+        assert(UArray2bMapped_load(fp, &tag) == NULL);
+        assert(UArray2bMapped_save(array, 255, fp));
+        UArray2bMapped_free(&array);
+
+        for (int pass = 0; pass < 2; pass++) {
+                UArray2bMapped_T loaded = UArray2bMapped_load(fp, &tag);
+                assert(loaded != NULL && tag == 255);
+                assert(UArray2bMapped_width(loaded) == W);
+                assert(UArray2bMapped_height(loaded) == H);
+                assert(UArray2bMapped_size(loaded) == sizeof(unsigned));
+                assert(UArray2bMapped_blocksize(loaded) == BS);
+                for (int i = 0; i < W; i++) {
+                        for (int j = 0; j < H; j++) {
+                                unsigned *elem = UArray2bMapped_at(loaded,
+                                                                   i, j);
+                                assert(*elem == (unsigned)(i * 1000 + j));
+                                *elem = 0;
+                        }
+                }
+                UArray2bMapped_free(&loaded);
+        }
+        fclose(fp);
+}
+
+/* A2Methods_convert copies every cell into the other layout */
+static void check_convert(A2Methods_T from, A2Methods_T to)
+{
+        A2 src = from->new(CW, CH, sizeof(struct rgb));
+        for (int i = 0; i < CW; i++) {
+                for (int j = 0; j < CH; j++) {
+                        struct rgb *p = from->at(src, i, j);
+                        *p = (struct rgb){ i, j, i * j };
+                }
+        }
+        A2 dst = A2Methods_convert(from, src, to);
+        assert(to->width(dst) == CW && to->height(dst) == CH);
+        assert(to->size(dst) == sizeof(struct rgb));
+        for (int i = 0; i < CW; i++) {
+                for (int j = 0; j < CH; j++) {
+                        struct rgb *p = to->at(dst, i, j);
+                        assert(p->red == (unsigned)i
+                               && p->green == (unsigned)j
+                               && p->blue == (unsigned)(i * j));
+                }
+        }
+        from->free(&src);
+        to->free(&dst);
+}
+
+/* the pixels each small-map benchmark visits per pass, and the passes */
+#define BENCH_W 512
+#define BENCH_H 384
+#define BENCH_PASSES 50
+
+/* no work that chains one call to the next, so the calls are what is timed */
+static void bump_elem(void *elem, void *cl)
+{
+        (void)cl;
+        *(unsigned *)elem += 1;
+}
+
+/* the way small maps used to run: a full map calls this, and it calls the
+   client's apply, so every element costs two indirect calls */
+struct small_closure {
+        A2Methods_smallapplyfun *apply;
+        void *cl;
+};
+
+static void apply_small(int i, int j, A2 a, void *elem, void *vcl)
+{
+        struct small_closure *cl = vcl;
+        (void)i;
+        (void)j;
+        (void)a;
+        cl->apply(elem, cl->cl);
+}
+
+static double seconds(void)
+{
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/* millions of apply calls per second, best of BENCH_PASSES, through the
+   small map when direct is nonzero and through the adapter otherwise */
+static double calls_per_second(A2Methods_T m, A2 array,
+                               A2Methods_smallmapfun *small,
+                               A2Methods_mapfun *full, int direct)
+{
+        double best = 0;
+        struct small_closure adapter = { bump_elem, NULL };
+        for (int pass = 0; pass < BENCH_PASSES; pass++) {
+                double start = seconds();
+                if (direct) {
+                        small(array, bump_elem, NULL);
+                } else {
+                        full(array, apply_small, &adapter);
+                }
+                double rate = (double)m->width(array) * m->height(array)
+                              / (seconds() - start) / 1e6;
+                best = rate > best ? rate : best;
+        }
+        return best;
+}
+
+static void bench_small_map(const char *name, A2Methods_T m,
+                            A2Methods_smallmapfun *small,
+                            A2Methods_mapfun *full)
+{
+        A2 array = m->new(BENCH_W, BENCH_H, sizeof(unsigned));
+        printf("%-14s adapter %7.1f  direct %7.1f  Mcalls/s\n", name,
+               calls_per_second(m, array, small, full, 0),
+               calls_per_second(m, array, small, full, 1));
+        assert(*(unsigned *)m->at(array, BENCH_W - 1, BENCH_H - 1)
+               == 2 * BENCH_PASSES);
+        m->free(&array);
+}
+
+/* a2test -bench: small-map calls per second through the old full-map
+   adapter and straight from the loop */
+static void bench_small_maps(void)
+{
+        A2Methods_T plain = uarray2_methods_plain;
+        A2Methods_T blocked = uarray2_methods_blocked;
+        A2Methods_T blocked16 = uarray2_methods_blocked16;
+        bench_small_map("plain row", plain, plain->small_map_row_major,
+                        plain->map_row_major);
+        bench_small_map("plain col", plain, plain->small_map_col_major,
+                        plain->map_col_major);
+        bench_small_map("blocked", blocked, blocked->small_map_block_major,
+                        blocked->map_block_major);
+        bench_small_map("blocked16", blocked16,
+                        blocked16->small_map_block_major,
+                        blocked16->map_block_major);
+}
+
 int main(int argc, char *argv[])
 {
+        if (argc == 2 && strcmp(argv[1], "-bench") == 0) {
+                bench_small_maps();
+                return 0;
+        }
         assert(argc == 1);
-        (void)argv;
         test_methods(uarray2_methods_plain);
         test_methods(uarray2_methods_blocked); 
+        test_methods(uarray2_methods_slab);
+        test_methods(uarray2_methods_tiled);
+        test_methods(uarray2_methods_blocked8);
+        test_methods(uarray2_methods_blocked16);
+        test_methods(uarray2_methods_zorder);
+        check_zorder_shapes();
+        test_methods(uarray2_methods_mapped);
+        test_methods(uarray2_methods_sparse);
+        check_sparse();
+        check_sparse_maps();
+        check_snapshot();
+        A2Methods_T suites[] = {
+                uarray2_methods_plain, uarray2_methods_blocked,
+                uarray2_methods_slab, uarray2_methods_tiled,
+                uarray2_methods_blocked8, uarray2_methods_zorder,
+                uarray2_methods_mapped, uarray2_methods_sparse
+        };
+        int nsuites = sizeof(suites) / sizeof(suites[0]);
+        for (int from = 0; from < nsuites; from++) {
+                for (int to = 0; to < nsuites; to++) {
+                        check_convert(suites[from], suites[to]);
+                }
+        }
+        /* the second pass gets the first pass's buffers back from the pool */
+        BigAlloc_pool((size_t)64 << 20);
+        for (int huge = 0; huge <= 1; huge++) {
+                BigAlloc_hugepages(huge);
+                check_big(uarray2_methods_plain);
+                check_big(uarray2_methods_slab);
+                check_big(uarray2_methods_zorder);
+                check_big(uarray2_methods_mapped);
+        }
+        BigAlloc_pool(0);
         printf("Passed.\n");  /* only if we reach this point without
                                * assertion failure
                                */
@@ -0,0 +1,137 @@
+/*
+ *     a2test_cpp.cpp
+ *     locality
+ *
+ *     Checks uarray2.hpp: that it compiles as C++ with a2methods.h inside
+ *     it, that each layout's at() and for_each() agree, and that the suite
+ *     of every UArray2<T, Layout> works with C code, A2Methods_convert
+ *     included.
+ */
+
+/* the checks below are asserts, so make fast must not compile them out */
+#undef NDEBUG
+
+#include <cassert>
+#include <cstdio>
+#include "uarray2.hpp"
+
+#define W 13
+#define H 15
+
+/* wider than one 16 x 16 block, so conversions see edge blocks */
+#define CW 300
+#define CH 200
+
+struct rgb {
+        unsigned red, green, blue;
+};
+
+/* checks one cell against 1000 * i + j and counts it */
+static void check_and_count(int i, int j, A2Methods_UArray2 a, void *elem,
+                            void *cl)
+{
+        (void)a;
+        assert(*(unsigned *)elem == 1000u * i + j);
+        *(int *)cl += 1;
+}
+
+/* checks every cell of a run against 1000 * i + j and counts the cells */
+struct run_closure {
+        a2::Methods methods;
+        int cells;
+};
+
+static void check_run(int col, int row, int width, int height, void *elems,
+                      int colstride, int rowstride, A2Methods_UArray2 a,
+                      void *cl)
+{
+        run_closure *rcl = (run_closure *)cl;
+        for (int j = 0; j < height; j++) {
+                for (int i = 0; i < width; i++) {
+                        unsigned *p = (unsigned *)((char *)elems
+                                                   + i * colstride
+                                                   + j * rowstride);
+                        assert(p == rcl->methods->at(a, col + i, row + j));
+                        assert(*p == 1000u * (col + i) + row + j);
+                }
+        }
+        rcl->cells += width * height;
+}
+
+/* at(), for_each() and the layout's suite see the same cells */
+template <class Layout> static void check_layout()
+{
+        typedef a2::UArray2<unsigned, Layout> Array;
+        Array array(W, H);
+        assert(array.width() == W && array.height() == H);
+        for (int i = 0; i < W; i++) {
+                for (int j = 0; j < H; j++) {
+                        assert(array.at(i, j) == 0);
+                        array.at(i, j) = 1000 * i + j;
+                }
+        }
+
+        int cells = 0;
+        array.for_each([&](int i, int j, unsigned &cell) {
+                assert(&cell == &array.at(i, j));
+                assert(cell == 1000u * i + j);
+                cells++;
+        });
+        assert(cells == W * H);
+
+        a2::Methods methods = Array::methods();
+        A2Methods_UArray2 a2 = array.a2();
+        assert(methods->width(a2) == W && methods->height(a2) == H);
+        assert(methods->size(a2) == (int)sizeof(unsigned));
+        assert(methods->blocksize(a2) == Layout::blocksize);
+        assert(methods->at(a2, W - 1, H - 1) == &array.at(W - 1, H - 1));
+        cells = 0;
+        methods->map_default(a2, check_and_count, &cells);
+        assert(cells == W * H);
+        if (methods->map_blocks != nullptr) {
+                run_closure rcl = { methods, 0 };
+                methods->map_blocks(a2, check_run, &rcl);
+                assert(rcl.cells == W * H);
+        }
+
+        /* a suite's new makes an array its free takes back */
+        A2Methods_UArray2 made = methods->new_array(W, H, sizeof(unsigned));
+        assert(*(unsigned *)methods->at(made, W - 1, H - 1) == 0);
+        methods->free(&made);
+        assert(made == nullptr);
+}
+
+/* A2Methods_convert copies every cell from one layout's suite to another's */
+template <class From, class To> static void check_convert()
+{
+        typedef a2::UArray2<rgb, From> Source;
+        typedef a2::UArray2<rgb, To> Destination;
+        Source src(CW, CH);
+        src.for_each([](int i, int j, rgb &cell) {
+                cell = rgb{ (unsigned)i, (unsigned)j, (unsigned)(i * j) };
+        });
+        A2Methods_UArray2 dst = A2Methods_convert(Source::methods(), src.a2(),
+                                                  Destination::methods());
+        Destination &d = *static_cast<Destination *>(dst);
+        assert(d.width() == CW && d.height() == CH);
+        for (int i = 0; i < CW; i++) {
+                for (int j = 0; j < CH; j++) {
+                        const rgb &p = d.at(i, j);
+                        assert(p.red == (unsigned)i && p.green == (unsigned)j
+                               && p.blue == (unsigned)(i * j));
+                }
+        }
+        Destination::methods()->free(&dst);
+}
+
+int main()
+{
+        check_layout<a2::RowMajor>();
+        check_layout<a2::Blocked<16> >();
+        check_layout<a2::Morton>();
+        check_convert<a2::RowMajor, a2::Blocked<16> >();
+        check_convert<a2::Blocked<16>, a2::Morton>();
+        check_convert<a2::Morton, a2::RowMajor>();
+        std::printf("Passed.\n");
+        return 0;
+}
@@ -0,0 +1,17 @@
+/*
+ *     a2tiled.h
+ *     locality
+ *
+ *     A2Methods suite for arrays blocked for the level 2 cache and tiled
+ *     for the level 1 cache inside each block (see uarray2btiled.h).
+ *     Supports block-major mapping only, like uarray2_methods_blocked.
+ */
+
+#ifndef A2TILED_INCLUDED
+#define A2TILED_INCLUDED
+
+#include "a2methods.h"
+
+extern A2Methods_T uarray2_methods_tiled;
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ *     a2zorder.c
+ *     locality
+ *
+ *     Implementation of private methods on Z-order arrays for the A2Methods
+ *     methods suite
+ */
+
+#include <stddef.h>
+
+#include "a2zorder.h"
+#include "uarray2z.h"
+#include "memnode.h"
+
+typedef A2Methods_UArray2 A2;   // private abbreviation
+
+static A2 new(int width, int height, int size)
+{
+        return UArray2z_new(width, height, size);
+}
+
+static A2 new_with_blocksize(int width, int height, int size, int blocksize)
+{
+        (void)blocksize;
+        return UArray2z_new(width, height, size);
+}
+
+static void a2free(A2 * array2p)
+{
+        UArray2z_free((UArray2z_T *) array2p);
+}
+
+static int width(A2 array2)
+{
+        return UArray2z_width(array2);
+}
+static int height(A2 array2)
+{
+        return UArray2z_height(array2);
+}
+static int size(A2 array2)
+{
+        return UArray2z_size(array2);
+}
+
+/* Z order has no fixed block, like the plain suite it reports 1 */
+static int blocksize(A2 array2)
+{
+        (void)array2;
+        return 1;
+}
+
+// a cursor walks the aligned 2x2 quads, which are row-major runs
+static int begin(A2 array2, A2Methods_Cursor *cursor)
+{
+        return A2Methods_begin_runs(array2, UArray2z_quadcount(array2),
+                                    (A2Methods_runfun *)UArray2z_quad,
+                                    cursor);
+}
+
+static A2Methods_Object *at(A2 array2, int i, int j)
+{
+        return UArray2z_at(array2, i, j);
+}
+
+static int block_node(A2 array2, int i, int j)
+{
+        return MemNode_of(UArray2z_at(array2, i, j));
+}
+
+typedef void applyfun(int i, int j, UArray2z_T array2z, void *elem, void *cl);
+
+static void map_zorder(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+        UArray2z_map(array2, (applyfun *) apply, cl);
+}
+
+struct small_closure {
+        A2Methods_smallapplyfun *apply;
+        void *cl;
+};
+
+static void apply_small(int i, int j, UArray2z_T array2, void *elem,
+                        void *vcl)
+{
+        struct small_closure *cl = vcl;
+        (void)i;
+        (void)j;
+        (void)array2;
+        cl->apply(elem, cl->cl);
+}
+
+static void small_map_zorder(A2 a2, A2Methods_smallapplyfun apply, void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        UArray2z_map(a2, apply_small, &mycl);
+}
+
+static struct A2Methods_T uarray2_methods_zorder_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        NULL,                   // map_row_major
+        NULL,                   // map_col_major
+        map_zorder,             // map_block_major
+        map_zorder,             // map_default
+        NULL,                   // small_map_row_major
+        NULL,                   // small_map_col_major
+        small_map_zorder,       // small_map_block_major
+        small_map_zorder,       // small_map_default
+        NULL,                   // map_blocks: Morton order has no fixed strides
+        NULL,                   // map_row_major_parallel
+        NULL,                   // map_col_major_parallel
+        NULL,                   // map_block_major_parallel
+        NULL,                   // map_default_parallel
+        NULL,                   // new_first_touch
+        block_node,
+        NULL,                   // view
+        NULL,                   // map_recursive
+        NULL,                   // get
+        begin,
+};
+
+// finally the payoff: here is the exported pointer to the struct
+
+A2Methods_T uarray2_methods_zorder = &uarray2_methods_zorder_struct;
@@ -0,0 +1,17 @@
+/*
+ *     a2zorder.h
+ *     locality
+ *
+ *     A2Methods suite for arrays stored in Z (Morton) order (see
+ *     uarray2z.h). The block-major and default maps visit cells in Z order,
+ *     which is storage order for this suite.
+ */
+
+#ifndef A2ZORDER_INCLUDED
+#define A2ZORDER_INCLUDED
+
+#include "a2methods.h"
+
+extern A2Methods_T uarray2_methods_zorder;
+
+#endif
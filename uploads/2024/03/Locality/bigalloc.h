@@ -0,0 +1,54 @@
+/*
+ *     bigalloc.h
+ *     locality
+ *
+ *     Storage for the element buffers of the flat arrays. Buffers of 2 MB
+ *     or more are mapped straight from the kernel on a 2 MB boundary, so
+ *     their pages do not exist until something touches them and each 2 MB
+ *     stretch can be backed by a single transparent huge page. With huge
+ *     pages switched on, those buffers are marked with MADV_HUGEPAGE; a
+ *     column walk over a 600 MB image then needs one TLB entry per 2 MB
+ *     instead of one per 4 KB. Kernels without THP quietly give normal
+ *     pages.
+ */
+
+#ifndef BIGALLOC_INCLUDED
+#define BIGALLOC_INCLUDED
+
+#include <stddef.h>
+
+/* nbytes > 0 of zeroed storage aligned to at least 64 bytes. Running out
+   of memory is a checked runtime error in every build: it is reported on
+   standard error and ends the program. Large buffers are mapped in size
+   classes, four per doubling */
+extern void *BigAlloc_new (size_t nbytes);
+
+/* nbytes > 0 of storage that this call does not write: large buffers are
+   always fresh mappings, never pooled ones, so each page lands on the NUMA
+   node of the thread that first writes it. The contents are unspecified */
+extern void *BigAlloc_new_untouched(size_t nbytes);
+
+/* releases storage from BigAlloc_new; nbytes must be the size it was made
+   with */
+extern void  BigAlloc_free(void *p, size_t nbytes);
+
+/*
+ * asks for huge pages in every buffer made from now on when on is
+ * nonzero; the setting is program-wide, so it should be made before any
+ * arrays are created. returns nonzero if the kernel offers huge pages to
+ * buffers that ask for them
+ */
+extern int   BigAlloc_hugepages(int on);
+
+/*
+ * keeps up to limit bytes of freed buffers of 2 MB or more, and hands
+ * them to later BigAlloc_new calls of the same size class instead of
+ * mapping fresh pages. A program that makes arrays of similar sizes over
+ * and over, like 40image on a stream of photos, then stops paying for page
+ * faults and for returning memory to the kernel. 0, the default, turns the
+ * pool off and releases what it holds. Reused buffers are zeroed by the
+ * caller's thread, so BigAlloc_new_untouched does not take from the pool
+ */
+extern void  BigAlloc_pool(size_t limit);
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ *     blocktiming.c
+ *     locality
+ *
+ *     Benchmark comparing the generic UArray2b accessor and map, which
+ *     divide by the blocksize on every access, against the versions compiled
+ *     for a power-of-two block edge, which shift and mask instead.
+ *
+ *     Usage: blocktiming [width height]
+ *
+ *     Every test walks all cells of a width x height array of Pnm_rgb-sized
+ *     elements and reports the time per cell in nanoseconds.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "assert.h"
+#include "uarray2b.h"
+#include "uarray2b_pow2.h"
+#include "cputiming.h"
+
+struct cell {
+        unsigned red, green, blue;
+};
+
+typedef void *atfun(UArray2b_T array2b, int col, int row);
+
+/* touches every cell through the given accessor, in row-major order */
+static double time_at(UArray2b_T array, atfun *at, unsigned *sum)
+{
+        int w = UArray2b_width(array);
+        int h = UArray2b_height(array);
+        CPUTime_T timer = CPUTime_New();
+
+        CPUTime_Start(timer);
+        for (int row = 0; row < h; row++) {
+                for (int col = 0; col < w; col++) {
+                        struct cell *c = at(array, col, row);
+                        *sum += c->green;
+                }
+        }
+        double time_used = CPUTime_Stop(timer);
+        CPUTime_Free(&timer);
+        return time_used;
+}
+
+static void add_green(int col, int row, UArray2b_T array, void *elem,
+                      void *cl)
+{
+        (void)col;
+        (void)row;
+        (void)array;
+        *(unsigned *)cl += ((struct cell *)elem)->green;
+}
+
+typedef void mapfun(UArray2b_T array2b, void apply(int col, int row,
+                    UArray2b_T array2b, void *elem, void *cl), void *cl);
+
+static double time_map(UArray2b_T array, mapfun *map, unsigned *sum)
+{
+        CPUTime_T timer = CPUTime_New();
+
+        CPUTime_Start(timer);
+        map(array, add_green, sum);
+        double time_used = CPUTime_Stop(timer);
+        CPUTime_Free(&timer);
+        return time_used;
+}
+
+static void report(const char *what, double time_used, int cells)
+{
+        printf("%-28s %14.0f ns %10.3f ns/cell\n", what, time_used,
+               time_used / cells);
+}
+
+int main(int argc, char *argv[])
+{
+        int w = 4080;
+        int h = 3060;
+        if (argc == 3) {
+                w = atoi(argv[1]);
+                h = atoi(argv[2]);
+        } else if (argc != 1) {
+                fprintf(stderr, "Usage: %s [width height]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+        assert(w > 0 && h > 0);
+        int cells = w * h;
+        unsigned sum = 0;   /* printed so the loops are not optimized away */
+
+        UArray2b_T generic64K = UArray2b_new_64K_block(w, h,
+                                                      sizeof(struct cell));
+        UArray2b_T pow2 = UArray2b_new(w, h, sizeof(struct cell), 64);
+
+        printf("%d x %d cells of %zu bytes; 64K blocksize %d\n", w, h,
+               sizeof(struct cell), UArray2b_blocksize(generic64K));
+
+        report("at, generic, 64K block",
+               time_at(generic64K, UArray2b_at, &sum), cells);
+        report("at, generic, 64 block", time_at(pow2, UArray2b_at, &sum),
+               cells);
+        report("at, specialized, 64 block",
+               time_at(pow2, UArray2b_at64, &sum), cells);
+        report("map, generic, 64K block",
+               time_map(generic64K, UArray2b_map, &sum), cells);
+        report("map, generic, 64 block", time_map(pow2, UArray2b_map, &sum),
+               cells);
+        report("map, specialized, 64 block",
+               time_map(pow2, UArray2b_map64, &sum), cells);
+        printf("checksum %u\n", sum);
+
+        UArray2b_free(&generic64K);
+        UArray2b_free(&pow2);
+        return EXIT_SUCCESS;
+}
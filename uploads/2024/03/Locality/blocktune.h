@@ -0,0 +1,40 @@
+/*
+ *     blocktune.h
+ *     locality
+ *
+ *     Chooses the block edge of blocked arrays from the caches of the
+ *     machine the program runs on, instead of aiming every block at 64 KB.
+ *     Cache sizes come from /sys/devices/system/cpu/cpu0/cache, or from
+ *     sysconf where sysfs says nothing. A rotation reads a source block
+ *     while it writes a destination block, and both share the level 2
+ *     cache with every other line in flight, so by default a block takes a
+ *     sixteenth of it: 128 KB of a 2 MB cache, 16 KB of a 256 KB one.
+ *
+ *     With calibration on, the first request for an element size times a
+ *     short blocked rotation at each candidate edge and keeps the fastest.
+ *     Calibrated edges are stored in a file under $XDG_CACHE_HOME (or
+ *     ~/.cache) together with the cache sizes they were measured with, so
+ *     a home directory shared by different machines recalibrates on each
+ *     kind of CPU rather than reusing another's answer.
+ */
+
+#ifndef BLOCKTUNE_INCLUDED
+#define BLOCKTUNE_INCLUDED
+
+#include <stddef.h>
+
+/* the size in bytes of the level 1 data cache, or of the unified level 2
+   or 3 cache; 0 when it cannot be found */
+extern size_t BlockTune_cache(int level);
+
+/* the block edge for elements of size > 0 bytes; at least 1 */
+extern int    BlockTune_blocksize(int size);
+
+/*
+ * turns calibration on when on is nonzero. The setting is program-wide.
+ * Edges already calibrated on this machine are used either way; with
+ * calibration off, sizes without one get the edge from the cache sizes
+ */
+extern void   BlockTune_calibrate(int on);
+
+#endif
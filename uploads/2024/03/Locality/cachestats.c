@@ -0,0 +1,110 @@
+/*
+ *     cachestats.c
+ *     locality
+ *
+ *     Implementation of cache hit and miss counting with perf_event_open
+ */
+#include "cachestats.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define T CacheStats_T
+
+enum { L1_READS, L1_MISSES, LLC_READS, LLC_MISSES, NEVENTS };
+
+/* one file descriptor per event; -1 for events that could not be opened */
+struct T {
+        int fd[NEVENTS];
+};
+
+/* the perf_event config of a read access or miss in a hardware cache */
+static unsigned long long cache_event(unsigned long long cache, int miss)
+{
+        unsigned long long result = miss ? PERF_COUNT_HW_CACHE_RESULT_MISS
+                                         : PERF_COUNT_HW_CACHE_RESULT_ACCESS;
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+}
+
+/* a disabled counter of one event in this thread and its new threads, or
+   -1 */
+static int open_event(unsigned long long config)
+{
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+T CacheStats_new(void)
+{
+        T stats = malloc(sizeof(*stats));
+        assert(stats != NULL);
+        stats->fd[L1_READS]   = open_event(cache_event(PERF_COUNT_HW_CACHE_L1D,
+                                                       0));
+        stats->fd[L1_MISSES]  = open_event(cache_event(PERF_COUNT_HW_CACHE_L1D,
+                                                       1));
+        stats->fd[LLC_READS]  = open_event(cache_event(PERF_COUNT_HW_CACHE_LL,
+                                                       0));
+        stats->fd[LLC_MISSES] = open_event(cache_event(PERF_COUNT_HW_CACHE_LL,
+                                                       1));
+        for (int e = 0; e < NEVENTS; e++) {
+                if (stats->fd[e] >= 0) {
+                        return stats;
+                }
+        }
+        free(stats);
+        return NULL;
+}
+
+void CacheStats_free(T *stats)
+{
+        assert(stats != NULL && *stats != NULL);
+        for (int e = 0; e < NEVENTS; e++) {
+                if ((*stats)->fd[e] >= 0) {
+                        close((*stats)->fd[e]);
+                }
+        }
+        free(*stats);
+        *stats = NULL;
+}
+
+void CacheStats_start(T stats)
+{
+        assert(stats != NULL);
+        for (int e = 0; e < NEVENTS; e++) {
+                if (stats->fd[e] >= 0) {
+                        ioctl(stats->fd[e], PERF_EVENT_IOC_RESET, 0);
+                        ioctl(stats->fd[e], PERF_EVENT_IOC_ENABLE, 0);
+                }
+        }
+}
+
+CacheStats_Counts CacheStats_stop(T stats)
+{
+        assert(stats != NULL);
+        long long count[NEVENTS];
+        for (int e = 0; e < NEVENTS; e++) {
+                count[e] = -1;
+                if (stats->fd[e] >= 0) {
+                        ioctl(stats->fd[e], PERF_EVENT_IOC_DISABLE, 0);
+                        if (read(stats->fd[e], &count[e], sizeof(count[e]))
+                            != sizeof(count[e])) {
+                                count[e] = -1;
+                        }
+                }
+        }
+        CacheStats_Counts counts = { count[L1_READS], count[L1_MISSES],
+                                     count[LLC_READS], count[LLC_MISSES] };
+        return counts;
+}
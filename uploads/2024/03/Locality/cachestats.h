@@ -0,0 +1,37 @@
+/*
+ *     cachestats.h
+ *     locality
+ *
+ *     Counts the data cache reads and misses of a stretch of code with the
+ *     kernel's hardware performance counters (perf_event_open), so that the
+ *     effect of a traversal order or of prefetching shows up as a hit rate
+ *     and not only as a time. Counting needs a CPU whose counters the
+ *     kernel exposes (many virtual machines expose none) and
+ *     /proc/sys/kernel/perf_event_paranoid of 2 or less. The calling thread
+ *     is counted, together with the threads it creates while counting.
+ */
+
+#ifndef CACHESTATS_INCLUDED
+#define CACHESTATS_INCLUDED
+
+#define T CacheStats_T
+typedef struct T *T;
+
+/* counts since CacheStats_start; -1 for an event this CPU cannot count */
+typedef struct CacheStats_Counts {
+        long long l1_reads, l1_misses;          /* level 1 data cache */
+        long long llc_reads, llc_misses;        /* last-level cache */
+} CacheStats_Counts;
+
+/* a set of counters, or NULL if none of the events can be counted here */
+extern T    CacheStats_new (void);
+extern void CacheStats_free(T *stats);
+
+/* zeroes the counters and starts them */
+extern void CacheStats_start(T stats);
+
+/* stops the counters and returns what they counted */
+extern CacheStats_Counts CacheStats_stop(T stats);
+
+#undef T
+#endif
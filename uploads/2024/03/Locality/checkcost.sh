@@ -0,0 +1,49 @@
+#!/bin/sh
+#
+#     checkcost.sh
+#     locality
+#
+#     Measures what the asserts cost ppmtrans: builds it with make debug and
+#     with make fast, times 90 and 180 degree rotations of one image under
+#     each mapping with both builds, and prints the times and their ratio.
+#
+#     Usage: ./checkcost.sh image.ppm [mapping ...]
+#
+#     Mappings are as for timetable.sh; the default is row col block. The
+#     directory is rebuilt twice and is left with the fast build. MAKE
+#     overrides the make command, e.g. MAKE="make -e" to take CFLAGS and
+#     the rest from the environment.
+#
+
+if [ $# -lt 1 ]; then
+        echo "Usage: $0 image.ppm [mapping ...]" >&2
+        exit 1
+fi
+image=$1
+shift
+mappings=${*:-row col block}
+make=${MAKE:-make}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+$make -s debug > /dev/null && cp ppmtrans "$dir/debug" || exit 1
+$make -s fast > /dev/null && cp ppmtrans "$dir/fast" || exit 1
+
+# prints the best ns/pixel of three runs of one build
+run() {
+        for k in 1 2 3; do
+                "$dir/$1" -rotate "$3" "-$2-major" -time "$dir/time" \
+                        "$image" > /dev/null || exit 1
+                awk '{ print $12 }' "$dir/time"
+        done | sort -g | head -1
+}
+
+echo "                |  rotation | debug ns/px | fast ns/px | debug/fast"
+for m in $mappings; do
+        for r in 90 180; do
+                set -- $(run debug "$m" $r) $(run fast "$m" $r)
+                printf "%-16s| %6d    | %11.1f | %10.1f | %6.2f\n" \
+                       "$m-major" $r "$1" "$2" "$(echo "$1 $2" |
+                       awk '{ print $1 / $2 }')"
+        done
+done
@@ -74,7 +74,11 @@ double CPUTime_Stop(CPUTime_T startTimep)
 {
         struct timespec stop, time_used;
         clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
-        assert(timespec_subtract(&time_used, &stop, &(startTimep->time)) == 0);
+        /* not inside the assert, which make fast compiles out */
+        int negative = timespec_subtract(&time_used, &stop,
+                                         &(startTimep->time));
+        assert(negative == 0);
+        (void)negative;
         return timespec_to_double(&time_used);
 }
 
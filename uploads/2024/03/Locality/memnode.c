@@ -0,0 +1,40 @@
+/*
+ *     memnode.c
+ *     locality
+ *
+ *     Implementation of the NUMA node query
+ */
+#include "memnode.h"
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/* get_mempolicy flags from <numaif.h>, which is part of libnuma */
+#ifndef MPOL_F_NODE
+#define MPOL_F_NODE (1 << 0)
+#define MPOL_F_ADDR (1 << 1)
+#endif
+
+extern int MemNode_of(const void *addr)
+{
+#ifdef SYS_get_mempolicy
+        int node = -1;
+        if (syscall(SYS_get_mempolicy, &node, NULL, 0UL, addr,
+                    MPOL_F_NODE | MPOL_F_ADDR) == 0) {
+                return node;
+        }
+#else
+        (void)addr;
+#endif
+        return -1;
+}
+
+extern int MemNode_current(void)
+{
+#ifdef SYS_getcpu
+        unsigned cpu, node;
+        if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0) {
+                return (int)node;
+        }
+#endif
+        return -1;
+}
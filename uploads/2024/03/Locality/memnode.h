@@ -0,0 +1,23 @@
+/*
+ *     memnode.h
+ *     locality
+ *
+ *     Reports which NUMA node holds a given byte of memory, and which node
+ *     a thread is running on, for checking where the pages of an array
+ *     ended up. Asks the kernel directly, so no
+ *     NUMA library is needed.
+ */
+
+#ifndef MEMNODE_INCLUDED
+#define MEMNODE_INCLUDED
+
+/* the node holding the page that contains addr, or -1 when the kernel
+   cannot say; a page that was never touched is placed by this call as if
+   the calling thread had read it */
+extern int MemNode_of(const void *addr);
+
+/* the node of the CPU the calling thread is running on, or -1 when the
+   kernel cannot say */
+extern int MemNode_current(void);
+
+#endif
@@ -18,16 +18,32 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "assert.h"
 #include "a2methods.h"
 #include "a2plain.h"
 #include "a2blocked.h"
+#include "a2slab.h"
+#include "a2tiled.h"
+#include "a2blocked_pow2.h"
+#include "a2zorder.h"
+#include "a2mapped.h"
+#include "uarray2bmapped.h"
 #include "pnm.h"
 #include "cputiming.h"
+#include "threadpool.h"
+#include "bigalloc.h"
+#include "uarray2.h"
+#include "uarray2b.h"
+#include "cachestats.h"
+#include "blocktune.h"
 
-void start_transform(FILE *picFile, int rotation, char *time_file, 
+void start_transform(Pnm_ppm image, int rotation, char *time_file, 
         A2Methods_mapfun* map, A2Methods_T methods, char *otherTrans, 
         char *direction);
+Pnm_ppm read_snapshot(FILE *picFile);
+void save_snapshot(Pnm_ppm image, char *snapshot_file);
 void rotate_image_setup(Pnm_ppm image, int rotation, char *time_file, 
         A2Methods_mapfun* map);
 A2Methods_UArray2 rotation_options(int rotation, Pnm_ppm image, 
@@ -47,11 +63,33 @@ void flip_vertical(int sourceCol, int sourceRow, A2Methods_UArray2 array,
 void transpose(int sourceCol, int sourceRow, A2Methods_UArray2 array, 
         void *elem, void* source);
 void time_handle(char *timeFile, double timeTaken, Pnm_ppm image);
+void run_map(A2Methods_mapfun *map, A2Methods_UArray2 destination, 
+        A2Methods_applyfun apply, Pnm_ppm image);
+void print_thread_stats(ThreadPool_T pool, int nworkers);
+void print_cache_stats(CacheStats_Counts counts);
+A2Methods_UArray2 new_destination(const struct A2Methods_T *methods, 
+        int width, int height, int size);
+size_t image_bytes(FILE *picFile);
+
+/* set by -threads; with more than one thread, maps go through parallel_map */
+static int threads = 1;
+static A2Methods_parallelmapfun *parallel_map = NULL;
+static bool thread_stats = false;       /* set by -thread-stats */
+static bool first_touch = false;        /* set by -first-touch */
+static CacheStats_T cache_stats = NULL; /* set by -cache-stats */
+static char *snapshot_file = NULL;      /* set by -snapshot */
+
+/* set by -crop: the part of the image that is transformed and written */
+static bool cropping = false;
+static struct {
+        int width, height, x, y;
+} crop;
 
 #define SET_METHODS(METHODS, MAP, WHAT) do {                    \
         methods = (METHODS);                                    \
         assert(methods != NULL);                                \
         map = methods->MAP;                                     \
+        parallel_map = methods->MAP##_parallel;                 \
         if (map == NULL) {                                      \
                 fprintf(stderr, "%s does not support "          \
                                 WHAT "mapping\n",               \
@@ -63,8 +101,13 @@ void time_handle(char *timeFile, double timeTaken, Pnm_ppm image);
 static void usage(const char *progname)
 {
         fprintf(stderr, "Usage: %s [-rotate <angle>] "
-                        "[-{row,col,block}-major] "
-                        "[-time time_file] "
+                        "[-{row,col,recursive,block,slab,tiled,zorder}-major] "
+                        "[-mapped] "
+                        "[-pow2-block {8,16,32,64}] "
+                        "[-threads N [-thread-stats] [-first-touch]] "
+                        "[-hugepages] [-prefetch N] [-cache-stats] "
+                        "[-tune-blocks] [-crop WxH+X+Y] "
+                        "[-time time_file] [-snapshot snapshot_file] "
                         "[filename]\n",
                         progname);
         exit(1);
@@ -334,14 +377,16 @@ A2Methods_UArray2 rotation_options(int rotation, Pnm_ppm image,
                 return image->pixels;
         }  
         if (rotation == 180){
-                destination = methods->new(destWidth, destHeight, destSize);
-                map(destination, rotate_180, image);
+                destination = new_destination(methods, destWidth, destHeight, 
+                        destSize);
+                run_map(map, destination, rotate_180, image);
         } else {
-                destination = methods->new(destHeight, destWidth, destSize);
+                destination = new_destination(methods, destHeight, destWidth, 
+                        destSize);
                 if (rotation == 90) {
-                        map(destination, rotate_90, image);
+                        run_map(map, destination, rotate_90, image);
                 } else {
-                        map(destination, rotate_270, image);
+                        run_map(map, destination, rotate_270, image);
                 }
                 image->height = image->methods->height(destination);
                 image->width = image->methods->width(destination);
@@ -383,16 +428,18 @@ void other_transformations(Pnm_ppm image, char *transformation,
 
         /* Carry out the given transformation */
         if (strcmp(transformation, "transpose") == 0){
-                destination = methods->new(destHeight, destWidth, destSize);
+                destination = new_destination(methods, destHeight, destWidth, 
+                        destSize);
                 CPUTime_Start(timer);
-                map(destination, transpose, image);
+                run_map(map, destination, transpose, image);
         } else {
                 /*Since we did not implement horizontal flipping, program will 
                 only enter this conditional if -flip vertical is given. Check 
                 For horizontal would be here if implemented*/
-                destination = methods->new(destWidth, destHeight, destSize);
+                destination = new_destination(methods, destWidth, destHeight, 
+                        destSize);
                 CPUTime_Start(timer);
-                map(destination, flip_vertical, image);
+                run_map(map, destination, flip_vertical, image);
         }
         /* Stop timer and update the image */
         double timeTaken = CPUTime_Stop(timer);
@@ -407,10 +454,10 @@ void other_transformations(Pnm_ppm image, char *transformation,
 
 /*****************start_transform*****************************************
 *
-* Function that gets the image data from the provided file and initiates the 
-* image transformation.
+* Function that initiates the transformation of an image that has been read
+* in, and writes the result.
 * 
-* Parameters: FILE *picFile: the file containing the image 
+* Parameters: Pnm_ppm image: the image, read with the given methods suite
 *             int rotation: the number of degrees to rotate by, if the 
 *                   rotation command is given. 
 *             char *time_file: the name of a file to output time data to 
@@ -422,22 +469,41 @@ void other_transformations(Pnm_ppm image, char *transformation,
 *
 * Return: Nothing, but prints the new image to standard output 
 *
-* Expects: that the image file, mapping function, and methods suite are not 
+* Expects: that the image, mapping function, and methods suite are not 
 *          NULL, which is checked in the main function.
 *      
-* Notes: Relies on the pnm.h interface to read the source image as well as 
-*        write and free the new image to standard output. Raises checked 
-*        runtime error if the Pnm_ppm for the image was not created 
-*        successfully. 
+* Notes: Relies on the pnm.h interface to write and free the new image to
+*        standard output. With -snapshot, the image is saved as it was read,
+*        before any transformation. With -crop, the transformation reads
+*        a view of the cropped rectangle, so cropping copies no pixels; the
+*        whole image is freed once the view is no longer in use.
 *      
 *********************************************************************/
-void start_transform(FILE *picFile, int rotation, char *time_file, 
+void start_transform(Pnm_ppm image, int rotation, char *time_file, 
         A2Methods_mapfun* map, A2Methods_T methods, char *otherTrans, 
         char *direction)
 {
-        /* Read in the image data from file */
-        Pnm_ppm image = Pnm_ppmread(picFile, methods);
         assert(image != NULL);
+        if (snapshot_file != NULL) {
+                save_snapshot(image, snapshot_file);
+        }
+
+        A2Methods_UArray2 whole = NULL;
+        if (cropping) {
+                if (crop.x + crop.width > (int)image->width
+                    || crop.y + crop.height > (int)image->height) {
+                        fprintf(stderr, "Crop %dx%d+%d+%d does not fit in a "
+                                        "%ux%u image\n", crop.width,
+                                        crop.height, crop.x, crop.y,
+                                        image->width, image->height);
+                        exit(1);
+                }
+                whole = image->pixels;
+                image->pixels = methods->view(whole, crop.x, crop.y,
+                                              crop.width, crop.height);
+                image->width = crop.width;
+                image->height = crop.height;
+        }
 
         /* Transform the image according to the command given */
         if (otherTrans == NULL) {
@@ -451,6 +517,249 @@ void start_transform(FILE *picFile, int rotation, char *time_file,
         /* Write new image to standard output and free */
         Pnm_ppmwrite(stdout, image);
         Pnm_ppmfree(&image);
+        if (whole != NULL) {
+                methods->free(&whole);
+        }
+}
+
+/*****************read_snapshot*******************************************
+*
+* Function that maps in an image saved by -snapshot, if that is what the
+* input file holds
+* 
+* Parameters: FILE *picFile: the open input file
+*
+* Return: the image, held by the mapped methods suite, or NULL if picFile is
+*         not a snapshot, in which case nothing has been read from it
+*
+* Expects: picFile is not NULL
+*      
+* Notes: a snapshot of anything but Pnm_rgb pixels is a checked runtime
+*        error. The pixels are mapped, not read, so a snapshot that is
+*        still in the page cache from an earlier run costs almost nothing
+*        to open.
+*      
+*********************************************************************/
+Pnm_ppm read_snapshot(FILE *picFile)
+{
+        unsigned denominator;
+        UArray2bMapped_T pixels = UArray2bMapped_load(picFile, &denominator);
+        if (pixels == NULL) {
+                return NULL;
+        }
+        assert(UArray2bMapped_size(pixels) == sizeof(struct Pnm_rgb));
+
+        Pnm_ppm image = malloc(sizeof(*image));
+        assert(image != NULL);
+        image->width = UArray2bMapped_width(pixels);
+        image->height = UArray2bMapped_height(pixels);
+        image->denominator = denominator;
+        image->pixels = pixels;
+        image->methods = uarray2_methods_mapped;
+        return image;
+}
+
+/*****************save_snapshot*******************************************
+*
+* Function that saves an image so that later runs can map it in instead of
+* reading it as a ppm
+* 
+* Parameters: Pnm_ppm image: the image, held by the mapped methods suite
+*             char *snapshot_file: the name of the file to write
+*
+* Return: Nothing, but creates or replaces the snapshot file
+*
+* Expects: main has already chosen the mapped suite
+*      
+* Notes: the snapshot is written to a temporary file beside snapshot_file
+*        and renamed over it once complete, so a failed write never leaves
+*        a partial snapshot or loses the old one, and an old snapshot the
+*        image is mapped from stays valid. A failure is reported and ends
+*        the program.
+*      
+*********************************************************************/
+void save_snapshot(Pnm_ppm image, char *snapshot_file)
+{
+        assert(image->methods == uarray2_methods_mapped);
+        size_t len = strlen(snapshot_file) + 32;
+        char *tmp = malloc(len);
+        assert(tmp != NULL);
+        snprintf(tmp, len, "%s.%ld", snapshot_file, (long)getpid());
+
+        FILE *fp = fopen(tmp, "w");
+        if (fp == NULL) {
+                perror(tmp);
+                exit(1);
+        }
+        bool saved = UArray2bMapped_save(image->pixels, image->denominator,
+                                         fp);
+        if (fclose(fp) != 0 || !saved || rename(tmp, snapshot_file) != 0) {
+                fprintf(stderr, "Could not write snapshot %s\n",
+                        snapshot_file);
+                remove(tmp);
+                exit(1);
+        }
+        free(tmp);
+}
+
+/**********************run_map*********************************************
+*
+* Runs one transformation's apply function over the destination array, with
+* the sequential map or, when -threads asked for more than one thread, with
+* the matching parallel map
+* 
+* Parameters: A2Methods_mapfun *map: the sequential mapping function
+*             A2Methods_UArray2 destination: the array being filled in
+*             A2Methods_applyfun apply: the transformation's apply function
+*             Pnm_ppm image: the source image, passed as every closure
+*
+* Return: Nothing, but fills in the destination array
+*
+* Expects: parallel_map is not NULL when threads > 1, which main checks
+*      
+* Notes: the apply functions only read the source image and write their own
+*        destination cell, so every worker can share the same closure.
+*        With -cache-stats, the map alone is counted.
+*      
+*********************************************************************/
+void run_map(A2Methods_mapfun *map, A2Methods_UArray2 destination, 
+        A2Methods_applyfun apply, Pnm_ppm image)
+{
+        if (threads <= 1) {
+                if (cache_stats != NULL) {
+                        CacheStats_start(cache_stats);
+                }
+                map(destination, apply, image);
+                if (cache_stats != NULL) {
+                        print_cache_stats(CacheStats_stop(cache_stats));
+                }
+                return;
+        }
+        assert(parallel_map != NULL);
+        void **cls = malloc(threads * sizeof(*cls));
+        assert(cls != NULL);
+        for (int w = 0; w < threads; w++) {
+                cls[w] = image;
+        }
+
+        /* the suites run their parallel maps on the shared pool */
+        ThreadPool_T pool = ThreadPool_shared(threads);
+        ThreadPool_reset_stats(pool);
+        if (cache_stats != NULL) {
+                CacheStats_start(cache_stats);
+        }
+        parallel_map(destination, apply, cls, threads);
+        if (cache_stats != NULL) {
+                print_cache_stats(CacheStats_stop(cache_stats));
+        }
+        if (thread_stats) {
+                print_thread_stats(pool, threads);
+        }
+        free(cls);
+}
+
+/**********************new_destination************************************
+*
+* Makes the array a transformation writes into. With -first-touch, the 
+* array's blocks are first written by the threads that the parallel map 
+* will give them to, so each block's pages are on that thread's NUMA node.
+* 
+* Parameters: const struct A2Methods_T *methods: the image's methods suite
+*             int width, height: the dimensions of the new array
+*             int size: the size of one element
+*
+* Return: the new, zeroed array
+*
+* Expects: methods->new_first_touch is not NULL with -first-touch, which
+*          main checks
+*      
+*********************************************************************/
+A2Methods_UArray2 new_destination(const struct A2Methods_T *methods, 
+        int width, int height, int size)
+{
+        if (first_touch) {
+                assert(methods->new_first_touch != NULL);
+                return methods->new_first_touch(width, height, size, threads);
+        }
+        return methods->new(width, height, size);
+}
+
+/**********************print_thread_stats**********************************
+*
+* Prints to standard error how the last parallel map was shared among the
+* workers, so that load balance can be checked
+* 
+* Parameters: ThreadPool_T pool: the pool that ran the map
+*             int nworkers: the number of workers the map used
+*
+* Return: Nothing, but prints one line per worker and a summary line
+*      
+* Notes: balance is the busiest worker's time inside tasks over the mean;
+*        1.00 means the work was spread perfectly evenly.
+*      
+*********************************************************************/
+void print_thread_stats(ThreadPool_T pool, int nworkers)
+{
+        double total = 0, busiest = 0;
+        long steals = 0;
+        for (int w = 0; w < nworkers; w++) {
+                ThreadPool_Stats stats = ThreadPool_stats(pool, w);
+                fprintf(stderr, "worker %2d: %8ld tasks %8ld stolen "
+                                "%12.3f ms busy\n", w, stats.tasks, 
+                                stats.steals, stats.busy / 1e6);
+                total += stats.busy;
+                steals += stats.steals;
+                if (stats.busy > busiest) {
+                        busiest = stats.busy;
+                }
+        }
+        fprintf(stderr, "%ld steals, balance %.2f\n", steals, 
+                total > 0 ? busiest / (total / nworkers) : 1.0);
+}
+
+/**********************print_cache_stats***********************************
+*
+* Prints to standard error the cache reads and misses counted during the
+* last map, so that traversal orders and prefetch distances can be compared
+* by hit rate as well as by time
+* 
+* Parameters: CacheStats_Counts counts: what the counters counted
+*
+* Return: Nothing, but prints one line per cache level
+*      
+* Notes: a count of -1 is an event this CPU cannot count, printed as n/a.
+*        The pool's workers are counted only if they were started after
+*        the counters were opened, which is the case on the first map.
+*      
+*********************************************************************/
+void print_cache_stats(CacheStats_Counts counts)
+{
+        struct {
+                const char *name;
+                long long reads, misses;
+        } levels[] = {
+                { "L1d", counts.l1_reads, counts.l1_misses },
+                { "LLC", counts.llc_reads, counts.llc_misses },
+        };
+        for (int l = 0; l < 2; l++) {
+                fprintf(stderr, "%s: ", levels[l].name);
+                if (levels[l].reads >= 0) {
+                        fprintf(stderr, "%14lld reads ", levels[l].reads);
+                } else {
+                        fprintf(stderr, "%14s reads ", "n/a");
+                }
+                if (levels[l].misses >= 0) {
+                        fprintf(stderr, "%14lld misses", levels[l].misses);
+                } else {
+                        fprintf(stderr, "%14s misses", "n/a");
+                }
+                if (levels[l].reads > 0 && levels[l].misses >= 0) {
+                        fprintf(stderr, " %6.2f%% hits", 100.0 
+                                * (levels[l].reads - levels[l].misses)
+                                / levels[l].reads);
+                }
+                fprintf(stderr, "\n");
+        }
 }
 
 /**********************time_handle*****************************************
@@ -492,6 +801,27 @@ void time_handle(char *timeFile, double timeTaken, Pnm_ppm image)
         }
 }
 
+/*************image_bytes**********************************
+*
+* Estimates the memory a ppm file will take once it is read into an array
+*
+* Parameters: FILE *picFile: the open image file
+*
+* Return: the estimated number of bytes, or 0 when the file is not a regular
+*         file (e.g. standard input from a pipe) and its size is unknown
+*
+* Notes: a raw ppm holds three bytes per pixel, and each pixel becomes a
+*        struct Pnm_rgb in memory. Plain ppm files are overestimated.
+*********************************************************************/
+size_t image_bytes(FILE *picFile)
+{
+        struct stat info;
+        if (fstat(fileno(picFile), &info) != 0 || !S_ISREG(info.st_mode)) {
+                return 0;
+        }
+        return (size_t)info.st_size / 3 * sizeof(struct Pnm_rgb);
+}
+
 /***************************main*****************************************
 *
 * Function that parses through the commands provided by the client, opens a 
@@ -517,6 +847,7 @@ int main(int argc, char *argv[])
         int   i;
         char *otherTrans = NULL;
         char *direction = NULL;
+        char *chosen_map = NULL;        /* the option that chose the map */
 
         /* default to UArray2 methods */
         A2Methods_T methods = uarray2_methods_plain; 
@@ -525,17 +856,60 @@ int main(int argc, char *argv[])
         /* default to best map */
         A2Methods_mapfun *map = methods->map_default; 
         assert(map != NULL);
+        parallel_map = methods->map_default_parallel;
 
         for (i = 1; i < argc; i++) {
                 if (strcmp(argv[i], "-row-major") == 0) {
+                        chosen_map = argv[i];
                         SET_METHODS(uarray2_methods_plain, map_row_major, 
                                     "row-major");
                 } else if (strcmp(argv[i], "-col-major") == 0) {
+                        chosen_map = argv[i];
                         SET_METHODS(uarray2_methods_plain, map_col_major, 
                                     "column-major");
+                } else if (strcmp(argv[i], "-recursive-major") == 0) {
+                        chosen_map = argv[i];
+                        /* plain storage visited quadrant by quadrant; there
+                           is no parallel version */
+                        methods = uarray2_methods_plain;
+                        map = methods->map_recursive;
+                        parallel_map = NULL;
+                        assert(map != NULL);
                 } else if (strcmp(argv[i], "-block-major") == 0) {
+                        chosen_map = argv[i];
                         SET_METHODS(uarray2_methods_blocked, map_block_major,
                                     "block-major");
+                } else if (strcmp(argv[i], "-slab-major") == 0) {
+                        chosen_map = argv[i];
+                        SET_METHODS(uarray2_methods_slab, map_block_major,
+                                    "slab block-major");
+                } else if (strcmp(argv[i], "-tiled-major") == 0) {
+                        chosen_map = argv[i];
+                        SET_METHODS(uarray2_methods_tiled, map_block_major,
+                                    "tiled block-major");
+                } else if (strcmp(argv[i], "-mapped") == 0) {
+                        chosen_map = argv[i];
+                        SET_METHODS(uarray2_methods_mapped, map_block_major,
+                                    "mapped block-major");
+                } else if (strcmp(argv[i], "-zorder-major") == 0) {
+                        chosen_map = argv[i];
+                        SET_METHODS(uarray2_methods_zorder, map_default,
+                                    "z-order");
+                } else if (strcmp(argv[i], "-pow2-block") == 0) {
+                        chosen_map = argv[i];
+                        if (!(i + 1 < argc)) {      /* no block edge */
+                                usage(argv[0]);
+                        }
+                        char *endptr;
+                        int edge = strtol(argv[++i], &endptr, 10);
+                        if (*endptr != '\0'
+                            || uarray2_methods_blocked_pow2(edge) == NULL) {
+                                fprintf(stderr, 
+                                        "Block edge must be 8, 16, 32 or 64\n");
+                                usage(argv[0]);
+                        }
+                        SET_METHODS(uarray2_methods_blocked_pow2(edge),
+                                    map_block_major, "block-major");
                 } else if (strcmp(argv[i], "-rotate") == 0) {
                         if (!(i + 1 < argc)) {      /* no rotate value */
                                 usage(argv[0]);
@@ -562,12 +936,77 @@ int main(int argc, char *argv[])
                                         "Flip must be vertical\n");
                                 usage(argv[0]);
                             }
+                } else if (strcmp(argv[i], "-threads") == 0) {
+                        if (!(i + 1 < argc)) {      /* no thread count */
+                                usage(argv[0]);
+                        }
+                        char *endptr;
+                        threads = strtol(argv[++i], &endptr, 10);
+                        if (*endptr != '\0' || threads < 1) {
+                                fprintf(stderr, 
+                                        "Thread count must be at least 1\n");
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-thread-stats") == 0) {
+                        thread_stats = true;
+                } else if (strcmp(argv[i], "-first-touch") == 0) {
+                        first_touch = true;
+                } else if (strcmp(argv[i], "-hugepages") == 0) {
+                        /* before any image is read, so both arrays get them */
+                        if (!BigAlloc_hugepages(1)) {
+                                fprintf(stderr, "%s: huge pages are not "
+                                                "available, using normal "
+                                                "pages\n", argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-prefetch") == 0) {
+                        if (!(i + 1 < argc)) {      /* no distance */
+                                usage(argv[0]);
+                        }
+                        char *endptr;
+                        int distance = strtol(argv[++i], &endptr, 10);
+                        if (*endptr != '\0' || distance < 0) {
+                                fprintf(stderr, "Prefetch distance must be "
+                                                "at least 0\n");
+                                usage(argv[0]);
+                        }
+                        /* rows ahead in column walks, blocks ahead in
+                           block walks */
+                        UArray2_prefetch(distance);
+                        UArray2b_prefetch(distance);
+                } else if (strcmp(argv[i], "-tune-blocks") == 0) {
+                        /* -block-major's block edge is timed on this
+                           machine the first time, then read back */
+                        BlockTune_calibrate(1);
+                } else if (strcmp(argv[i], "-cache-stats") == 0) {
+                        /* opened before the pool starts, so workers count */
+                        cache_stats = CacheStats_new();
+                        if (cache_stats == NULL) {
+                                fprintf(stderr, "%s: hardware cache counters "
+                                                "are not available\n",
+                                                argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-crop") == 0) {
+                        char rest;
+                        if (!(i + 1 < argc)
+                            || sscanf(argv[++i], "%dx%d+%d+%d%c",
+                                      &crop.width, &crop.height, &crop.x,
+                                      &crop.y, &rest) != 4
+                            || crop.width < 1 || crop.height < 1
+                            || crop.x < 0 || crop.y < 0) {
+                                fprintf(stderr, "Crop must be WxH+X+Y\n");
+                                usage(argv[0]);
+                        }
+                        cropping = true;
                 } else if (strcmp(argv[i], "-time") == 0) {
                         if (!(i + 1 < argc)) {      /* no time file */
                                 usage(argv[0]);
                         }
                         time_file_name = argv[++i];
-                
+                } else if (strcmp(argv[i], "-snapshot") == 0) {
+                        if (!(i + 1 < argc)) {      /* no snapshot file */
+                                usage(argv[0]);
+                        }
+                        snapshot_file = argv[++i];
                 } else if (strcmp(argv[i], "-transpose") == 0) {
                         direction = "transpose";
                         otherTrans = "-flip";
@@ -583,6 +1022,17 @@ int main(int argc, char *argv[])
                 }
         }
 
+        if (threads > 1 && parallel_map == NULL) {
+                fprintf(stderr, "%s: the chosen mapping has no parallel "
+                                "version\n", argv[0]);
+                exit(1);
+        }
+        if (first_touch && methods->new_first_touch == NULL) {
+                fprintf(stderr, "%s: -first-touch needs -slab-major\n", 
+                        argv[0]);
+                exit(1);
+        }
+
         /* Open the file from command line or standard input */
         FILE *picFile = NULL;
 
@@ -595,11 +1045,60 @@ int main(int argc, char *argv[])
         
         assert(picFile != NULL);
 
-        /* Begin the transformation */
-        start_transform(picFile, rotation, time_file_name, map, methods, 
+        /* Snapshots, read or written, are always held by the mapped suite */
+        Pnm_ppm image = read_snapshot(picFile);
+        if (image != NULL || snapshot_file != NULL) {
+                if (threads > 1 || first_touch || cropping) {
+                        fprintf(stderr, "%s: snapshots cannot be used with "
+                                        "-threads, -first-touch or -crop\n",
+                                        argv[0]);
+                        exit(1);
+                }
+                if (chosen_map != NULL
+                    && methods != uarray2_methods_mapped) {
+                        fprintf(stderr, "%s: snapshots are held by the "
+                                        "mapped suite and cannot be used "
+                                        "with %s\n", argv[0], chosen_map);
+                        exit(1);
+                }
+                if (methods != uarray2_methods_mapped) {
+                        SET_METHODS(uarray2_methods_mapped, map_block_major,
+                                    "mapped block-major");
+                }
+        }
+
+        /* An image too big for memory goes to a scratch file instead, unless
+           the options need an in-memory suite or chose the mapping */
+        if (image == NULL && threads <= 1 && !first_touch && !cropping
+            && methods != uarray2_methods_mapped
+            && image_bytes(picFile) > a2mapped_threshold()) {
+                if (chosen_map == NULL) {
+                        SET_METHODS(uarray2_methods_mapped, map_block_major,
+                                    "mapped block-major");
+                } else {
+                        fprintf(stderr, "%s: warning: the image may not fit "
+                                        "in memory; keeping %s as asked "
+                                        "(-mapped would page it to disk)\n",
+                                argv[0], chosen_map);
+                }
+        }
+        if (cropping && methods->view == NULL) {
+                fprintf(stderr, "%s: -crop needs -row-major, -col-major, "
+                                "-block-major or -pow2-block\n", argv[0]);
+                exit(1);
+        }
+
+        /* Read in the image data from file, then begin the transformation */
+        if (image == NULL) {
+                image = Pnm_ppmread(picFile, methods);
+        }
+        start_transform(image, rotation, time_file_name, map, methods, 
                 otherTrans, direction);
 
         fclose(picFile);
+        if (cache_stats != NULL) {
+                CacheStats_free(&cache_stats);
+        }
 
         return EXIT_SUCCESS; 
 }
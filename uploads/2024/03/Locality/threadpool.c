@@ -0,0 +1,545 @@
+/*
+ *     threadpool.c
+ *     locality
+ *
+ *     Implementation of a persistent pool of worker threads that balances
+ *     each job by work stealing
+ */
+#define _GNU_SOURCE     /* pthread_setaffinity_np and the CPU_* macros */
+#include "threadpool.h"
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define T ThreadPool_T
+
+/* keeps each worker's hot fields off the cache lines of its neighbours */
+#define CACHE_LINE 64
+
+/* results of taking from or stealing out of a deque */
+#define EMPTY (-1L)
+#define ABORT (-2L)
+
+/*
+ * One worker's deque and counters. A job gives worker w the contiguous task
+ * range [first, last), stored as slots 0 .. last - first - 1 with slot k
+ * holding task last - 1 - k. The owner takes slots from the bottom end, so
+ * it runs its tasks in increasing order; thieves steal from the top end,
+ * taking the owner's highest numbered tasks, which it would have reached
+ * last. Slots in [top, bottom) are still unclaimed. top only moves by
+ * compare-and-swap, which is what makes the last slot safe to race for.
+ */
+struct worker {
+        long top;                       /* advanced by thieves and owner */
+        char pad1[CACHE_LINE - sizeof(long)];
+        long bottom;                    /* written only by the owner */
+        int first, last;
+        long tasks, steals;             /* counters for ThreadPool_stats */
+        double busy;
+        char pad2[CACHE_LINE - 3 * sizeof(long) - 2 * sizeof(int)
+                  - sizeof(double)];
+};
+
+/* what a helper thread needs to find its pool and its worker number */
+struct helper {
+        T pool;
+        int worker;
+};
+
+/*Structure storing the helper threads, the CPU each worker runs on, the lock
+and condition variables that hand jobs to them, the per-worker deques, and
+the job currently being run. A new job is announced by bumping generation;
+running counts the helpers that have not finished it*/
+struct T {
+        int nthreads;
+        pthread_t *threads;             /* helpers 1 .. nthreads - 1 */
+        struct helper *helpers;
+        struct worker *workers;         /* one per thread, caller first */
+        int *cpus;                      /* worker w's CPU, or -1 */
+        pthread_mutex_t lock;
+        pthread_cond_t start, done;
+        unsigned long generation;
+        int running;
+        bool quit;
+
+        void (*task)(int i, int worker, void *cl);
+        void *cl;
+        int ntasks, nworkers;
+        bool stealing;                  /* false for a static job */
+};
+
+static T shared = NULL;
+
+/*************take*****************************************************
+*
+* Removes the bottom slot of a worker's own deque
+*
+* Parameters: struct worker *self: the deque of the calling worker
+*
+* Return: the slot taken, or EMPTY when the deque has nothing left
+*
+* Notes: Chase-Lev take. The owner publishes the smaller bottom before
+* reading top, so a thief that read the old bottom must win or lose the
+* compare-and-swap on top for the last slot rather than both taking it.
+*
+*********************************************************************/
+static long take(struct worker *self)
+{
+        long b = __atomic_load_n(&self->bottom, __ATOMIC_RELAXED) - 1;
+        __atomic_store_n(&self->bottom, b, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        long t = __atomic_load_n(&self->top, __ATOMIC_RELAXED);
+
+        if (t > b) {                    /* already empty */
+                __atomic_store_n(&self->bottom, b + 1, __ATOMIC_RELAXED);
+                return EMPTY;
+        }
+        if (t == b) {                   /* the last slot: race the thieves */
+                bool won = __atomic_compare_exchange_n(&self->top, &t, t + 1,
+                                                       false,
+                                                       __ATOMIC_SEQ_CST,
+                                                       __ATOMIC_RELAXED);
+                __atomic_store_n(&self->bottom, b + 1, __ATOMIC_RELAXED);
+                return won ? b : EMPTY;
+        }
+        return b;
+}
+
+/*************steal****************************************************
+*
+* Removes the top slot of another worker's deque without taking any lock
+*
+* Parameters: struct worker *victim: the deque to steal from
+*
+* Return: the slot stolen, EMPTY when the deque has nothing left, or ABORT
+* when another thread claimed the top slot first and the steal may be retried
+*
+*********************************************************************/
+static long steal(struct worker *victim)
+{
+        long t = __atomic_load_n(&victim->top, __ATOMIC_ACQUIRE);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        long b = __atomic_load_n(&victim->bottom, __ATOMIC_ACQUIRE);
+
+        if (t >= b) {
+                return EMPTY;
+        }
+        if (!__atomic_compare_exchange_n(&victim->top, &t, t + 1, false,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                return ABORT;
+        }
+        return t;
+}
+
+static double now(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* runs the task in a slot of owner's deque on behalf of worker self */
+static void run_slot(T pool, struct worker *self, int worker,
+                     struct worker *owner, long slot)
+{
+        double started = now();
+        pool->task(owner->last - 1 - (int)slot, worker, pool->cl);
+        self->busy += now() - started;
+        self->tasks++;
+}
+
+/*************run_worker***********************************************
+*
+* Runs one worker's share of the current job: first its own deque, then
+* whatever it can steal from the other workers
+*
+* Parameters: T pool: the pool whose job is being run
+*             int worker: the worker number, in [0, nworkers)
+*
+* Return: nothing, once every deque of the job is empty
+*
+* Notes: jobs never add tasks, so a worker that finds every deque empty can
+* stop; the tasks still running belong to workers that will finish them.
+* Victims are tried in order starting with the next worker up. A worker of
+* a static job stops when its own deque is empty.
+*
+*********************************************************************/
+static void run_worker(T pool, int worker)
+{
+        struct worker *self = &pool->workers[worker];
+        int nworkers = pool->nworkers;
+        long slot;
+
+        while ((slot = take(self)) != EMPTY) {
+                run_slot(pool, self, worker, self, slot);
+        }
+
+        bool found = pool->stealing && nworkers > 1;
+        while (found) {
+                found = false;
+                for (int k = 1; k < nworkers && !found; k++) {
+                        struct worker *victim =
+                                &pool->workers[(worker + k) % nworkers];
+                        do {
+                                slot = steal(victim);
+                        } while (slot == ABORT);
+                        if (slot != EMPTY) {
+                                self->steals++;
+                                run_slot(pool, self, worker, victim, slot);
+                                found = true;
+                        }
+                }
+        }
+}
+
+/* body of every helper thread: wait for a job, run a share, report back */
+static void *helper_main(void *arg)
+{
+        struct helper *self = arg;
+        T pool = self->pool;
+        unsigned long seen = 0;
+
+        pthread_mutex_lock(&pool->lock);
+        for (;;) {
+                while (pool->generation == seen && !pool->quit) {
+                        pthread_cond_wait(&pool->start, &pool->lock);
+                }
+                if (pool->quit) {
+                        break;
+                }
+                seen = pool->generation;
+                pthread_mutex_unlock(&pool->lock);
+
+                if (self->worker < pool->nworkers) {
+                        run_worker(pool, self->worker);
+                }
+
+                pthread_mutex_lock(&pool->lock);
+                if (--pool->running == 0) {
+                        pthread_cond_signal(&pool->done);
+                }
+        }
+        pthread_mutex_unlock(&pool->lock);
+        return NULL;
+}
+
+/*
+ * the CPUs this thread may run on, in increasing order, dealt out to the
+ * workers round the list; every entry is -1 where that cannot be found
+ */
+static void find_cpus(int *cpus, int nthreads)
+{
+        for (int w = 0; w < nthreads; w++) {
+                cpus[w] = -1;
+        }
+#ifdef CPU_SET
+        cpu_set_t set;
+        if (sched_getaffinity(0, sizeof(set), &set) != 0
+            || CPU_COUNT(&set) == 0) {
+                return;
+        }
+        int cpu = -1;
+        for (int w = 0; w < nthreads; w++) {
+                do {
+                        cpu = (cpu + 1) % CPU_SETSIZE;
+                } while (!CPU_ISSET(cpu, &set));
+                cpus[w] = cpu;
+        }
+#endif
+}
+
+/* keeps a thread on one CPU; placement is a hint, so failures are ignored */
+static void pin(pthread_t thread, int cpu)
+{
+#ifdef CPU_SET
+        if (cpu >= 0) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                (void)pthread_setaffinity_np(thread, sizeof(set), &set);
+        }
+#else
+        (void)thread;
+        (void)cpu;
+#endif
+}
+
+/*************ThreadPool_new*******************************************
+*
+* Function that starts a pool of worker threads
+*
+* Parameters: int nthreads: the number of workers, counting the caller
+*
+* Return: the new pool, with nthreads - 1 helper threads waiting for work,
+* each pinned to its CPU, and every statistic at zero
+*
+* Expects: nthreads > 0 and the helper threads can be created
+*
+*********************************************************************/
+extern T ThreadPool_new(int nthreads)
+{
+        assert(nthreads > 0);
+        T pool = malloc(sizeof(*pool));
+        assert(pool != NULL);
+        pool->nthreads = nthreads;
+        pool->generation = 0;
+        pool->running = 0;
+        pool->quit = false;
+        pool->task = NULL;
+        pool->cl = NULL;
+        pool->ntasks = 0;
+        pool->nworkers = 0;
+        pool->stealing = true;
+        pthread_mutex_init(&pool->lock, NULL);
+        pthread_cond_init(&pool->start, NULL);
+        pthread_cond_init(&pool->done, NULL);
+
+        void *workers = NULL;
+        int failed = posix_memalign(&workers, CACHE_LINE,
+                                    nthreads * sizeof(struct worker));
+        assert(failed == 0);
+        (void)failed;
+        memset(workers, 0, nthreads * sizeof(struct worker));
+        pool->workers = workers;
+
+        /* one spare slot each keeps the sizes nonzero for a lone worker */
+        pool->threads = malloc(nthreads * sizeof(pthread_t));
+        pool->helpers = malloc(nthreads * sizeof(struct helper));
+        pool->cpus = malloc(nthreads * sizeof(int));
+        assert(pool->threads != NULL && pool->helpers != NULL
+               && pool->cpus != NULL);
+        find_cpus(pool->cpus, nthreads);
+        for (int w = 1; w < nthreads; w++) {
+                pool->helpers[w - 1].pool = pool;
+                pool->helpers[w - 1].worker = w;
+                failed = pthread_create(&pool->threads[w - 1], NULL,
+                                        helper_main, &pool->helpers[w - 1]);
+                assert(failed == 0);
+                pin(pool->threads[w - 1], pool->cpus[w]);
+        }
+        return pool;
+}
+
+/*************ThreadPool_free******************************************
+*
+* Function that stops the helper threads of a pool and frees it
+*
+* Parameters: T *pool: pointer to a pool that is not running a job
+*
+* Return: nothing, but *pool is set to NULL
+*
+* Expects: pool and *pool are not NULL
+*
+*********************************************************************/
+extern void ThreadPool_free(T *pool)
+{
+        assert(pool != NULL && *pool != NULL);
+        T p = *pool;
+
+        pthread_mutex_lock(&p->lock);
+        p->quit = true;
+        pthread_cond_broadcast(&p->start);
+        pthread_mutex_unlock(&p->lock);
+        for (int w = 1; w < p->nthreads; w++) {
+                pthread_join(p->threads[w - 1], NULL);
+        }
+
+        pthread_cond_destroy(&p->done);
+        pthread_cond_destroy(&p->start);
+        pthread_mutex_destroy(&p->lock);
+        if (shared == p) {
+                shared = NULL;
+        }
+        free(p->workers);
+        free(p->cpus);
+        free(p->helpers);
+        free(p->threads);
+        free(p);
+        *pool = NULL;
+}
+
+extern int ThreadPool_nthreads(T pool)
+{
+        assert(pool != NULL);
+        return pool->nthreads;
+}
+
+/* starts a job on every worker it needs and takes part as worker 0; a
+   static job has no stealing */
+static void run_job(T pool, int ntasks, int nworkers,
+                    void task(int i, int worker, void *cl), void *cl,
+                    bool stealing)
+{
+        assert(pool != NULL);
+        assert(ntasks >= 0);
+        assert(nworkers > 0 && nworkers <= pool->nthreads);
+
+        pool->task = task;
+        pool->cl = cl;
+        pool->ntasks = ntasks;
+        pool->nworkers = nworkers;
+        pool->stealing = stealing;
+        for (int w = 0; w < nworkers; w++) {
+                struct worker *deque = &pool->workers[w];
+                deque->first = (int)((long)ntasks * w / nworkers);
+                deque->last = (int)((long)ntasks * (w + 1) / nworkers);
+                deque->top = 0;
+                deque->bottom = deque->last - deque->first;
+        }
+        if (nworkers == 1) {
+                run_worker(pool, 0);
+                return;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->running = pool->nthreads - 1;
+        pool->generation++;
+        pthread_cond_broadcast(&pool->start);
+        pthread_mutex_unlock(&pool->lock);
+
+        run_worker(pool, 0);
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->running > 0) {
+                pthread_cond_wait(&pool->done, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+}
+
+/*************ThreadPool_for*******************************************
+*
+* Runs a job of independent tasks on the pool and waits for all of them
+*
+* Parameters: T pool: a pool that is not already running a job
+*             int ntasks: the number of tasks, at least 0
+*             int nworkers: how many of the pool's workers to use
+*             void task: called once for every task number with the number
+*                   of the worker running it and the closure
+*             void *cl: a closure statement passed to every task
+*
+* Return: nothing, once every task has returned
+*
+* Expects: 0 < nworkers <= the pool's thread count
+*
+* Notes: every worker's deque starts with a contiguous range of the tasks,
+* the ranges differing in length by at most one. A one-worker job runs on
+* the caller alone. Otherwise every helper wakes up, and those beyond
+* nworkers go straight back to sleep.
+*
+*********************************************************************/
+extern void ThreadPool_for(T pool, int ntasks, int nworkers,
+                           void task(int i, int worker, void *cl), void *cl)
+{
+        run_job(pool, ntasks, nworkers, task, cl, true);
+}
+
+/*************ThreadPool_for_static************************************
+*
+* Runs a job of independent tasks on the pool with a fixed split, and waits
+* for all of them
+*
+* Parameters: as for ThreadPool_for
+*
+* Return: nothing, once every task has returned
+*
+* Expects: 0 < nworkers <= the pool's thread count
+*
+* Notes: the caller is pinned to worker 0's CPU for the length of the job
+* and then given back the CPUs it had, so each task number lands on the
+* same CPU in every static job of the same shape
+*
+*********************************************************************/
+extern void ThreadPool_for_static(T pool, int ntasks, int nworkers,
+                                  void task(int i, int worker, void *cl),
+                                  void *cl)
+{
+        assert(pool != NULL);
+#ifdef CPU_SET
+        cpu_set_t old;
+        int pinned = pool->cpus[0] >= 0
+                     && pthread_getaffinity_np(pthread_self(), sizeof(old),
+                                               &old) == 0;
+        if (pinned) {
+                pin(pthread_self(), pool->cpus[0]);
+        }
+#endif
+        run_job(pool, ntasks, nworkers, task, cl, false);
+#ifdef CPU_SET
+        if (pinned) {
+                (void)pthread_setaffinity_np(pthread_self(), sizeof(old),
+                                             &old);
+        }
+#endif
+}
+
+/*************ThreadPool_stats*****************************************
+*
+* Reports what one worker has done since the pool was made or its
+* statistics were last reset
+*
+* Parameters: T pool: a pool that is not running a job
+*             int worker: a worker number, in [0, ThreadPool_nthreads)
+*
+* Return: the number of tasks the worker ran, how many of them it stole
+* from other workers, and the nanoseconds it spent inside tasks
+*
+*********************************************************************/
+extern ThreadPool_Stats ThreadPool_stats(T pool, int worker)
+{
+        assert(pool != NULL);
+        assert(worker >= 0 && worker < pool->nthreads);
+        struct worker *w = &pool->workers[worker];
+        ThreadPool_Stats stats = { w->tasks, w->steals, w->busy };
+        return stats;
+}
+
+extern void ThreadPool_reset_stats(T pool)
+{
+        assert(pool != NULL);
+        for (int w = 0; w < pool->nthreads; w++) {
+                pool->workers[w].tasks = 0;
+                pool->workers[w].steals = 0;
+                pool->workers[w].busy = 0;
+        }
+}
+
+/* stops the shared pool's helpers when the program exits */
+static void free_shared(void)
+{
+        if (shared != NULL) {
+                ThreadPool_free(&shared);
+        }
+}
+
+/*************ThreadPool_shared****************************************
+*
+* Returns a pool with at least the requested number of workers, reusing the
+* one made by an earlier call whenever it is large enough
+*
+* Parameters: int nthreads: the number of workers needed, counting the caller
+*
+* Return: the program-wide pool
+*
+* Expects: nthreads > 0; not called while the shared pool is running a job
+*
+* Notes: replacing the pool with a larger one starts its statistics over
+*
+*********************************************************************/
+extern T ThreadPool_shared(int nthreads)
+{
+        assert(nthreads > 0);
+        if (shared != NULL && shared->nthreads >= nthreads) {
+                return shared;
+        }
+        if (shared == NULL) {
+                atexit(free_shared);
+        } else {
+                ThreadPool_free(&shared);
+        }
+        shared = ThreadPool_new(nthreads);
+        return shared;
+}
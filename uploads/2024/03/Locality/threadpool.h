@@ -0,0 +1,76 @@
+/*
+ *     threadpool.h
+ *     locality
+ *
+ *     A fixed set of worker threads that stay alive between jobs, so a
+ *     parallel map pays for thread creation once per program rather than
+ *     once per traversal. A job is a count of independent tasks; the pool
+ *     runs task(i, worker, cl) for every i in [0, ntasks) and returns when
+ *     all of them have finished. The calling thread takes part as worker 0.
+ *
+ *     Each worker starts with a contiguous range of task numbers in its own
+ *     deque, so tasks that are adjacent in storage stay on the same worker.
+ *     A worker that runs out steals single tasks from the far end of other
+ *     workers' ranges without taking a lock, so partial edge blocks or
+ *     content that is slow to process do not leave threads idle. Per-worker
+ *     counters show how well a job was balanced.
+ *
+ *     Worker w runs on the w-th CPU the program may use, counting round
+ *     the list when there are more workers than CPUs: helpers are pinned
+ *     when the pool is made, and the caller while it runs a static job. So
+ *     ThreadPool_for_static gives task i to the same CPU, and therefore
+ *     the same NUMA node, every time it is called with the same ntasks
+ *     and nworkers. Where threads cannot be pinned, they are not.
+ *
+ *     A pool runs one job at a time. Starting a job from inside a task, or
+ *     from two threads at once, is an unchecked runtime error.
+ */
+
+#ifndef THREADPOOL_INCLUDED
+#define THREADPOOL_INCLUDED
+
+#define T ThreadPool_T
+typedef struct T *T;
+
+/* one worker's work since the pool was made or last reset */
+typedef struct ThreadPool_Stats {
+        long tasks;     /* tasks run, including stolen ones */
+        long steals;    /* tasks taken from another worker's range */
+        double busy;    /* nanoseconds of wall time spent inside tasks */
+} ThreadPool_Stats;
+
+/* a pool of nthreads workers, counting the caller; nthreads > 0 */
+extern T    ThreadPool_new (int nthreads);
+extern void ThreadPool_free(T *pool);
+
+extern int  ThreadPool_nthreads(T pool);
+
+/*
+ * runs task(i, worker, cl) for i in [0, ntasks) on the first nworkers
+ * workers; 0 < nworkers <= ThreadPool_nthreads(pool). worker numbers are
+ * in [0, nworkers)
+ */
+extern void ThreadPool_for(T pool, int ntasks, int nworkers,
+                           void task(int i, int worker, void *cl), void *cl);
+
+/*
+ * like ThreadPool_for, but without stealing: worker w runs exactly the
+ * tasks [ntasks * w / nworkers, ntasks * (w + 1) / nworkers), on its own
+ * CPU
+ */
+extern void ThreadPool_for_static(T pool, int ntasks, int nworkers,
+                                  void task(int i, int worker, void *cl),
+                                  void *cl);
+
+/* statistics of a worker in [0, ThreadPool_nthreads); the pool must be idle */
+extern ThreadPool_Stats ThreadPool_stats      (T pool, int worker);
+extern void             ThreadPool_reset_stats(T pool);
+
+/*
+ * the program-wide pool, created on first use and replaced by a larger one
+ * when a caller asks for more workers than it has
+ */
+extern T    ThreadPool_shared(int nthreads);
+
+#undef T
+#endif
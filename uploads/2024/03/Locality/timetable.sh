@@ -0,0 +1,39 @@
+#!/bin/sh
+#
+#     timetable.sh
+#     locality
+#
+#     Times 90 and 180 degree ppmtrans rotations of one image under each
+#     mapping and prints the results in the table format used in README.
+#
+#     Usage: ./timetable.sh image.ppm [mapping ...]
+#
+#     Mappings are ppmtrans -<mapping>-major names (row, col, recursive, block,
+#     slab, tiled, zorder); the default is row col recursive block tiled
+#     zorder.
+#
+
+if [ $# -lt 1 ]; then
+        echo "Usage: $0 image.ppm [mapping ...]" >&2
+        exit 1
+fi
+image=$1
+shift
+mappings=${*:-row col recursive block tiled zorder}
+timefile=$(mktemp)
+trap 'rm -f "$timefile"' EXIT
+
+# prints "<total ns> <ns per pixel>" for one run
+run() {
+        ./ppmtrans -rotate "$2" "-$1-major" -time "$timefile" "$image" \
+                > /dev/null || exit 1
+        awk '{ print $5, $12 }' "$timefile"
+}
+
+echo "                |    90 degrees     |    180 Degrees    |"
+for m in $mappings; do
+        set -- $(run "$m" 90) $(run "$m" 180)
+        echo "---------------------------------------------------------"
+        printf "%-16s| %11.0f ns    | %11.0f ns    |\n" "$m-major" "$1" "$3"
+        printf "%-16s| %10f ns/px | %10f ns/px |\n" "" "$2" "$4"
+done
@@ -0,0 +1,479 @@
+/*
+ *     uarray2.hpp
+ *     locality
+ *
+ *     Typed two dimensional arrays for C++ code. a2::UArray2<T, Layout>
+ *     holds cells of type T laid out by Layout: a2::RowMajor, a2::Blocked<B>
+ *     or a2::Morton. Both the type and the layout are known at compile time,
+ *     so at() and for_each() inline into the caller, including the function
+ *     for_each calls. A kernel written as a template over T and Layout gets
+ *     the address arithmetic of its own layout and no calls through
+ *     A2Methods_T.
+ *
+ *     Each array is also an A2Methods_UArray2 of its own methods suite,
+ *     so C code written against A2Methods (ppmtrans's apply functions,
+ *     A2Methods_convert) can take it as it is.
+ *
+ *     The header only needs the C++11 standard library and bigalloc.o.
+ */
+
+#ifndef UARRAY2_HPP_INCLUDED
+#define UARRAY2_HPP_INCLUDED
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+extern "C" {
+#include "bigalloc.h"
+/* struct A2Methods_T has a member named new, a keyword in C++ */
+#define new new_array
+#include "a2methods.h"
+#undef new
+}
+
+namespace a2 {
+
+/* a methods suite; C spells this A2Methods_T */
+typedef struct ::A2Methods_T *Methods;
+
+/*
+ * A layout maps each cell (i, j) of a width x height array to a slot of its
+ * storage. A layout class has:
+ *
+ *      Layout(width, height)
+ *      size_t slots()          slots of storage, counting padding
+ *      size_t index(i, j)      the slot of cell (i, j)
+ *      for_each(f)             f(i, j, slot) for every cell, in slot order
+ *      blocked, blocksize      whether the array counts as blocked for
+ *                              A2Methods, and its block edge
+ *      has_runs, for_each_run  for layouts made of strided runs: f(col,
+ *                              row, width, height, first slot, column step,
+ *                              row step) per run, steps counted in slots
+ */
+
+/* cells row by row; each row is one run */
+class RowMajor {
+public:
+        static const bool blocked = false;
+        static const bool has_runs = true;
+        static const int blocksize = 1;
+
+        RowMajor(int width, int height) : width_(width), height_(height) {}
+
+        size_t slots() const { return (size_t)width_ * height_; }
+
+        size_t index(int i, int j) const
+        {
+                return (size_t)j * width_ + i;
+        }
+
+        template <class F> void for_each(F f) const
+        {
+                size_t slot = 0;
+                for (int j = 0; j < height_; j++) {
+                        for (int i = 0; i < width_; i++) {
+                                f(i, j, slot++);
+                        }
+                }
+        }
+
+        template <class F> void for_each_run(F f) const
+        {
+                for (int j = 0; j < height_; j++) {
+                        f(0, j, width_, 1, (size_t)j * width_, 1, width_);
+                }
+        }
+
+private:
+        int width_, height_;
+};
+
+/* B x B blocks stored row by row of blocks, cells row by row within a
+   block, like the slab suite; a power of two B turns / and % into shifts */
+template <int B>
+class Blocked {
+        static_assert(B > 0, "blocks need at least one cell");
+
+public:
+        static const bool blocked = true;
+        static const bool has_runs = true;
+        static const int blocksize = B;
+
+        Blocked(int width, int height)
+                : width_(width), height_(height),
+                  blocksWide_((width + B - 1) / B),
+                  blocksHigh_((height + B - 1) / B) {}
+
+        size_t slots() const
+        {
+                return (size_t)blocksWide_ * blocksHigh_ * B * B;
+        }
+
+        size_t index(int i, int j) const
+        {
+                return ((size_t)(j / B) * blocksWide_ + i / B) * (B * B)
+                       + (j % B) * B + i % B;
+        }
+
+        template <class F> void for_each(F f) const
+        {
+                for_each_run([&](int col, int row, int cols, int rows,
+                                 size_t first, int, int) {
+                        for (int r = 0; r < rows; r++) {
+                                size_t slot = first + (size_t)r * B;
+                                for (int c = 0; c < cols; c++) {
+                                        f(col + c, row + r, slot++);
+                                }
+                        }
+                });
+        }
+
+        template <class F> void for_each_run(F f) const
+        {
+                size_t first = 0;
+                for (int by = 0; by < blocksHigh_; by++) {
+                        for (int bx = 0; bx < blocksWide_; bx++) {
+                                int col = bx * B;
+                                int row = by * B;
+                                int cols = width_ - col < B ? width_ - col
+                                                            : B;
+                                int rows = height_ - row < B ? height_ - row
+                                                             : B;
+                                f(col, row, cols, rows, first, 1, B);
+                                first += B * B;
+                        }
+                }
+        }
+
+private:
+        int width_, height_;
+        int blocksWide_, blocksHigh_;
+};
+
+namespace detail {
+
+/* the bit ladders of uarray2z.c: spread the bits of x to the even bit
+   positions, and gather them back */
+inline uint64_t spread(uint32_t x)
+{
+#if defined(__BMI2__)
+        return _pdep_u64(x, UINT64_C(0x5555555555555555));
+#else
+        uint64_t v = x;
+        v = (v | (v << 16)) & UINT64_C(0x0000FFFF0000FFFF);
+        v = (v | (v <<  8)) & UINT64_C(0x00FF00FF00FF00FF);
+        v = (v | (v <<  4)) & UINT64_C(0x0F0F0F0F0F0F0F0F);
+        v = (v | (v <<  2)) & UINT64_C(0x3333333333333333);
+        v = (v | (v <<  1)) & UINT64_C(0x5555555555555555);
+        return v;
+#endif
+}
+
+inline uint32_t gather(uint64_t v)
+{
+#if defined(__BMI2__)
+        return (uint32_t)_pext_u64(v, UINT64_C(0x5555555555555555));
+#else
+        v &= UINT64_C(0x5555555555555555);
+        v = (v | (v >>  1)) & UINT64_C(0x3333333333333333);
+        v = (v | (v >>  2)) & UINT64_C(0x0F0F0F0F0F0F0F0F);
+        v = (v | (v >>  4)) & UINT64_C(0x00FF00FF00FF00FF);
+        v = (v | (v >>  8)) & UINT64_C(0x0000FFFF0000FFFF);
+        v = (v | (v >> 16)) & UINT64_C(0x00000000FFFFFFFF);
+        return (uint32_t)v;
+#endif
+}
+
+/* smallest lg such that 1 << lg >= n */
+inline int ceil_lg(int n)
+{
+        int lg = 0;
+        while ((1L << lg) < n) {
+                lg++;
+        }
+        return lg;
+}
+
+} // namespace detail
+
+/* the Z-order of uarray2z.c: each dimension padded to a power of two, the
+   low bits of column and row interleaved and the longer side's high bits
+   above them */
+class Morton {
+public:
+        static const bool blocked = true;
+        static const bool has_runs = false;
+        static const int blocksize = 1;
+
+        Morton(int width, int height)
+                : width_(width), height_(height),
+                  lgWidth_(detail::ceil_lg(width)),
+                  lgHeight_(detail::ceil_lg(height)),
+                  lgSquare_(lgWidth_ < lgHeight_ ? lgWidth_ : lgHeight_) {}
+
+        size_t slots() const
+        {
+                return (size_t)1 << (lgWidth_ + lgHeight_);
+        }
+
+        size_t index(int i, int j) const
+        {
+                uint32_t low = (1u << lgSquare_) - 1;
+                uint64_t square = detail::spread(i & low)
+                                  | (detail::spread(j & low) << 1);
+                uint64_t high = (uint64_t)((i | j) >> lgSquare_);
+                return (size_t)(square | (high << (2 * lgSquare_)));
+        }
+
+        template <class F> void for_each(F f) const
+        {
+                size_t n = slots();
+                uint64_t low = ((uint64_t)1 << (2 * lgSquare_)) - 1;
+                for (size_t slot = 0; slot < n; slot++) {
+                        int i = detail::gather(slot & low);
+                        int j = detail::gather((slot & low) >> 1);
+                        int high = (int)(slot >> (2 * lgSquare_))
+                                   << lgSquare_;
+                        if (lgWidth_ > lgHeight_) {
+                                i |= high;
+                        } else {
+                                j |= high;
+                        }
+                        if (i < width_ && j < height_) {
+                                f(i, j, slot);
+                        }
+                }
+        }
+
+private:
+        int width_, height_;
+        int lgWidth_, lgHeight_, lgSquare_;
+};
+
+/*
+ * A width x height array of T in the given layout. T must be trivially
+ * copyable, since cells start zeroed, as in the C suites, and are never
+ * constructed or destroyed. Out of range indices are checked with assert.
+ */
+template <class T, class Layout>
+class UArray2 {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "cells are zeroed and copied as bytes");
+
+public:
+        UArray2(int width, int height)
+                : width_(width), height_(height), layout_(width, height),
+                  bytes_(layout_.slots() * sizeof(T)),
+                  elems_(bytes_ > 0 ? (T *)BigAlloc_new(bytes_) : nullptr)
+        {
+                assert(width >= 0 && height >= 0);
+        }
+
+        ~UArray2()
+        {
+                if (elems_ != nullptr) {
+                        BigAlloc_free(elems_, bytes_);
+                }
+        }
+
+        UArray2(const UArray2 &) = delete;
+        UArray2 &operator=(const UArray2 &) = delete;
+
+        int width() const { return width_; }
+        int height() const { return height_; }
+
+        T &at(int i, int j)
+        {
+                assert(i >= 0 && i < width_ && j >= 0 && j < height_);
+                return elems_[layout_.index(i, j)];
+        }
+
+        const T &at(int i, int j) const
+        {
+                assert(i >= 0 && i < width_ && j >= 0 && j < height_);
+                return elems_[layout_.index(i, j)];
+        }
+
+        /* calls f(i, j, cell) for every cell, in storage order */
+        template <class F> void for_each(F f)
+        {
+                T *elems = elems_;
+                layout_.for_each([&](int i, int j, size_t slot) {
+                        f(i, j, elems[slot]);
+                });
+        }
+
+        /* this array as an array of methods() */
+        A2Methods_UArray2 a2() { return this; }
+
+        /* the methods suite of every UArray2<T, Layout> */
+        static Methods methods() { return &suite; }
+
+private:
+        int width_, height_;
+        Layout layout_;
+        size_t bytes_;
+        T *elems_;
+
+        typedef UArray2 Self;
+        typedef A2Methods_UArray2 A2;
+
+        static Self *self(A2 array2) { return static_cast<Self *>(array2); }
+
+        static A2 a2_new(int width, int height, int size)
+        {
+                assert(size == (int)sizeof(T));
+                (void)size;
+                return new Self(width, height);
+        }
+
+        /* the block size is part of the type */
+        static A2 a2_new_with_blocksize(int width, int height, int size,
+                                        int blocksize)
+        {
+                (void)blocksize;
+                return a2_new(width, height, size);
+        }
+
+        static void a2_free(A2 *array2p)
+        {
+                assert(array2p != nullptr && *array2p != nullptr);
+                delete self(*array2p);
+                *array2p = nullptr;
+        }
+
+        static int a2_width(A2 array2) { return self(array2)->width_; }
+        static int a2_height(A2 array2) { return self(array2)->height_; }
+        static int a2_size(A2) { return sizeof(T); }
+        static int a2_blocksize(A2) { return Layout::blocksize; }
+
+        static A2Methods_Object *a2_at(A2 array2, int i, int j)
+        {
+                return &self(array2)->at(i, j);
+        }
+
+        static void map_row_major(A2 array2, A2Methods_applyfun apply,
+                                  void *cl)
+        {
+                Self *a = self(array2);
+                for (int j = 0; j < a->height_; j++) {
+                        for (int i = 0; i < a->width_; i++) {
+                                apply(i, j, array2, &a->at(i, j), cl);
+                        }
+                }
+        }
+
+        static void map_col_major(A2 array2, A2Methods_applyfun apply,
+                                  void *cl)
+        {
+                Self *a = self(array2);
+                for (int i = 0; i < a->width_; i++) {
+                        for (int j = 0; j < a->height_; j++) {
+                                apply(i, j, array2, &a->at(i, j), cl);
+                        }
+                }
+        }
+
+        static void map_storage(A2 array2, A2Methods_applyfun apply, void *cl)
+        {
+                self(array2)->for_each([&](int i, int j, T &cell) {
+                        apply(i, j, array2, &cell, cl);
+                });
+        }
+
+        static void small_map_row_major(A2 array2,
+                                        A2Methods_smallapplyfun apply,
+                                        void *cl)
+        {
+                Self *a = self(array2);
+                for (int j = 0; j < a->height_; j++) {
+                        for (int i = 0; i < a->width_; i++) {
+                                apply(&a->at(i, j), cl);
+                        }
+                }
+        }
+
+        static void small_map_col_major(A2 array2,
+                                        A2Methods_smallapplyfun apply,
+                                        void *cl)
+        {
+                Self *a = self(array2);
+                for (int i = 0; i < a->width_; i++) {
+                        for (int j = 0; j < a->height_; j++) {
+                                apply(&a->at(i, j), cl);
+                        }
+                }
+        }
+
+        static void small_map_storage(A2 array2,
+                                      A2Methods_smallapplyfun apply, void *cl)
+        {
+                self(array2)->for_each([&](int, int, T &cell) {
+                        apply(&cell, cl);
+                });
+        }
+
+        static void map_runs(A2 array2, A2Methods_blockapplyfun apply,
+                             void *cl)
+        {
+                Self *a = self(array2);
+                a->layout_.for_each_run([&](int col, int row, int cols,
+                                            int rows, size_t first,
+                                            int colstep, int rowstep) {
+                        apply(col, row, cols, rows, &a->elems_[first],
+                              colstep * (int)sizeof(T),
+                              rowstep * (int)sizeof(T), array2, cl);
+                });
+        }
+
+        /* map_blocks, or NULL for layouts without strided runs */
+        static A2Methods_blockmapfun *runs(std::true_type) { return map_runs; }
+        static A2Methods_blockmapfun *runs(std::false_type) { return nullptr; }
+
+        /* the plain suites map rows and columns, the blocked ones storage
+           order; the default is the fastest of them */
+        static const bool plain = !Layout::blocked;
+
+        static struct ::A2Methods_T suite;
+};
+
+template <class T, class Layout>
+struct ::A2Methods_T UArray2<T, Layout>::suite = {
+        a2_new,
+        a2_new_with_blocksize,
+        a2_free,
+        a2_width,
+        a2_height,
+        a2_size,
+        a2_blocksize,
+        a2_at,
+        plain ? map_row_major : nullptr,
+        plain ? map_col_major : nullptr,
+        plain ? nullptr : map_storage,                  // map_block_major
+        plain ? map_row_major : map_storage,            // map_default
+        plain ? small_map_row_major : nullptr,
+        plain ? small_map_col_major : nullptr,
+        plain ? nullptr : small_map_storage,            // small_map_block_major
+        plain ? small_map_row_major : small_map_storage,
+        runs(std::integral_constant<bool, Layout::has_runs>()),
+        nullptr,                // map_row_major_parallel
+        nullptr,                // map_col_major_parallel
+        nullptr,                // map_block_major_parallel
+        nullptr,                // map_default_parallel
+        nullptr,                // new_first_touch
+        nullptr,                // block_node
+        nullptr,                // view
+        nullptr,                // map_recursive
+        nullptr,                // get
+        nullptr,                // begin
+};
+
+} // namespace a2
+
+#endif
@@ -6,28 +6,178 @@
  *     Implementation of a two dimensional blocked array 
  */
 #include "uarray2b.h"
+#include "uarray2b_pow2.h"
 #include "uarray2.h"
 #include "uarray.h"
 #include <assert.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h> 
 #include <math.h>
 
 #define T UArray2b_T
 
+/* blocks a map looks ahead by default; see UArray2b_prefetch */
+#define PREFETCH_BLOCKS 2
+
+/* how much of a block's first row is asked for ahead of the map: enough to
+   start the hardware's own stream prefetcher on it */
+#define PREFETCH_LINES 4
+#define CACHE_LINE 64
+
+static int prefetch_blocks = PREFETCH_BLOCKS;
+
 int getIndex(int col, int row, int blocksize);
 void apply_free_blocks(int i, int j, UArray2_T array, void *block, void* cl);
 
 /*Structure storing important information accesed by the UArray2b interface
 Stores the width, height, size, and blocksize of the array, as well as a 
-UArray2 of UArrays representing the differnt blocks*/
+UArray2 of UArrays representing the differnt blocks. A view shares the blocks
+of the array it looks into; its cell (0, 0) is cell (col0, row0) of that
+array, and only the array that made the blocks owns them. cells holds the
+first cell of every block, row by row of blocks, so that at() and the maps
+reach a block without a call to UArray2_at and UArray_at*/
 struct T {
         int width, height;
         int size;
         int blocksize;
         UArray2_T blocks; 
+        int col0, row0;
+        bool owner;
+        char **cells;
+        int blocksWide, blocksHigh;
 };
 
+/********************block_span******************************************
+*
+* Function that finds the blocks holding the cells of an array or view
+*
+* Parameters: T a: a UArray2b or a view of one
+*             int *bx0, *bx1: set to the first block column and one past the
+*                   last block column
+*             int *by0, *by1: set to the same for block rows
+*
+* Return: nothing, but the range of blocks is written through the pointers
+*
+*********************************************************************/
+static void block_span(T a, int *bx0, int *bx1, int *by0, int *by1)
+{
+        int b = a->blocksize;
+        *bx0 = a->col0 / b;
+        *by0 = a->row0 / b;
+        *bx1 = a->width == 0 ? *bx0 : (a->col0 + a->width - 1) / b + 1;
+        *by1 = a->height == 0 ? *by0 : (a->row0 + a->height - 1) / b + 1;
+}
+
+/********************prefetch_ahead**************************************
+*
+* Function that asks for the blocks a map will visit soon while it works on
+* block (bx, by)
+*
+* Parameters: T a: a UArray2b or a view of one
+*             int bx, by: the block the map is about to visit
+*
+* Return: nothing
+*
+* Notes: every block is a separate allocation, so it is not near the block
+* before it. The address of the block prefetch_blocks ahead comes from the
+* cells table, which the map walks in order, so asking for it costs no
+* dependent load. Blocks are counted in storage order of the whole array,
+* so a view sometimes asks for a block it will not visit, which costs only
+* the prefetch
+*
+*********************************************************************/
+static void prefetch_ahead(T a, int bx, int by)
+{
+        if (prefetch_blocks == 0) {
+                return;
+        }
+        int near = by * a->blocksWide + bx + prefetch_blocks;
+        if (near < a->blocksWide * a->blocksHigh) {
+                char *cells = a->cells[near];
+                for (int line = 0; line < PREFETCH_LINES; line++) {
+                        __builtin_prefetch(cells + line * CACHE_LINE, 1);
+                }
+        }
+}
+
+/********************clip_block******************************************
+*
+* Function that finds the part of block (bx, by) that lies inside an array
+* or view
+*
+* Parameters: T a: a UArray2b or a view of one
+*             int bx, by: a block in the span of a
+*             int *col, *row: set to the coordinates in a of the first cell
+*                   of the block inside a
+*             int *cols, *rows: set to the extent of the block inside a
+*
+* Return: a pointer to the first cell of the block inside a. Cells of a row
+* are one element apart and rows are a block row apart
+*
+* Notes: every map reaches a block through here, so this is where the
+* blocks ahead are prefetched
+*
+*********************************************************************/
+static char *clip_block(T a, int bx, int by, int *col, int *row, int *cols,
+                        int *rows)
+{
+        int b = a->blocksize;
+        int c0 = bx * b > a->col0 ? bx * b : a->col0;
+        int r0 = by * b > a->row0 ? by * b : a->row0;
+        int c1 = bx * b + b < a->col0 + a->width ? bx * b + b
+                                                 : a->col0 + a->width;
+        int r1 = by * b + b < a->row0 + a->height ? by * b + b
+                                                  : a->row0 + a->height;
+        *col = c0 - a->col0;
+        *row = r0 - a->row0;
+        *cols = c1 - c0;
+        *rows = r1 - r0;
+
+        prefetch_ahead(a, bx, by);
+        char *cells = a->cells[by * a->blocksWide + bx];
+        return cells + ((size_t)(r0 - by * b) * b + (c0 - bx * b)) * a->size;
+}
+
+/*
+ * The loops over the cells of block (bx, by) inside a, row by row, with
+ * VISIT the statement run for each cell in terms of col + c, row + r and
+ * elem. ROWBYTES is the distance between rows of the block. The full and
+ * small maps, generic and power-of-two alike, all expand these loops, so
+ * each calls its client straight from the innermost one
+ */
+#define MAP_BLOCK_CELLS(a, bx, by, ROWBYTES, VISIT)                          \
+        do {                                                                 \
+                int col, row, cols, rows;                                    \
+                char *first = clip_block((a), (bx), (by), &col, &row,       \
+                                         &cols, &rows);                      \
+                size_t rowBytes = (ROWBYTES);                                \
+                int size = (a)->size;                                        \
+                for (int r = 0; r < rows; r++) {                             \
+                        char *elem = first + r * rowBytes;                   \
+                        for (int c = 0; c < cols; c++) {                     \
+                                VISIT;                                       \
+                                elem += size;                                \
+                        }                                                    \
+                }                                                            \
+        } while (0)
+
+/* calls apply for each cell of block (bx, by) inside a, row by row */
+static void map_block(T a, int bx, int by, void apply(int col, int row,
+        T array2b, void *elem, void *cl), void *cl)
+{
+        MAP_BLOCK_CELLS(a, bx, by, (size_t)a->blocksize * a->size,
+                        apply(col + c, row + r, a, elem, cl));
+}
+
+/* the same, for an apply that takes only the element */
+static void small_map_block(T a, int bx, int by, void apply(void *elem,
+        void *cl), void *cl)
+{
+        MAP_BLOCK_CELLS(a, bx, by, (size_t)a->blocksize * a->size,
+                        apply(elem, cl));
+}
+
 /********************getIndex*********************************************
 *
 * Function that calculates an index in the UArray2, converting the 2D
@@ -73,6 +223,9 @@ extern T UArray2b_new(int width, int height, int size, int blocksize)
         new_arr->height = height;
         new_arr->blocksize = blocksize;
         new_arr->size = size;
+        new_arr->col0 = 0;
+        new_arr->row0 = 0;
+        new_arr->owner = true;
         new_arr->blocks = UArray2_new(ceil((double)width / (double)blocksize), 
             ceil((double)height / (double)blocksize), sizeof(UArray_T));
         
@@ -82,10 +235,18 @@ extern T UArray2b_new(int width, int height, int size, int blocksize)
         int numBlocksInRow = ceil((double)width / (double)blocksize);
 
         /*Initlizes the UArray_Ts on our blocks UArray2*/
+        new_arr->blocksWide = numBlocksInRow;
+        new_arr->blocksHigh = numBlocksInCol;
+        /* one spare entry, so an empty array still gets a table */
+        new_arr->cells = malloc((numBlocksInCol * numBlocksInRow + 1) 
+                                * sizeof(char *));
+        assert(new_arr->cells != NULL);
         for (int i = 0; i < numBlocksInCol; i++) {
                 for (int j = 0; j < numBlocksInRow; j++) {
                         UArray_T *thisBlock = UArray2_at(new_arr->blocks, j, i);
                         *thisBlock = UArray_new(blocksize * blocksize, size);
+                        new_arr->cells[i * numBlocksInRow + j] = 
+                                UArray_at(*thisBlock, 0);
                 }
         }
         return new_arr;
@@ -133,17 +294,55 @@ extern T UArray2b_new_64K_block(int width, int height, int size)
 *
 * Expects: UArray2 a is not NULL
 *      
-* Notes: Frees the blocked array as well as the blocks themselves
+* Notes: Frees the blocked array as well as the blocks themselves. Freeing
+* a view frees only the view
 *      
 *******************************************************************/
 extern void UArray2b_free(T *array2b) 
 {
         assert(array2b != NULL);
-        UArray2_map_row_major((*array2b)->blocks, apply_free_blocks, NULL);
-        UArray2_free(&(*array2b)->blocks);
+        if ((*array2b)->owner) {
+                UArray2_map_row_major((*array2b)->blocks, apply_free_blocks,
+                                      NULL);
+                UArray2_free(&(*array2b)->blocks);
+                free((*array2b)->cells);
+        }
         free(*array2b);
 }
 
+/*************UArray2b_view*******************************************
+*
+* Function that makes a window onto part of a UArray2b without copying it
+*
+* Parameters: T array2b: a UArray2b or a view of one
+*             int col, row: the cell of array2b that becomes (0, 0)
+*             int width, height: the dimensions of the window
+*
+* Return: a new UArray2b whose cells are cells of array2b
+*
+* Expects: array2b is not NULL and the window lies inside it
+*
+* Notes: the view must be freed with UArray2b_free before array2b is
+*
+*********************************************************************/
+extern T UArray2b_view(T array2b, int col, int row, int width, int height)
+{
+        assert(array2b != NULL);
+        assert(col >= 0 && row >= 0 && width >= 0 && height >= 0);
+        assert(col + width <= array2b->width);
+        assert(row + height <= array2b->height);
+
+        T view = malloc(sizeof(*view));
+        assert(view != NULL);
+        *view = *array2b;
+        view->width = width;
+        view->height = height;
+        view->col0 = array2b->col0 + col;
+        view->row0 = array2b->row0 + row;
+        view->owner = false;
+        return view;
+}
+
 /*************UArray2b_at*******************************************
 *
 * Function that gets an element at specified indicies in the given uarray2
@@ -156,6 +355,10 @@ extern void UArray2b_free(T *array2b)
 *
 * Expects: array2 is not NULL, indicies are within bounds of array
 *      
+* Notes: the cell comes from the block's entry in cells. The checked build
+* also finds it through the blocks themselves and asserts the two agree; 
+* make fast leaves only the arithmetic
+*      
 *********************************************************************/
 extern void *UArray2b_at(UArray2b_T array2b, int col, int row) 
 {
@@ -163,10 +366,15 @@ extern void *UArray2b_at(UArray2b_T array2b, int col, int row)
         assert(col >= 0 && col < array2b->width);
         assert(row >= 0 && row < array2b->height);
 
+        col += array2b->col0;
+        row += array2b->row0;
         int blocksize = array2b->blocksize;
-        UArray_T *thisBlock = (UArray_T *)UArray2_at(array2b->blocks, 
-                col / blocksize, row / blocksize);
-        void *elem = UArray_at(*thisBlock, getIndex(col, row, blocksize));
+        char *elem = array2b->cells[(row / blocksize) * array2b->blocksWide
+                                    + col / blocksize]
+                     + (size_t)getIndex(col, row, blocksize) * array2b->size;
+        assert(elem == UArray_at(*(UArray_T *)UArray2_at(array2b->blocks, 
+                                        col / blocksize, row / blocksize),
+                                 getIndex(col, row, blocksize)));
         return elem;
 }
 
@@ -261,30 +469,147 @@ extern void UArray2b_map(T array2b, void apply(int col, int row, T array2b,
         void *elem, void *cl), void *cl)
 {
         assert(array2b != NULL);
-        int numBlocks = UArray2_width(array2b->blocks);
+        int bx0, bx1, by0, by1;
+        block_span(array2b, &bx0, &bx1, &by0, &by1);
 
-        int row = 0;
-        int col = 0;
-        
-        /*Loop for each block, then inner nested loop iterates through the 
-        blocks themselves*/
-        for (int blocks = 1; blocks <= numBlocks * numBlocks; blocks++){
-                for (int i = row; i < row + array2b->blocksize 
-                        && i < array2b->height; i++){
-                        for (int j = col; j < col + array2b->blocksize 
-                                && j < array2b->width; j++){   
-                                apply(j, i, array2b, UArray2b_at(array2b, j, i),
-                                        cl);
-                        }
-                }
-                col += array2b->blocksize;
-                if (blocks % numBlocks == 0){
-                        col = 0;
-                        row += array2b->blocksize;
+        /*Loop for each block, then map_block iterates through the block 
+        itself, skipping cells outside the array*/
+        for (int by = by0; by < by1; by++) {
+                for (int bx = bx0; bx < bx1; bx++) {
+                        map_block(array2b, bx, by, apply, cl);
                 }
         } 
 }
 
+extern void UArray2b_small_map(T array2b, void apply(void *elem, void *cl),
+        void *cl)
+{
+        assert(array2b != NULL);
+        int bx0, bx1, by0, by1;
+        block_span(array2b, &bx0, &bx1, &by0, &by1);
+        for (int by = by0; by < by1; by++) {
+                for (int bx = bx0; bx < bx1; bx++) {
+                        small_map_block(array2b, bx, by, apply, cl);
+                }
+        }
+}
+
+/*************UArray2b_map_blocks*****************************
+*
+* Traverses the UArray2b one block at a time and calls the apply function
+* once for each block
+*
+* Parameters: T array2b: a UArray2b that has been initialized
+*          void apply: a function called for each block with the column and
+*          row of its top left cell, the number of columns and rows of the
+*          block inside the array, a pointer to the top left cell, the byte
+*          distance between neighbouring columns and rows, the UArray2b and
+*          the closure
+*          void *cl: a closure statement for the map function
+*
+* Return: nothing, but apply function affects elements of array and closure
+*
+* Notes: cells within a block are stored row by row, so the column stride is
+* the element size and the row stride is a whole block row. Blocks along the
+* right and bottom edges are clipped to the array.
+*
+*********************************************************************/
+extern void UArray2b_map_blocks(T array2b, void apply(int col, int row,
+        int width, int height, void *elems, int colstride, int rowstride,
+        T array2b, void *cl), void *cl)
+{
+        assert(array2b != NULL);
+        int b = array2b->blocksize;
+        int bx0, bx1, by0, by1;
+        block_span(array2b, &bx0, &bx1, &by0, &by1);
+
+        for (int by = by0; by < by1; by++) {
+                for (int bx = bx0; bx < bx1; bx++) {
+                        int col, row, cols, rows;
+                        char *first = clip_block(array2b, bx, by, &col, &row,
+                                                 &cols, &rows);
+                        apply(col, row, cols, rows, first, array2b->size,
+                              b * array2b->size, array2b, cl);
+                }
+        }
+}
+
+/* block n of UArray2b_map_blocks, numbered as UArray2b_map_block_range
+   numbers them */
+extern void *UArray2b_block(T array2b, int n, int *col, int *row, int *width,
+        int *height, int *colstride, int *rowstride)
+{
+        assert(array2b != NULL);
+        assert(0 <= n && n < UArray2b_blockcount(array2b));
+        int bx0, bx1, by0, by1;
+        block_span(array2b, &bx0, &bx1, &by0, &by1);
+        *colstride = array2b->size;
+        *rowstride = array2b->blocksize * array2b->size;
+        return clip_block(array2b, bx0 + n % (bx1 - bx0),
+                          by0 + n / (bx1 - bx0), col, row, width, height);
+}
+
+/*************UArray2b_map_block_range*************************
+*
+* Traverses the blocks numbered first up to but not including last, in the
+* same order as UArray2b_map, and calls the apply function for each element
+*
+* Parameters: T array2b: a UArray2b that has been initialized
+*          int first, last: the range of block numbers to visit. Blocks are
+*          numbered row by row of blocks, from 0 to UArray2b_blockcount - 1
+*          void apply: a function called for each element with its column,
+*          row, the UArray2b, a pointer to the element and the closure
+*          void *cl: a closure statement for the map function
+*
+* Return: nothing, but apply function affects elements of array and closure
+*
+* Notes: disjoint ranges touch disjoint memory, so different threads can map
+* different ranges of the same array at the same time
+*
+*********************************************************************/
+extern void UArray2b_map_block_range(T array2b, int first, int last,
+        void apply(int col, int row, T array2b, void *elem, void *cl),
+        void *cl)
+{
+        assert(array2b != NULL);
+        assert(0 <= first && first <= last
+               && last <= UArray2b_blockcount(array2b));
+        int bx0, bx1, by0, by1;
+        block_span(array2b, &bx0, &bx1, &by0, &by1);
+
+        for (int n = first; n < last; n++) {
+                map_block(array2b, bx0 + n % (bx1 - bx0),
+                          by0 + n / (bx1 - bx0), apply, cl);
+        }
+}
+
+/* the number of blocks, including partial blocks along the edges */
+extern int UArray2b_blockcount(T array2b)
+{
+        assert(array2b != NULL);
+        int bx0, bx1, by0, by1;
+        block_span(array2b, &bx0, &bx1, &by0, &by1);
+        return (bx1 - bx0) * (by1 - by0);
+}
+
+/*************UArray2b_prefetch****************************************
+*
+* Function that sets how many blocks ahead of the block being visited the
+* maps prefetch
+*
+* Parameters: int blocks: the distance, or 0 to turn prefetching off
+*
+* Return: nothing
+*
+* Notes: the setting is program-wide; the default is PREFETCH_BLOCKS
+*
+*********************************************************************/
+extern void UArray2b_prefetch(int blocks)
+{
+        assert(blocks >= 0);
+        prefetch_blocks = blocks;
+}
+
 /*Helper apply function that frees the individual blocks of the UArray2 when 
 called by a mapping function*/
 void apply_free_blocks(int i, int j, UArray2_T array, void *block, void* cl)
@@ -295,4 +620,73 @@ void apply_free_blocks(int i, int j, UArray2_T array, void *block, void* cl)
         (void) cl;
         UArray_T thisBlock = *(UArray_T *)block;
         UArray_free(&thisBlock);
-}
\ No newline at end of file
+}
+
+/*
+ * Generates UArray2b_at<EDGE>, UArray2b_map<EDGE> and
+ * UArray2b_small_map<EDGE> for a block edge of 1 << LG. The edge is a
+ * compile-time constant in the generated code, so the block coordinates and
+ * the index inside a block come from shifts and masks.
+ * Cells inside a block are numbered row by row, matching getIndex.
+ */
+#define UARRAY2B_POW2(EDGE, LG)                                              \
+extern void *UArray2b_at##EDGE(T array2b, int col, int row)                  \
+{                                                                            \
+        assert(array2b != NULL);                                             \
+        assert(array2b->blocksize == EDGE);                                  \
+        assert(col >= 0 && col < array2b->width);                            \
+        assert(row >= 0 && row < array2b->height);                           \
+                                                                             \
+        col += array2b->col0;                                                \
+        row += array2b->row0;                                                \
+        int index = ((row & (EDGE - 1)) << LG) | (col & (EDGE - 1));       \
+        char *elem = array2b->cells[(row >> LG) * array2b->blocksWide        \
+                                    + (col >> LG)]                           \
+                     + (size_t)index * array2b->size;                        \
+        assert(elem == UArray_at(*(UArray_T *)UArray2_at(array2b->blocks,    \
+                                        col >> LG, row >> LG), index));      \
+        return elem;                                                         \
+}                                                                            \
+                                                                             \
+extern void UArray2b_map##EDGE(T array2b, void apply(int col, int row,      \
+        T array2b, void *elem, void *cl), void *cl)                          \
+{                                                                            \
+        assert(array2b != NULL);                                             \
+        assert(array2b->blocksize == EDGE);                                  \
+        int bx0, bx1, by0, by1;                                              \
+        block_span(array2b, &bx0, &bx1, &by0, &by1);                         \
+                                                                             \
+        for (int by = by0; by < by1; by++) {                                 \
+                for (int bx = bx0; bx < bx1; bx++) {                         \
+                        MAP_BLOCK_CELLS(array2b, bx, by,                     \
+                                        (size_t)array2b->size << LG,         \
+                                        apply(col + c, row + r, array2b,     \
+                                              elem, cl));                    \
+                }                                                            \
+        }                                                                    \
+}                                                                            \
+                                                                             \
+extern void UArray2b_small_map##EDGE(T array2b, void apply(void *elem,      \
+        void *cl), void *cl)                                                 \
+{                                                                            \
+        assert(array2b != NULL);                                             \
+        assert(array2b->blocksize == EDGE);                                  \
+        int bx0, bx1, by0, by1;                                              \
+        block_span(array2b, &bx0, &bx1, &by0, &by1);                         \
+                                                                             \
+        for (int by = by0; by < by1; by++) {                                 \
+                for (int bx = bx0; bx < bx1; bx++) {                         \
+                        MAP_BLOCK_CELLS(array2b, bx, by,                     \
+                                        (size_t)array2b->size << LG,         \
+                                        apply(elem, cl));                    \
+                }                                                            \
+        }                                                                    \
+}
+
+UARRAY2B_POW2(8, 3)
+UARRAY2B_POW2(16, 4)
+UARRAY2B_POW2(32, 5)
+UARRAY2B_POW2(64, 6)
+
+#undef UARRAY2B_POW2
+#undef MAP_BLOCK_CELLS
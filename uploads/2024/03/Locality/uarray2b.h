@@ -0,0 +1,80 @@
+#ifndef UARRAY2B_INCLUDED
+#define UARRAY2B_INCLUDED
+
+/*
+ * UArray2b: a two dimensional unboxed array stored in square blocks, so
+ * that cells near each other in the world of ideas are near each other in
+ * memory.
+ *
+ * This is the course interface from /comp/40/build/include with
+ * UArray2b_map_blocks, the block range functions and views added at the
+ * end.
+ */
+
+#define T UArray2b_T
+typedef struct T *T;
+
+/* new blocked 2d array: blocksize = square root of # of cells in block */
+extern T    UArray2b_new(int width, int height, int size, int blocksize);
+
+/* new blocked 2d array: blocksize as large as possible provided
+   block occupies at most 64KB (if possible) */
+extern T    UArray2b_new_64K_block(int width, int height, int size);
+
+extern void UArray2b_free(T *array2b);
+
+extern int  UArray2b_width    (T array2b);
+extern int  UArray2b_height   (T array2b);
+extern int  UArray2b_size     (T array2b);
+extern int  UArray2b_blocksize(T array2b);
+
+/* return a pointer to the cell in the given column and row.
+   index out of range is a checked run-time error */
+extern void *UArray2b_at(T array2b, int column, int row);
+
+/* visits every cell in one block before moving to another block */
+extern void  UArray2b_map(T array2b, void apply(int col, int row, T array2b,
+                          void *elem, void *cl), void *cl);
+
+/* the same order for an apply that needs only the element, which is
+   called straight from the loop */
+extern void  UArray2b_small_map(T array2b, void apply(void *elem, void *cl),
+                                void *cl);
+
+/* the number of blocks, counting partial blocks along the edges */
+extern int   UArray2b_blockcount(T array2b);
+
+/* visits the blocks numbered [first, last) in the same order as
+   UArray2b_map; blocks are numbered row by row of blocks. disjoint ranges
+   can be mapped by different threads at the same time */
+extern void  UArray2b_map_block_range(T array2b, int first, int last,
+                                      void apply(int col, int row,
+                                                 T array2b, void *elem,
+                                                 void *cl), void *cl);
+
+/* calls apply once per block, in storage order, with the block's origin,
+   its clipped extent and a pointer to its first cell */
+extern void  UArray2b_map_blocks(T array2b, void apply(int col, int row,
+                                 int width, int height, void *elems,
+                                 int colstride, int rowstride, T array2b,
+                                 void *cl), void *cl);
+
+/* what UArray2b_map_blocks passes for block n, numbered as for the block
+   range map: returns the pointer and stores the rest */
+extern void *UArray2b_block(T array2b, int n, int *col, int *row,
+                            int *width, int *height, int *colstride,
+                            int *rowstride);
+
+/* the maps prefetch the first cells of the block this many blocks ahead
+   of the one they visit; 0 turns prefetching off. The setting is
+   program-wide */
+extern void  UArray2b_prefetch(int blocks);
+
+/* a width x height window whose (0, 0) is (col, row) of array2b, sharing
+   its blocks; every function above works on it. freeing the view leaves
+   array2b alone */
+extern T     UArray2b_view(T array2b, int col, int row, int width,
+                           int height);
+
+#undef T
+#endif
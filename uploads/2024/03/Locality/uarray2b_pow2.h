@@ -0,0 +1,43 @@
+/*
+ *     uarray2b_pow2.h
+ *     locality
+ *
+ *     Accessors and maps for UArray2bs whose blocksize is a power of two.
+ *     Each function is compiled for one fixed block edge, so locating a cell
+ *     takes shifts and masks instead of the runtime division and modulus
+ *     that UArray2b_at does. The array passed in must have been created with
+ *     exactly that blocksize; this is a checked runtime error.
+ */
+
+#ifndef UARRAY2B_POW2_INCLUDED
+#define UARRAY2B_POW2_INCLUDED
+
+#include "uarray2b.h"
+
+#define T UArray2b_T
+
+extern void *UArray2b_at8 (T array2b, int col, int row);
+extern void *UArray2b_at16(T array2b, int col, int row);
+extern void *UArray2b_at32(T array2b, int col, int row);
+extern void *UArray2b_at64(T array2b, int col, int row);
+
+extern void UArray2b_map8 (T array2b, void apply(int col, int row, T array2b,
+                           void *elem, void *cl), void *cl);
+extern void UArray2b_map16(T array2b, void apply(int col, int row, T array2b,
+                           void *elem, void *cl), void *cl);
+extern void UArray2b_map32(T array2b, void apply(int col, int row, T array2b,
+                           void *elem, void *cl), void *cl);
+extern void UArray2b_map64(T array2b, void apply(int col, int row, T array2b,
+                           void *elem, void *cl), void *cl);
+
+extern void UArray2b_small_map8 (T array2b, void apply(void *elem, void *cl),
+                                 void *cl);
+extern void UArray2b_small_map16(T array2b, void apply(void *elem, void *cl),
+                                 void *cl);
+extern void UArray2b_small_map32(T array2b, void apply(void *elem, void *cl),
+                                 void *cl);
+extern void UArray2b_small_map64(T array2b, void apply(void *elem, void *cl),
+                                 void *cl);
+
+#undef T
+#endif
@@ -0,0 +1,598 @@
+/*
+ *     uarray2bmapped.c
+ *     locality
+ *
+ *     Implementation of a two dimensional blocked array stored in a
+ *     memory-mapped scratch file
+ */
+#include "uarray2bmapped.h"
+#include <assert.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define T UArray2bMapped_T
+
+/* how far ahead of a traversal the maps ask for pages to be read in */
+#define READAHEAD (1 << 20)
+
+/* a snapshot starts with SNAPSHOT_MAGIC and its blocks start SNAPSHOT_DATA
+   bytes in, a multiple of every page size in use, so they can be mapped */
+#define SNAPSHOT_MAGIC "A2SNAP1\n"
+#define SNAPSHOT_DATA (64 * 1024)
+#define SNAPSHOT_ORDER 0x01020304u
+
+/* the header at the start of a snapshot, in the writer's byte order; order
+   reads as SNAPSHOT_ORDER only on a machine with the same order */
+struct snapshot_header {
+        char magic[8];
+        uint32_t order;
+        uint32_t tag;
+        int32_t width, height;
+        int32_t size, blocksize;
+        uint64_t blockBytes;
+        uint64_t length;
+};
+
+/*Structure storing the information accessed by the UArray2bMapped interface.
+Stores the dimensions, element size and blocksize of the array, the number of
+blocks in each row of blocks, the padded byte length of one block, and the
+mapping of the scratch file together with its length*/
+struct T {
+        int width, height;
+        int size;
+        int blocksize;
+        int blocksWide, blocksHigh;
+        size_t blockBytes;
+        char *blocks;
+        size_t length;
+};
+
+/********************padded_block_bytes**********************************
+*
+* Function that rounds the byte length of a block so that blocks packed back
+* to back never straddle a page boundary
+*
+* Parameters: size_t bytes: the unpadded length of one block
+*             size_t page: the page size
+*
+* Return: the next power of two for blocks smaller than a page, otherwise
+* the next multiple of the page size
+*
+*********************************************************************/
+static size_t padded_block_bytes(size_t bytes, size_t page)
+{
+        if (bytes >= page) {
+                return (bytes + page - 1) / page * page;
+        }
+        size_t padded = 1;
+        while (padded < bytes) {
+                padded <<= 1;
+        }
+        return padded;
+}
+
+/********************map_scratch_file************************************
+*
+* Function that creates an unlinked scratch file of the given length and
+* maps all of it
+*
+* Parameters: size_t length: bytes to map, a multiple of the page size
+*
+* Return: a pointer to the start of the shared mapping. The file reads as
+* zeroes until written
+*
+* Expects: length > 0; failures are checked runtime errors in every build,
+* reported on stderr before the program exits
+*
+* Notes: the file's disk space is reserved up front, so a full $TMPDIR is
+* reported here rather than as a SIGBUS when a page is first written
+*
+*********************************************************************/
+static char *map_scratch_file(size_t length)
+{
+        const char *dir = getenv("TMPDIR");
+        if (dir == NULL || *dir == '\0') {
+                dir = "/tmp";
+        }
+        size_t pathlen = strlen(dir) + sizeof("/a2mapped.XXXXXX");
+        char *path = malloc(pathlen);
+        assert(path != NULL);
+        snprintf(path, pathlen, "%s/a2mapped.XXXXXX", dir);
+
+        int fd = mkstemp(path);
+        if (fd < 0) {
+                perror(dir);
+                exit(EXIT_FAILURE);
+        }
+        unlink(path);
+
+        int failed = posix_fallocate(fd, 0, (off_t)length);
+        if (failed != 0) {
+                fprintf(stderr, "%s: cannot reserve %zu bytes: %s\n", path,
+                        length, strerror(failed));
+                exit(EXIT_FAILURE);
+        }
+        void *blocks = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                            fd, 0);
+        if (blocks == MAP_FAILED) {
+                perror(path);
+                exit(EXIT_FAILURE);
+        }
+        free(path);
+        close(fd);      /* the mapping keeps the file alive */
+        return blocks;
+}
+
+/********************read_ahead******************************************
+*
+* Function that keeps the kernel reading a window ahead of a traversal
+*
+* Parameters: T a: the array being traversed
+*             char *cursor: the block the traversal is about to visit
+*             char *hinted: the end of the part of the mapping already
+*                   requested, page aligned
+*
+* Return: the new end of the requested part
+*
+* Notes: a new window is requested once the traversal is half a window from
+* the end of the last one, so the reads overlap the work on earlier blocks
+*
+*********************************************************************/
+static char *read_ahead(T a, char *cursor, char *hinted)
+{
+        char *end = a->blocks + a->length;
+        if (hinted >= end || cursor + READAHEAD / 2 < hinted) {
+                return hinted;
+        }
+        size_t len = (size_t)(end - hinted) < READAHEAD
+                     ? (size_t)(end - hinted) : READAHEAD;
+        (void)madvise(hinted, len, MADV_WILLNEED);
+        return hinted + len;
+}
+
+/*************UArray2bMapped_new******************************************
+*
+* Function that initializes an empty UArray2bMapped with the specified
+* dimensions and blocksize
+*
+* Parameters: int width: the width of the array
+*             int height: the height of the array
+*             int size: the size of an element in the array
+*             int blocksize: the length of a block in the array
+*
+* Return: the newly initialized UArray2bMapped, with every cell zeroed
+*
+* Expects: dimensions are not negative, size > 0 and blocksize > 0
+*
+* Notes: no page of the scratch file exists on disk or in memory until
+* something writes to it
+*
+*********************************************************************/
+extern T UArray2bMapped_new(int width, int height, int size, int blocksize)
+{
+        assert(width >= 0 && height >= 0);
+        assert(size > 0);
+        assert(blocksize > 0);
+
+        T array = malloc(sizeof(*array));
+        assert(array != NULL);
+        array->width = width;
+        array->height = height;
+        array->size = size;
+        array->blocksize = blocksize;
+        array->blocksWide = (width + blocksize - 1) / blocksize;
+        array->blocksHigh = (height + blocksize - 1) / blocksize;
+
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t cells = (size_t)blocksize * blocksize;
+        array->blockBytes = padded_block_bytes(cells * size, page);
+
+        size_t total = array->blockBytes * array->blocksWide
+                       * array->blocksHigh;
+        array->length = (total + page - 1) / page * page;
+        array->blocks = array->length > 0 ? map_scratch_file(array->length)
+                                          : NULL;
+        return array;
+}
+
+/*************UArray2bMapped_new_64K_block*********************************
+*
+* Function that initializes an empty UArray2bMapped whose blocks hold as
+* close to 64K of memory as possible
+*
+* Parameters: int width: the width of the array
+*             int height: the height of the array
+*             int size: the size of an element in the array
+*
+* Return: the newly initialized UArray2bMapped with an automatically set
+* blocksize
+*
+* Notes: elements larger than 64K get a blocksize of 1
+*
+*********************************************************************/
+extern T UArray2bMapped_new_64K_block(int width, int height, int size)
+{
+        assert(size > 0);
+        int blocksize = (int)sqrt((64 * 1024) / (double)size);
+        if (blocksize < 1) {
+                blocksize = 1;
+        }
+        return UArray2bMapped_new(width, height, size, blocksize);
+}
+
+/*************UArray2bMapped_free*****************************************
+*
+* Function that unmaps the scratch file of an initialized UArray2bMapped,
+* which deletes it, and frees the array
+*
+* Parameters: T *array2b: pointer to a UArray2bMapped that has been
+*             initialized
+*
+* Return: void
+*
+* Expects: array2b and *array2b are not NULL
+*
+*********************************************************************/
+extern void UArray2bMapped_free(T *array2b)
+{
+        assert(array2b != NULL && *array2b != NULL);
+        if ((*array2b)->blocks != NULL) {
+                munmap((*array2b)->blocks, (*array2b)->length);
+        }
+        free(*array2b);
+        *array2b = NULL;
+}
+
+/*************UArray2bMapped_at*******************************************
+*
+* Function that gets an element at specified indices in the given array
+*
+* Parameters: T array2b: a UArray2bMapped that has been initialized
+*             int col: col index of the element
+*             int row: row index of the element
+*
+* Return: void pointer of element at given index
+*
+* Expects: array2b is not NULL, indices are within bounds of array
+*
+*********************************************************************/
+extern void *UArray2bMapped_at(T array2b, int col, int row)
+{
+        assert(array2b != NULL);
+        assert(col >= 0 && col < array2b->width);
+        assert(row >= 0 && row < array2b->height);
+
+        int b = array2b->blocksize;
+        size_t block = (size_t)(row / b) * array2b->blocksWide + col / b;
+        size_t cell = (size_t)b * (row % b) + col % b;
+        return array2b->blocks + block * array2b->blockBytes
+                               + cell * array2b->size;
+}
+
+extern int UArray2bMapped_width(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->width;
+}
+
+extern int UArray2bMapped_height(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->height;
+}
+
+extern int UArray2bMapped_size(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->size;
+}
+
+extern int UArray2bMapped_blocksize(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->blocksize;
+}
+
+/*************UArray2bMapped_map*******************************************
+*
+* Traverses the elements of the array one block at a time, in the order the
+* blocks are laid out in the file, and calls the apply function for each
+* element
+*
+* Parameters: T array2b: a UArray2bMapped that has been initialized
+*             void apply: function called for each element with its column,
+*                   row, the array, a pointer to the element and the closure
+*             void *cl: a closure statement for the map function
+*
+* Return: nothing, but apply function affects elements of array and closure
+*
+* Notes: cells of partial blocks along the right and bottom edges that fall
+* outside the array are skipped. The pages after the current block are
+* requested before the traversal reaches them.
+*
+*********************************************************************/
+extern void UArray2bMapped_map(T array2b, void apply(int col, int row,
+        T array2b, void *elem, void *cl), void *cl)
+{
+        assert(array2b != NULL);
+        int b = array2b->blocksize;
+        int w = array2b->width;
+        int h = array2b->height;
+        int size = array2b->size;
+        char *block = array2b->blocks;
+        char *hinted = array2b->blocks;
+
+        for (int by = 0; by < array2b->blocksHigh; by++) {
+                for (int bx = 0; bx < array2b->blocksWide; bx++) {
+                        hinted = read_ahead(array2b, block, hinted);
+                        int col0 = bx * b;
+                        int row0 = by * b;
+                        int colEnd = col0 + b < w ? col0 + b : w;
+                        int rowEnd = row0 + b < h ? row0 + b : h;
+                        for (int row = row0; row < rowEnd; row++) {
+                                char *elem = block
+                                        + (size_t)(row - row0) * b * size;
+                                for (int col = col0; col < colEnd; col++) {
+                                        apply(col, row, array2b, elem, cl);
+                                        elem += size;
+                                }
+                        }
+                        block += array2b->blockBytes;
+                }
+        }
+}
+
+/*************UArray2bMapped_map_blocks************************************
+*
+* Traverses the array one block at a time, in the order the blocks are laid
+* out in the file, and calls the apply function once for each block
+*
+* Parameters: T array2b: a UArray2bMapped that has been initialized
+*             void apply: function called for each block with the column and
+*                   row of its top left cell, the number of columns and rows
+*                   of the block that lie inside the array, a pointer to the
+*                   top left cell, the byte distance between neighbouring
+*                   columns and rows, the array and the closure
+*             void *cl: a closure statement for the map function
+*
+* Return: nothing, but apply function affects elements of array and closure
+*
+* Notes: blocks along the right and bottom edges are clipped to the array
+*
+*********************************************************************/
+extern void UArray2bMapped_map_blocks(T array2b, void apply(int col, int row,
+        int width, int height, void *elems, int colstride, int rowstride,
+        T array2b, void *cl), void *cl)
+{
+        assert(array2b != NULL);
+        int b = array2b->blocksize;
+        int w = array2b->width;
+        int h = array2b->height;
+        int size = array2b->size;
+        char *block = array2b->blocks;
+        char *hinted = array2b->blocks;
+
+        for (int by = 0; by < array2b->blocksHigh; by++) {
+                for (int bx = 0; bx < array2b->blocksWide; bx++) {
+                        hinted = read_ahead(array2b, block, hinted);
+                        int col0 = bx * b;
+                        int row0 = by * b;
+                        int cols = col0 + b < w ? b : w - col0;
+                        int rows = row0 + b < h ? b : h - row0;
+                        apply(col0, row0, cols, rows, block, size, b * size,
+                              array2b, cl);
+                        block += array2b->blockBytes;
+                }
+        }
+}
+
+extern int UArray2bMapped_blockcount(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->blocksWide * array2b->blocksHigh;
+}
+
+/*************UArray2bMapped_block******************************************
+*
+* Function that describes one block as UArray2bMapped_map_blocks would
+*
+* Parameters: T array2b: a UArray2bMapped that has been initialized
+*             int n: the block, numbered in storage order
+*             int *col, *row, *width, *height, *colstride, *rowstride: set
+*                   to what map_blocks passes for the block
+*
+* Return: a pointer to the block's first cell
+*
+* Notes: there is no traversal to carry read-ahead state, so the first block
+* in each half window of READAHEAD asks for the window after it; a caller
+* that goes through the blocks in order keeps the kernel reading ahead as
+* map_blocks does
+*
+*********************************************************************/
+extern void *UArray2bMapped_block(T array2b, int n, int *col, int *row,
+        int *width, int *height, int *colstride, int *rowstride)
+{
+        assert(array2b != NULL);
+        assert(0 <= n && n < UArray2bMapped_blockcount(array2b));
+        int b = array2b->blocksize;
+        size_t half = READAHEAD / 2;
+        size_t offset = (size_t)n * array2b->blockBytes;
+        char *block = array2b->blocks + offset;
+        if (n == 0 || offset / half != (offset - array2b->blockBytes) / half) {
+                (void)read_ahead(array2b, block,
+                                 array2b->blocks + offset / half * half + half);
+        }
+        *col = n % array2b->blocksWide * b;
+        *row = n / array2b->blocksWide * b;
+        *width = *col + b < array2b->width ? b : array2b->width - *col;
+        *height = *row + b < array2b->height ? b : array2b->height - *row;
+        *colstride = array2b->size;
+        *rowstride = b * array2b->size;
+        return block;
+}
+
+/*************UArray2bMapped_save*****************************************
+*
+* Function that writes an array to a file as a snapshot
+*
+* Parameters: T array2b: a UArray2bMapped that has been initialized
+*             unsigned tag: a word the client wants back on loading
+*             FILE *fp: a file open for writing, at the place the snapshot
+*                   should go
+*
+* Return: 1 if every byte was written and flushed, 0 if a write failed, in
+* which case the file holds part of a snapshot at most
+*
+* Expects: array2b and fp are not NULL
+*
+* Notes: the blocks go out as one write of the whole mapping, padding and
+* all, so the file holds exactly what UArray2bMapped_load maps back. fp can
+* be a pipe, but only a snapshot saved to a regular file can be loaded
+*
+*********************************************************************/
+extern int UArray2bMapped_save(T array2b, unsigned tag, FILE *fp)
+{
+        assert(array2b != NULL && fp != NULL);
+        static const char zeroes[SNAPSHOT_DATA];
+        struct snapshot_header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.order = SNAPSHOT_ORDER;
+        header.tag = tag;
+        header.width = array2b->width;
+        header.height = array2b->height;
+        header.size = array2b->size;
+        header.blocksize = array2b->blocksize;
+        header.blockBytes = array2b->blockBytes;
+        header.length = array2b->length;
+
+        size_t written = fwrite(&header, sizeof(header), 1, fp);
+        written += fwrite(zeroes, SNAPSHOT_DATA - sizeof(header), 1, fp);
+        if (array2b->length > 0) {
+                written += fwrite(array2b->blocks, array2b->length, 1, fp);
+        } else {
+                written++;
+        }
+        return written == 3 && fflush(fp) == 0;
+}
+
+/********************snapshot_problem************************************
+*
+* Function that checks a snapshot header against itself and its file
+*
+* Parameters: struct snapshot_header *header: the header, magic matched
+*             uint64_t filesize: the length of the snapshot file
+*
+* Return: NULL if the blocks the header describes all lie inside the file,
+* otherwise a message saying what is wrong
+*
+* Notes: every field comes from the file, so the sizes are multiplied with
+* overflow checks rather than trusted to fit
+*
+*********************************************************************/
+static const char *snapshot_problem(struct snapshot_header *header,
+                                    uint64_t filesize)
+{
+        if (header->order != SNAPSHOT_ORDER) {
+                return "written on a machine of the other byte order";
+        }
+        if (header->width < 0 || header->height < 0 || header->size <= 0
+            || header->blocksize <= 0) {
+                return "bad dimensions";
+        }
+        uint64_t b = header->blocksize;
+        uint64_t wide = ((uint64_t)header->width + b - 1) / b;
+        uint64_t high = ((uint64_t)header->height + b - 1) / b;
+        uint64_t cellBytes, blocks, total;
+        if (__builtin_mul_overflow(b * b, (uint64_t)header->size,
+                                   &cellBytes)
+            || header->blockBytes < cellBytes
+            || __builtin_mul_overflow(wide, high, &blocks)
+            || blocks > INT_MAX
+            || __builtin_mul_overflow(header->blockBytes, blocks, &total)
+            || header->length < total || header->length > SIZE_MAX) {
+                return "block layout does not add up";
+        }
+        if (filesize < SNAPSHOT_DATA
+            || filesize - SNAPSHOT_DATA < header->length) {
+                return "file is shorter than its header says";
+        }
+        return NULL;
+}
+
+/*************UArray2bMapped_load*****************************************
+*
+* Function that maps an array back in from a snapshot
+*
+* Parameters: FILE *fp: a file that may hold a snapshot at its start
+*             unsigned *tag: set to the tag the snapshot was saved with
+*
+* Return: the array, or NULL if fp is not a regular file that starts with a
+* snapshot header
+*
+* Expects: fp and tag are not NULL. A snapshot whose header does not match
+* the rest of the file, or that came from a machine of the other byte
+* order, is reported on stderr and ends the program, in every build
+*
+* Notes: nothing is parsed or copied. The header is read with pread, so fp
+* is left as it was and can still be read from the start when this returns
+* NULL. The blocks are mapped privately: pages are shared with the page
+* cache until the array writes to them, and the file may be closed at once
+*
+*********************************************************************/
+extern T UArray2bMapped_load(FILE *fp, unsigned *tag)
+{
+        assert(fp != NULL && tag != NULL);
+        int fd = fileno(fp);
+        struct stat info;
+        struct snapshot_header header;
+        if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)
+            || pread(fd, &header, sizeof(header), 0)
+               != (ssize_t)sizeof(header)
+            || memcmp(header.magic, SNAPSHOT_MAGIC,
+                      sizeof(header.magic)) != 0) {
+                return NULL;
+        }
+        const char *problem = snapshot_problem(&header,
+                                               (uint64_t)info.st_size);
+        if (problem != NULL) {
+                fprintf(stderr, "UArray2bMapped_load: bad snapshot: %s\n",
+                        problem);
+                exit(EXIT_FAILURE);
+        }
+
+        T array = malloc(sizeof(*array));
+        assert(array != NULL);
+        array->width = header.width;
+        array->height = header.height;
+        array->size = header.size;
+        array->blocksize = header.blocksize;
+        array->blocksWide = (header.width + header.blocksize - 1)
+                            / header.blocksize;
+        array->blocksHigh = (header.height + header.blocksize - 1)
+                            / header.blocksize;
+        array->blockBytes = header.blockBytes;
+        array->length = header.length;
+
+        array->blocks = NULL;
+        if (array->length > 0) {
+                void *blocks = mmap(NULL, array->length,
+                                    PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+                                    SNAPSHOT_DATA);
+                if (blocks == MAP_FAILED) {
+                        perror("UArray2bMapped_load: mmap");
+                        exit(EXIT_FAILURE);
+                }
+                array->blocks = blocks;
+        }
+        *tag = header.tag;
+        return array;
+}
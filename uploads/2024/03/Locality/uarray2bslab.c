@@ -0,0 +1,434 @@
+/*
+ *     uarray2bslab.c
+ *     locality
+ *
+ *     Implementation of a two dimensional blocked array that stores every
+ *     block in one contiguous, cache-line-aligned slab
+ */
+#include "uarray2bslab.h"
+#include "bigalloc.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define T UArray2bSlab_T
+
+/* every block starts on its own cache line */
+#define CACHE_LINE 64
+
+/*Structure storing the information accessed by the UArray2bSlab interface.
+Stores the dimensions, element size and blocksize of the array, the number of
+blocks in each row of blocks, the padded byte length of one block, the
+slab holding all of the blocks back to back, and how many workers first
+touched it*/
+struct T {
+        int width, height;
+        int size;
+        int blocksize;
+        int blocksWide, blocksHigh;
+        size_t blockBytes;
+        char *slab;
+        int touchers;
+};
+
+/* bytes in the slab, counting the padding of every block */
+static inline size_t slab_bytes(T a)
+{
+        return a->blockBytes * a->blocksWide * a->blocksHigh;
+}
+
+static T make(int width, int height, int size, int blocksize,
+              void *alloc(size_t nbytes));
+
+/*************UArray2bSlab_new******************************************
+*
+* Function that initializes an empty UArray2bSlab with the specified
+* dimensions and blocksize
+*
+* Parameters: int width: the width of the array
+*             int height: the height of the array
+*             int size: the size of an element in the array
+*             int blocksize: the length of a block in the array
+*
+* Return: the newly initialized UArray2bSlab, with every cell zeroed
+*
+* Expects: dimensions are not negative, size > 0 and blocksize > 0
+*
+*********************************************************************/
+extern T UArray2bSlab_new(int width, int height, int size, int blocksize)
+{
+        return make(width, height, size, blocksize, BigAlloc_new);
+}
+
+/*************UArray2bSlab_new_unzeroed*********************************
+*
+* Function that initializes a UArray2bSlab without writing to its cells
+*
+* Parameters: int width: the width of the array
+*             int height: the height of the array
+*             int size: the size of an element in the array
+*             int blocksize: the length of a block in the array
+*
+* Return: the newly initialized UArray2bSlab, whose cells are unspecified
+* until they are cleared
+*
+* Expects: dimensions are not negative, size > 0 and blocksize > 0
+*
+* Notes: slabs of 2 MB or more are fresh mappings from the kernel, on huge
+* pages if BigAlloc_hugepages asked for them, and are never recycled from
+* the BigAlloc pool, so none of their pages exist until something writes to
+* them; clearing the blocks with UArray2bSlab_clear_block_range from the
+* threads that will use them puts each page on that thread's NUMA node.
+*
+*********************************************************************/
+extern T UArray2bSlab_new_unzeroed(int width, int height, int size,
+                                   int blocksize)
+{
+        return make(width, height, size, blocksize, BigAlloc_new_untouched);
+}
+
+/*************make*****************************************************
+*
+* Initializes a UArray2bSlab whose slab comes from the given allocator
+*
+* Parameters: the dimensions, element size and blocksize, as for
+*             UArray2bSlab_new
+*             void *alloc: BigAlloc_new or BigAlloc_new_untouched
+*
+* Return: the newly initialized UArray2bSlab
+*
+* Notes: all blocks come from a single allocation. Each block is padded up
+* to a whole number of cache lines so that every block begins on a line
+* boundary.
+*
+*********************************************************************/
+static T make(int width, int height, int size, int blocksize,
+              void *alloc(size_t nbytes))
+{
+        assert(width >= 0 && height >= 0);
+        assert(size > 0);
+        assert(blocksize > 0);
+
+        T array = malloc(sizeof(*array));
+        assert(array != NULL);
+        array->width = width;
+        array->height = height;
+        array->size = size;
+        array->blocksize = blocksize;
+        array->blocksWide = (width + blocksize - 1) / blocksize;
+        array->blocksHigh = (height + blocksize - 1) / blocksize;
+
+        size_t cells = (size_t)blocksize * blocksize;
+        array->blockBytes = (cells * size + CACHE_LINE - 1)
+                            / CACHE_LINE * CACHE_LINE;
+
+        size_t total = slab_bytes(array);
+        array->slab = total > 0 ? alloc(total) : NULL;
+        array->touchers = 0;
+        return array;
+}
+
+/*************UArray2bSlab_new_64K_block*********************************
+*
+* Function that initializes an empty UArray2bSlab whose blocks hold as close
+* to 64K of memory as possible
+*
+* Parameters: int width: the width of the array
+*             int height: the height of the array
+*             int size: the size of an element in the array
+*
+* Return: the newly initialized UArray2bSlab with an automatically set
+* blocksize
+*
+* Notes: elements larger than 64K get a blocksize of 1
+*
+*********************************************************************/
+extern T UArray2bSlab_new_64K_block(int width, int height, int size)
+{
+        return UArray2bSlab_new(width, height, size,
+                                UArray2bSlab_blocksize_64K(size));
+}
+
+/* the largest blocksize whose blocks of elements of the given size fit in
+   64K, or 1 for elements larger than 64K */
+extern int UArray2bSlab_blocksize_64K(int size)
+{
+        assert(size > 0);
+        int blocksize = (int)sqrt((64 * 1024) / (double)size);
+        if (blocksize < 1) {
+                blocksize = 1;
+        }
+        return blocksize;
+}
+
+/*************UArray2bSlab_clear_block_range****************************
+*
+* Sets every cell of the blocks numbered first up to but not including last
+* to zero
+*
+* Parameters: T array2b: a UArray2bSlab that has been initialized
+*             int first, last: the range of block numbers to clear, in slab
+*                   order as for UArray2bSlab_map_block_range
+*
+* Return: nothing
+*
+* Notes: disjoint ranges are disjoint parts of the slab, so different
+* threads can clear different ranges at the same time
+*
+*********************************************************************/
+extern void UArray2bSlab_clear_block_range(T array2b, int first, int last)
+{
+        assert(array2b != NULL);
+        assert(0 <= first && first <= last
+               && last <= UArray2bSlab_blockcount(array2b));
+        if (first < last) {
+                memset(array2b->slab + (size_t)first * array2b->blockBytes,
+                       0, (size_t)(last - first) * array2b->blockBytes);
+        }
+}
+
+/*************UArray2bSlab_free*****************************************
+*
+* Function that frees the memory of an initialized UArray2bSlab
+*
+* Parameters: T *array2b: pointer to a UArray2bSlab that has been initialized
+*
+* Return: void
+*
+* Expects: array2b and *array2b are not NULL
+*
+* Notes: the slab is a single allocation, so freeing is O(1) regardless of
+* the number of blocks
+*
+*********************************************************************/
+extern void UArray2bSlab_free(T *array2b)
+{
+        assert(array2b != NULL && *array2b != NULL);
+        BigAlloc_free((*array2b)->slab, slab_bytes(*array2b));
+        free(*array2b);
+        *array2b = NULL;
+}
+
+/*************UArray2bSlab_at*******************************************
+*
+* Function that gets an element at specified indices in the given array
+*
+* Parameters: T array2b: a UArray2bSlab that has been initialized
+*             int col: col index of the element
+*             int row: row index of the element
+*
+* Return: void pointer of element at given index
+*
+* Expects: array2b is not NULL, indices are within bounds of array
+*
+*********************************************************************/
+extern void *UArray2bSlab_at(T array2b, int col, int row)
+{
+        assert(array2b != NULL);
+        assert(col >= 0 && col < array2b->width);
+        assert(row >= 0 && row < array2b->height);
+
+        int b = array2b->blocksize;
+        size_t block = (size_t)(row / b) * array2b->blocksWide + col / b;
+        size_t cell = (size_t)b * (row % b) + col % b;
+        return array2b->slab + block * array2b->blockBytes
+                             + cell * array2b->size;
+}
+
+extern int UArray2bSlab_width(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->width;
+}
+
+extern int UArray2bSlab_height(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->height;
+}
+
+extern int UArray2bSlab_size(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->size;
+}
+
+extern int UArray2bSlab_blocksize(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->blocksize;
+}
+
+/*************UArray2bSlab_map*******************************************
+*
+* Traverses the elements of the array one block at a time, in the order the
+* blocks are laid out in the slab, and calls the apply function for each
+* element
+*
+* Parameters: T array2b: a UArray2bSlab that has been initialized
+*             void apply: function called for each element with its column,
+*                   row, the array, a pointer to the element and the closure
+*             void *cl: a closure statement for the map function
+*
+* Return: nothing, but apply function affects elements of array and closure
+*
+* Notes: cells of partial blocks along the right and bottom edges that fall
+* outside the array are skipped. Element pointers are advanced by the element
+* size rather than recomputed, so each cell costs no index arithmetic.
+*
+*********************************************************************/
+extern void UArray2bSlab_map(T array2b, void apply(int col, int row,
+        T array2b, void *elem, void *cl), void *cl)
+{
+        assert(array2b != NULL);
+        int b = array2b->blocksize;
+        int w = array2b->width;
+        int h = array2b->height;
+        int size = array2b->size;
+        char *block = array2b->slab;
+
+        for (int by = 0; by < array2b->blocksHigh; by++) {
+                for (int bx = 0; bx < array2b->blocksWide; bx++) {
+                        int col0 = bx * b;
+                        int row0 = by * b;
+                        int colEnd = col0 + b < w ? col0 + b : w;
+                        int rowEnd = row0 + b < h ? row0 + b : h;
+                        for (int row = row0; row < rowEnd; row++) {
+                                char *elem = block
+                                        + (size_t)(row - row0) * b * size;
+                                for (int col = col0; col < colEnd; col++) {
+                                        apply(col, row, array2b, elem, cl);
+                                        elem += size;
+                                }
+                        }
+                        block += array2b->blockBytes;
+                }
+        }
+}
+
+/*************UArray2bSlab_map_blocks************************************
+*
+* Traverses the array one block at a time, in the order the blocks are laid
+* out in the slab, and calls the apply function once for each block
+*
+* Parameters: T array2b: a UArray2bSlab that has been initialized
+*             void apply: function called for each block with the column and
+*                   row of its top left cell, the number of columns and rows
+*                   of the block that lie inside the array, a pointer to the
+*                   top left cell, the byte distance between neighbouring
+*                   columns and rows, the array and the closure
+*             void *cl: a closure statement for the map function
+*
+* Return: nothing, but apply function affects elements of array and closure
+*
+* Notes: blocks along the right and bottom edges are clipped to the array
+*
+*********************************************************************/
+extern void UArray2bSlab_map_blocks(T array2b, void apply(int col, int row,
+        int width, int height, void *elems, int colstride, int rowstride,
+        T array2b, void *cl), void *cl)
+{
+        assert(array2b != NULL);
+        int b = array2b->blocksize;
+        int w = array2b->width;
+        int h = array2b->height;
+        int size = array2b->size;
+        char *block = array2b->slab;
+
+        for (int by = 0; by < array2b->blocksHigh; by++) {
+                for (int bx = 0; bx < array2b->blocksWide; bx++) {
+                        int col0 = bx * b;
+                        int row0 = by * b;
+                        int cols = col0 + b < w ? b : w - col0;
+                        int rows = row0 + b < h ? b : h - row0;
+                        apply(col0, row0, cols, rows, block, size, b * size,
+                              array2b, cl);
+                        block += array2b->blockBytes;
+                }
+        }
+}
+
+/* block n of UArray2bSlab_map_blocks, numbered in slab order */
+extern void *UArray2bSlab_block(T array2b, int n, int *col, int *row,
+        int *width, int *height, int *colstride, int *rowstride)
+{
+        assert(array2b != NULL);
+        assert(0 <= n && n < UArray2bSlab_blockcount(array2b));
+        int b = array2b->blocksize;
+        *col = n % array2b->blocksWide * b;
+        *row = n / array2b->blocksWide * b;
+        *width = *col + b < array2b->width ? b : array2b->width - *col;
+        *height = *row + b < array2b->height ? b : array2b->height - *row;
+        *colstride = array2b->size;
+        *rowstride = b * array2b->size;
+        return array2b->slab + (size_t)n * array2b->blockBytes;
+}
+
+/*************UArray2bSlab_map_block_range********************************
+*
+* Traverses the blocks numbered first up to but not including last, in the
+* same order as UArray2bSlab_map, and calls the apply function for each
+* element
+*
+* Parameters: T array2b: a UArray2bSlab that has been initialized
+*             int first, last: the range of block numbers to visit. Blocks
+*                   are numbered in slab order, from 0 to
+*                   UArray2bSlab_blockcount - 1
+*             void apply: function called for each element with its column,
+*                   row, the array, a pointer to the element and the closure
+*             void *cl: a closure statement for the map function
+*
+* Return: nothing, but apply function affects elements of array and closure
+*
+* Notes: disjoint ranges touch disjoint parts of the slab, so different
+* threads can map different ranges of the same array at the same time
+*
+*********************************************************************/
+extern void UArray2bSlab_map_block_range(T array2b, int first, int last,
+        void apply(int col, int row, T array2b, void *elem, void *cl),
+        void *cl)
+{
+        assert(array2b != NULL);
+        assert(0 <= first && first <= last
+               && last <= UArray2bSlab_blockcount(array2b));
+        int b = array2b->blocksize;
+        int w = array2b->width;
+        int h = array2b->height;
+        int size = array2b->size;
+
+        for (int n = first; n < last; n++) {
+                char *block = array2b->slab + (size_t)n * array2b->blockBytes;
+                int col0 = n % array2b->blocksWide * b;
+                int row0 = n / array2b->blocksWide * b;
+                int colEnd = col0 + b < w ? col0 + b : w;
+                int rowEnd = row0 + b < h ? row0 + b : h;
+                for (int row = row0; row < rowEnd; row++) {
+                        char *elem = block + (size_t)(row - row0) * b * size;
+                        for (int col = col0; col < colEnd; col++) {
+                                apply(col, row, array2b, elem, cl);
+                                elem += size;
+                        }
+                }
+        }
+}
+
+extern int UArray2bSlab_touchers(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->touchers;
+}
+
+extern void UArray2bSlab_set_touchers(T array2b, int nworkers)
+{
+        assert(array2b != NULL);
+        assert(nworkers >= 0);
+        array2b->touchers = nworkers;
+}
+
+extern int UArray2bSlab_blockcount(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->blocksWide * array2b->blocksHigh;
+}
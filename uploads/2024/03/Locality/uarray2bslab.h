@@ -0,0 +1,71 @@
+/*
+ *     uarray2bslab.h
+ *     locality
+ *
+ *     A two dimensional blocked array whose blocks all live in a single
+ *     cache-line-aligned allocation. Block (bx, by) sits at a fixed offset
+ *     computed from its coordinates, so an access is one address calculation
+ *     instead of the two dependent loads through a UArray2 of UArrays that
+ *     UArray2b needs. Cells within a block are stored row by row, and blocks
+ *     are stored in row-major order of blocks.
+ */
+
+#ifndef UARRAY2BSLAB_INCLUDED
+#define UARRAY2BSLAB_INCLUDED
+
+#define T UArray2bSlab_T
+typedef struct T *T;
+
+extern T    UArray2bSlab_new(int width, int height, int size, int blocksize);
+extern T    UArray2bSlab_new_64K_block(int width, int height, int size);
+extern int  UArray2bSlab_blocksize_64K(int size);
+extern void UArray2bSlab_free(T *array2b);
+
+extern int  UArray2bSlab_width    (T array2b);
+extern int  UArray2bSlab_height   (T array2b);
+extern int  UArray2bSlab_size     (T array2b);
+extern int  UArray2bSlab_blocksize(T array2b);
+
+extern void *UArray2bSlab_at(T array2b, int col, int row);
+
+/* visits every cell in storage order: block by block, rows within a block */
+extern void  UArray2bSlab_map(T array2b, void apply(int col, int row,
+                              T array2b, void *elem, void *cl), void *cl);
+
+/* the number of blocks, counting partial blocks along the edges */
+extern int   UArray2bSlab_blockcount(T array2b);
+
+/* a slab whose cells are not yet written; every block must be cleared with
+   UArray2bSlab_clear_block_range before it is used. clearing the blocks
+   from the threads that will map them places their pages near them */
+extern T    UArray2bSlab_new_unzeroed(int width, int height, int size,
+                                      int blocksize);
+extern void UArray2bSlab_clear_block_range(T array2b, int first, int last);
+
+/* the number of workers whose ThreadPool_for_static split cleared the
+   blocks, so that parallel maps can split them the same way; 0, the
+   default, when the slab was not cleared that way */
+extern int  UArray2bSlab_touchers    (T array2b);
+extern void UArray2bSlab_set_touchers(T array2b, int nworkers);
+
+/* visits the blocks numbered [first, last) in slab order; disjoint ranges
+   can be mapped by different threads at the same time */
+extern void  UArray2bSlab_map_block_range(T array2b, int first, int last,
+                              void apply(int col, int row, T array2b,
+                                         void *elem, void *cl), void *cl);
+
+/* calls apply once per block, in storage order, with the block's origin,
+   its clipped extent and a pointer to its first cell */
+extern void  UArray2bSlab_map_blocks(T array2b, void apply(int col, int row,
+                              int width, int height, void *elems,
+                              int colstride, int rowstride, T array2b,
+                              void *cl), void *cl);
+
+/* what UArray2bSlab_map_blocks passes for block n, in slab order: returns
+   the pointer and stores the rest */
+extern void *UArray2bSlab_block(T array2b, int n, int *col, int *row,
+                                int *width, int *height, int *colstride,
+                                int *rowstride);
+
+#undef T
+#endif
@@ -0,0 +1,403 @@
+/*
+ *     uarray2bsparse.c
+ *     locality
+ *
+ *     Implementation of a two dimensional blocked array that makes each
+ *     block the first time it is written
+ */
+#include "uarray2bsparse.h"
+#include "bigalloc.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define T UArray2bSparse_T
+
+/*Structure storing the information accessed by the UArray2bSparse interface.
+Stores the dimensions, element size and blocksize of the array, the number of
+blocks across and down it, the byte length of one block, a table of the
+blocks row by row of blocks (NULL for a block not yet made), the block of
+zeros that get() reads in their place, how many blocks have been made, and
+the scratch block a cursor is walking in place of unmade block pendingN*/
+struct T {
+        int width, height;
+        int size;
+        int blocksize;
+        int blocksWide, blocksHigh;
+        size_t blockBytes;
+        char **blocks;
+        char *zero;
+        int made;
+        char *pending;
+        int pendingN;
+};
+
+/*************UArray2bSparse_new*****************************************
+*
+* Function that initializes a UArray2bSparse with no blocks made
+*
+* Parameters: int width: the width of the array
+*             int height: the height of the array
+*             int size: the size of an element in the array
+*             int blocksize: the length of a block in the array
+*
+* Return: the new array, every cell of which reads as zero
+*
+* Expects: dimensions are not negative, size > 0 and blocksize > 0
+*
+* Notes: the cost is one pointer per block and one block of zeros,
+* whatever the array will hold
+*
+*********************************************************************/
+extern T UArray2bSparse_new(int width, int height, int size, int blocksize)
+{
+        assert(width >= 0 && height >= 0);
+        assert(size > 0);
+        assert(blocksize > 0);
+
+        T array = malloc(sizeof(*array));
+        assert(array != NULL);
+        array->width = width;
+        array->height = height;
+        array->size = size;
+        array->blocksize = blocksize;
+        array->blocksWide = (width + blocksize - 1) / blocksize;
+        array->blocksHigh = (height + blocksize - 1) / blocksize;
+        array->blockBytes = (size_t)blocksize * blocksize * size;
+        array->made = 0;
+        array->pending = NULL;
+        array->pendingN = -1;
+
+        /* one spare entry, so an empty array still gets a table */
+        int count = array->blocksWide * array->blocksHigh;
+        array->blocks = calloc(count + 1, sizeof(char *));
+        assert(array->blocks != NULL);
+        array->zero = BigAlloc_new(array->blockBytes);
+        return array;
+}
+
+extern void UArray2bSparse_free(T *array2b)
+{
+        assert(array2b != NULL && *array2b != NULL);
+        T a = *array2b;
+        if (a->pending != NULL) {
+                BigAlloc_free(a->pending, a->blockBytes);
+        }
+        int count = a->blocksWide * a->blocksHigh;
+        for (int n = 0; n < count; n++) {
+                if (a->blocks[n] != NULL) {
+                        BigAlloc_free(a->blocks[n], a->blockBytes);
+                }
+        }
+        BigAlloc_free(a->zero, a->blockBytes);
+        free(a->blocks);
+        free(a);
+        *array2b = NULL;
+}
+
+extern int UArray2bSparse_width(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->width;
+}
+
+extern int UArray2bSparse_height(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->height;
+}
+
+extern int UArray2bSparse_size(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->size;
+}
+
+extern int UArray2bSparse_blocksize(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->blocksize;
+}
+
+extern int UArray2bSparse_blockcount(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->blocksWide * array2b->blocksHigh;
+}
+
+/* makes buffer, which holds the cells of block n, the block */
+static void adopt(T a, int n, char *buffer)
+{
+        a->blocks[n] = buffer;
+        __atomic_fetch_add(&a->made, 1, __ATOMIC_RELAXED);
+}
+
+/* whether a block's worth of buffer is still all zeros */
+static inline bool is_zero(T a, const char *buffer)
+{
+        return memcmp(buffer, a->zero, a->blockBytes) == 0;
+}
+
+/*************settle_block**********************************************
+*
+* Makes block n from the scratch block a cursor has been walking in its
+* place, if the cursor has written to it
+*
+* Parameters: T a: a UArray2bSparse that has been initialized
+*             int n: a block number
+*
+* Return: nothing
+*
+* Notes: only the thread that owns block n touches the scratch block for
+* it, so pendingN is the one field threads mapping other blocks may read
+* while it changes. A scratch block that is still all zeros is kept, and
+* stays the one the cursor writes to, so no pointer the cursor holds is
+* ever left dangling
+*
+*********************************************************************/
+static void settle_block(T a, int n)
+{
+        if (__atomic_load_n(&a->pendingN, __ATOMIC_ACQUIRE) == n
+            && !is_zero(a, a->pending)) {
+                adopt(a, n, a->pending);
+                a->pending = NULL;
+                __atomic_store_n(&a->pendingN, -1, __ATOMIC_RELEASE);
+        }
+}
+
+/* settles the cursor's scratch block, whichever block it stands in for;
+   every function that looks at the blocks does this first, so a cursor's
+   writes are never missed */
+static void settle(T a)
+{
+        if (a->pendingN >= 0) {
+                settle_block(a, a->pendingN);
+        }
+}
+
+/* block n, made zeroed if it has not been yet; an unwritten scratch block
+   standing in for it becomes the block */
+static char *make_block(T a, int n)
+{
+        if (a->blocks[n] == NULL) {
+                if (a->pendingN == n) {
+                        adopt(a, n, a->pending);
+                        a->pending = NULL;
+                        __atomic_store_n(&a->pendingN, -1, __ATOMIC_RELEASE);
+                } else {
+                        adopt(a, n, BigAlloc_new(a->blockBytes));
+                }
+        }
+        return a->blocks[n];
+}
+
+extern int UArray2bSparse_madecount(T array2b)
+{
+        assert(array2b != NULL);
+        settle(array2b);
+        return __atomic_load_n(&array2b->made, __ATOMIC_RELAXED);
+}
+
+/* the byte offset of cell (col, row) inside its block */
+static inline size_t cell_offset(T a, int col, int row)
+{
+        int b = a->blocksize;
+        return ((size_t)b * (row % b) + col % b) * a->size;
+}
+
+/*************UArray2bSparse_at****************************************
+*
+* Function that gets an element to read or write
+*
+* Parameters: T array2b: a UArray2bSparse that has been initialized
+*             int col: col index of the element
+*             int row: row index of the element
+*
+* Return: void pointer of element at given index
+*
+* Expects: array2b is not NULL, indices are within bounds of array
+*
+* Notes: the element's block is made, zeroed, if it was not already, so
+* code that only reads should call UArray2bSparse_get instead
+*
+*********************************************************************/
+extern void *UArray2bSparse_at(T array2b, int col, int row)
+{
+        assert(array2b != NULL);
+        assert(col >= 0 && col < array2b->width);
+        assert(row >= 0 && row < array2b->height);
+
+        int b = array2b->blocksize;
+        int n = (row / b) * array2b->blocksWide + col / b;
+        settle(array2b);
+        return make_block(array2b, n) + cell_offset(array2b, col, row);
+}
+
+/*************UArray2bSparse_get***************************************
+*
+* Function that gets an element to read
+*
+* Parameters: T array2b: a UArray2bSparse that has been initialized
+*             int col: col index of the element
+*             int row: row index of the element
+*
+* Return: pointer to the element, or to a zero element of the shared zero
+* block if the element's block has not been made
+*
+* Expects: array2b is not NULL, indices are within bounds of array. Writing
+* through the pointer is an unchecked runtime error
+*
+*********************************************************************/
+extern const void *UArray2bSparse_get(T array2b, int col, int row)
+{
+        assert(array2b != NULL);
+        assert(col >= 0 && col < array2b->width);
+        assert(row >= 0 && row < array2b->height);
+
+        int b = array2b->blocksize;
+        settle(array2b);
+        char *block = array2b->blocks[(row / b) * array2b->blocksWide
+                                      + col / b];
+        return (block != NULL ? block : array2b->zero)
+               + cell_offset(array2b, col, row);
+}
+
+/* calls apply for each cell of block n inside the array, row by row */
+static void map_block(T a, int n, char *block, void apply(int col, int row,
+                      T array2b, void *elem, void *cl), void *cl)
+{
+        int b = a->blocksize;
+        int col0 = n % a->blocksWide * b;
+        int row0 = n / a->blocksWide * b;
+        int colEnd = col0 + b < a->width ? col0 + b : a->width;
+        int rowEnd = row0 + b < a->height ? row0 + b : a->height;
+        for (int row = row0; row < rowEnd; row++) {
+                char *elem = block + (size_t)(row - row0) * b * a->size;
+                for (int col = col0; col < colEnd; col++) {
+                        apply(col, row, a, elem, cl);
+                        elem += a->size;
+                }
+        }
+}
+
+extern void UArray2bSparse_map(T array2b, void apply(int col, int row,
+        T array2b, void *elem, void *cl), void *cl)
+{
+        assert(array2b != NULL);
+        UArray2bSparse_map_block_range(array2b, 0,
+                                       UArray2bSparse_blockcount(array2b),
+                                       apply, cl);
+}
+
+extern void UArray2bSparse_map_made(T array2b, void apply(int col, int row,
+        T array2b, void *elem, void *cl), void *cl)
+{
+        assert(array2b != NULL);
+        settle(array2b);
+        int count = UArray2bSparse_blockcount(array2b);
+        for (int n = 0; n < count; n++) {
+                if (array2b->blocks[n] != NULL) {
+                        map_block(array2b, n, array2b->blocks[n], apply, cl);
+                }
+        }
+}
+
+/*************UArray2bSparse_map_block_range****************************
+*
+* Traverses the blocks numbered first up to but not including last, in the
+* same order as UArray2bSparse_map, and calls the apply function for each
+* element
+*
+* Parameters: T array2b: a UArray2bSparse that has been initialized
+*             int first, last: the range of block numbers to visit
+*             void apply: function called for each element with its column,
+*                   row, the array, a pointer to the element and the closure
+*             void *cl: a closure statement for the map function
+*
+* Return: nothing, but apply function affects elements of array and closure
+*
+* Notes: an unmade block is visited in a zeroed scratch block, which becomes
+* the block only if apply leaves something other than zeros in it, so a map
+* that only reads makes nothing. A cursor's writes to a block in the range
+* are settled before the block is visited. A pointer to a cell of an
+* unmade block is good only until apply returns, and making that block
+* through at() while it is being visited is an unchecked runtime error
+*
+*********************************************************************/
+extern void UArray2bSparse_map_block_range(T array2b, int first, int last,
+        void apply(int col, int row, T array2b, void *elem, void *cl),
+        void *cl)
+{
+        assert(array2b != NULL);
+        assert(0 <= first && first <= last
+               && last <= UArray2bSparse_blockcount(array2b));
+        char *scratch = NULL;
+        for (int n = first; n < last; n++) {
+                settle_block(array2b, n);
+                if (array2b->blocks[n] != NULL) {
+                        map_block(array2b, n, array2b->blocks[n], apply, cl);
+                        continue;
+                }
+                if (__atomic_load_n(&array2b->pendingN, __ATOMIC_ACQUIRE)
+                    == n) {
+                        /* share the cursor's scratch block, so neither
+                           loses what the other writes */
+                        map_block(array2b, n, array2b->pending, apply, cl);
+                        settle_block(array2b, n);
+                        continue;
+                }
+                if (scratch == NULL) {
+                        scratch = BigAlloc_new(array2b->blockBytes);
+                }
+                map_block(array2b, n, scratch, apply, cl);
+                if (!is_zero(array2b, scratch)) {
+                        adopt(array2b, n, scratch);
+                        scratch = NULL;
+                }
+        }
+        if (scratch != NULL) {
+                BigAlloc_free(scratch, array2b->blockBytes);
+        }
+}
+
+/*************UArray2bSparse_block***************************************
+*
+* Finds block n for a cursor, with its origin, clipped extent and strides
+*
+* Parameters: T array2b: a UArray2bSparse that has been initialized
+*             int n: a block number, in [0, UArray2bSparse_blockcount)
+*             int *col, *row, *width, *height, *colstride, *rowstride: set
+*                   as for A2Methods_runfun
+*
+* Return: the first cell of the block, or of a zeroed scratch block that
+* stands in for it when it has not been made
+*
+* Notes: the scratch block becomes block n when anything looks at the array
+* after a nonzero value was written to it, so a cursor that only reads
+* makes nothing. An array has one scratch block, so stepping two cursors
+* through one array at the same time is an unchecked runtime error
+*
+*********************************************************************/
+extern void *UArray2bSparse_block(T array2b, int n, int *col, int *row,
+        int *width, int *height, int *colstride, int *rowstride)
+{
+        assert(array2b != NULL);
+        assert(0 <= n && n < UArray2bSparse_blockcount(array2b));
+        settle(array2b);
+        int b = array2b->blocksize;
+        *col = n % array2b->blocksWide * b;
+        *row = n / array2b->blocksWide * b;
+        *width = *col + b < array2b->width ? b : array2b->width - *col;
+        *height = *row + b < array2b->height ? b : array2b->height - *row;
+        *colstride = array2b->size;
+        *rowstride = b * array2b->size;
+        if (array2b->blocks[n] != NULL) {
+                return array2b->blocks[n];
+        }
+        if (array2b->pending == NULL) {
+                array2b->pending = BigAlloc_new(array2b->blockBytes);
+        }
+        array2b->pendingN = n;
+        return array2b->pending;
+}
@@ -0,0 +1,77 @@
+/*
+ *     uarray2bsparse.h
+ *     locality
+ *
+ *     A two dimensional blocked array whose blocks are made on first use.
+ *     A new array is only a table of block pointers, all NULL, and one block
+ *     of zeros; making an array of any size costs the table. The first at()
+ *     of a cell of a block allocates the block. get() never allocates:
+ *     cells of blocks that have not been made read from the zero block.
+ *     Maps and cursors walk an unmade block in a zeroed scratch block and
+ *     make the block only if something other than zeros is written to it,
+ *     so reading a sparse array through them does not fill it in. An array
+ *     that is mostly never written, like a mask or a canvas that is only
+ *     partly drawn on, holds only the blocks that were.
+ *     Cells within a block are stored row by row, and blocks are numbered
+ *     row by row of blocks.
+ *
+ *     Making blocks from several threads at once is safe only when they make
+ *     different blocks, as the block range map does.
+ */
+
+#ifndef UARRAY2BSPARSE_INCLUDED
+#define UARRAY2BSPARSE_INCLUDED
+
+#define T UArray2bSparse_T
+typedef struct T *T;
+
+/* a new array every cell of which reads as zero; blocksize > 0 */
+extern T    UArray2bSparse_new(int width, int height, int size, int blocksize);
+extern void UArray2bSparse_free(T *array2b);
+
+extern int  UArray2bSparse_width    (T array2b);
+extern int  UArray2bSparse_height   (T array2b);
+extern int  UArray2bSparse_size     (T array2b);
+extern int  UArray2bSparse_blocksize(T array2b);
+
+/* the cell at (col, row), to read or write; makes its block if needed */
+extern void *UArray2bSparse_at(T array2b, int col, int row);
+
+/* the cell at (col, row), to read only; makes nothing */
+extern const void *UArray2bSparse_get(T array2b, int col, int row);
+
+/* visits every cell block by block; makes only the blocks apply writes
+   something other than zeros to, and a pointer to a cell of a block that
+   was not made is good only until apply returns */
+extern void  UArray2bSparse_map(T array2b, void apply(int col, int row,
+                                T array2b, void *elem, void *cl), void *cl);
+
+/* visits the cells of the blocks that have been made, in the same order,
+   and skips the rest */
+extern void  UArray2bSparse_map_made(T array2b, void apply(int col, int row,
+                                     T array2b, void *elem, void *cl),
+                                     void *cl);
+
+/* the number of blocks, counting partial blocks along the edges, and the
+   number of them that have been made */
+extern int   UArray2bSparse_blockcount(T array2b);
+extern int   UArray2bSparse_madecount (T array2b);
+
+/* visits the blocks numbered [first, last) as UArray2bSparse_map does;
+   disjoint ranges can be mapped by different threads at the same time */
+extern void  UArray2bSparse_map_block_range(T array2b, int first, int last,
+                                void apply(int col, int row, T array2b,
+                                           void *elem, void *cl), void *cl);
+
+/* the first cell of block n, or of a zeroed scratch block standing in for
+   it until something other than zeros is written there, with the block's
+   origin, its extent inside the array and the byte distance between
+   neighbouring columns and rows; the array has one scratch block, so two
+   cursors stepping through one array at once is an unchecked runtime
+   error */
+extern void *UArray2bSparse_block(T array2b, int n, int *col, int *row,
+                                  int *width, int *height, int *colstride,
+                                  int *rowstride);
+
+#undef T
+#endif
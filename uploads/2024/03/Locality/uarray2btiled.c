@@ -0,0 +1,312 @@
+/*
+ *     uarray2btiled.c
+ *     locality
+ *
+ *     Implementation of a two dimensional array blocked for the level 2
+ *     cache outside and tiled for the level 1 cache inside
+ */
+#include "uarray2btiled.h"
+#include "bigalloc.h"
+#include <assert.h>
+#include <stdlib.h>
+
+#define T UArray2bTiled_T
+
+#define TILE UARRAY2BTILED_TILE
+#define TILE_CELLS (TILE * TILE)
+
+/*Structure storing the information accessed by the UArray2bTiled interface.
+Stores the dimensions and element size, the outer block edge (a whole number
+of tiles), the number of tiles across one block, the number of blocks across
+and down the array, the byte length of a tile and of a block, and the single
+allocation holding every block back to back*/
+struct T {
+        int width, height;
+        int size;
+        int blocksize;
+        int tilesWide;
+        int blocksWide, blocksHigh;
+        size_t tileBytes, blockBytes;
+        char *cells;
+};
+
+static inline size_t total_bytes(T a)
+{
+        return a->blockBytes * a->blocksWide * a->blocksHigh;
+}
+
+static inline int min(int x, int y)
+{
+        return x < y ? x : y;
+}
+
+/*************UArray2bTiled_new*****************************************
+*
+* Function that initializes an empty UArray2bTiled with the specified
+* dimensions and outer block edge
+*
+* Parameters: int width: the width of the array
+*             int height: the height of the array
+*             int size: the size of an element in the array
+*             int blocksize: the edge of an outer block
+*
+* Return: the newly initialized UArray2bTiled, with every cell zeroed
+*
+* Expects: dimensions are not negative, size > 0 and blocksize > 0
+*
+* Notes: blocksize is rounded up to a multiple of UARRAY2BTILED_TILE, so
+* every block holds whole tiles. A tile is 64 cells, a whole number of
+* cache lines, so every tile starts on a line boundary
+*
+*********************************************************************/
+extern T UArray2bTiled_new(int width, int height, int size, int blocksize)
+{
+        assert(width >= 0 && height >= 0);
+        assert(size > 0);
+        assert(blocksize > 0);
+
+        T array = malloc(sizeof(*array));
+        assert(array != NULL);
+        array->width = width;
+        array->height = height;
+        array->size = size;
+        array->tilesWide = (blocksize + TILE - 1) / TILE;
+        array->blocksize = array->tilesWide * TILE;
+        array->blocksWide = (width + array->blocksize - 1) / array->blocksize;
+        array->blocksHigh = (height + array->blocksize - 1)
+                            / array->blocksize;
+        array->tileBytes = (size_t)TILE_CELLS * size;
+        array->blockBytes = array->tileBytes * array->tilesWide
+                            * array->tilesWide;
+
+        size_t total = total_bytes(array);
+        array->cells = total > 0 ? BigAlloc_new(total) : NULL;
+        return array;
+}
+
+extern void UArray2bTiled_free(T *array2b)
+{
+        assert(array2b != NULL && *array2b != NULL);
+        if ((*array2b)->cells != NULL) {
+                BigAlloc_free((*array2b)->cells, total_bytes(*array2b));
+        }
+        free(*array2b);
+        *array2b = NULL;
+}
+
+/*************UArray2bTiled_at******************************************
+*
+* Function that gets an element at specified indices in the given array
+*
+* Parameters: T array2b: a UArray2bTiled that has been initialized
+*             int col: col index of the element
+*             int row: row index of the element
+*
+* Return: void pointer of element at given index
+*
+* Expects: array2b is not NULL, indices are within bounds of array
+*
+* Notes: the tile edge is a constant power of two, so the tile and the
+* cell inside it come from shifts and masks; only the outer block needs a
+* division
+*
+*********************************************************************/
+extern void *UArray2bTiled_at(T array2b, int col, int row)
+{
+        assert(array2b != NULL);
+        assert(col >= 0 && col < array2b->width);
+        assert(row >= 0 && row < array2b->height);
+
+        int b = array2b->blocksize;
+        int bx = col / b, by = row / b;
+        int cx = col - bx * b, cy = row - by * b;
+        size_t block = (size_t)by * array2b->blocksWide + bx;
+        size_t tile = (size_t)(cy / TILE) * array2b->tilesWide + cx / TILE;
+        size_t cell = (size_t)(cy % TILE) * TILE + cx % TILE;
+        return array2b->cells + block * array2b->blockBytes
+                              + tile * array2b->tileBytes
+                              + cell * array2b->size;
+}
+
+extern int UArray2bTiled_width(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->width;
+}
+
+extern int UArray2bTiled_height(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->height;
+}
+
+extern int UArray2bTiled_size(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->size;
+}
+
+extern int UArray2bTiled_blocksize(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->blocksize;
+}
+
+extern int UArray2bTiled_blockcount(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->blocksWide * array2b->blocksHigh;
+}
+
+/*************map_block**************************************************
+*
+* Calls apply for every cell of outer block n that lies inside the array,
+* tile by tile in storage order
+*
+* Parameters: T a: a UArray2bTiled that has been initialized
+*             int n: the block, numbered row by row of blocks
+*             void apply: the function to call for each cell
+*             void *cl: the closure passed to apply
+*
+* Return: nothing, but apply function affects elements of array and closure
+*
+* Notes: tiles past the right or bottom edge of the array are skipped, but
+* the tile pointer still steps over them, since they take up their place in
+* the block
+*
+*********************************************************************/
+static void map_block(T a, int n, void apply(int col, int row, T array2b,
+                      void *elem, void *cl), void *cl)
+{
+        int b = a->blocksize;
+        int size = a->size;
+        int col0 = n % a->blocksWide * b;
+        int row0 = n / a->blocksWide * b;
+        char *tile = a->cells + (size_t)n * a->blockBytes;
+
+        for (int ty = row0; ty < row0 + b; ty += TILE) {
+                int rowEnd = min(ty + TILE, a->height);
+                for (int tx = col0; tx < col0 + b; tx += TILE) {
+                        int colEnd = min(tx + TILE, a->width);
+                        for (int row = ty; row < rowEnd; row++) {
+                                char *elem = tile
+                                        + (size_t)(row - ty) * TILE * size;
+                                for (int col = tx; col < colEnd; col++) {
+                                        apply(col, row, a, elem, cl);
+                                        elem += size;
+                                }
+                        }
+                        tile += a->tileBytes;
+                }
+        }
+}
+
+extern void UArray2bTiled_map(T array2b, void apply(int col, int row,
+        T array2b, void *elem, void *cl), void *cl)
+{
+        assert(array2b != NULL);
+        UArray2bTiled_map_block_range(array2b, 0,
+                                      UArray2bTiled_blockcount(array2b),
+                                      apply, cl);
+}
+
+extern void UArray2bTiled_map_block_range(T array2b, int first, int last,
+        void apply(int col, int row, T array2b, void *elem, void *cl),
+        void *cl)
+{
+        assert(array2b != NULL);
+        assert(0 <= first && first <= last
+               && last <= UArray2bTiled_blockcount(array2b));
+        for (int n = first; n < last; n++) {
+                map_block(array2b, n, apply, cl);
+        }
+}
+
+/*************UArray2bTiled_map_blocks**********************************
+*
+* Traverses the array one tile at a time, in storage order, and calls the
+* apply function once for each tile
+*
+* Parameters: T array2b: a UArray2bTiled that has been initialized
+*             void apply: function called for each tile with the column and
+*                   row of its top left cell, the number of columns and rows
+*                   of the tile that lie inside the array, a pointer to the
+*                   top left cell, the byte distance between neighbouring
+*                   columns and rows, the array and the closure
+*             void *cl: a closure statement for the map function
+*
+* Return: nothing, but apply function affects elements of array and closure
+*
+* Notes: the runs are tiles rather than outer blocks, because only a tile
+* has a single row stride
+*
+*********************************************************************/
+extern void UArray2bTiled_map_blocks(T array2b, void apply(int col, int row,
+        int width, int height, void *elems, int colstride, int rowstride,
+        T array2b, void *cl), void *cl)
+{
+        assert(array2b != NULL);
+        int b = array2b->blocksize;
+        int size = array2b->size;
+        char *tile = array2b->cells;
+
+        for (int by = 0; by < array2b->blocksHigh; by++) {
+                for (int bx = 0; bx < array2b->blocksWide; bx++) {
+                        for (int ty = by * b; ty < by * b + b; ty += TILE) {
+                                for (int tx = bx * b; tx < bx * b + b;
+                                     tx += TILE) {
+                                        int cols = min(TILE,
+                                                       array2b->width - tx);
+                                        int rows = min(TILE,
+                                                       array2b->height - ty);
+                                        if (cols > 0 && rows > 0) {
+                                                apply(tx, ty, cols, rows,
+                                                      tile, size, TILE * size,
+                                                      array2b, cl);
+                                        }
+                                        tile += array2b->tileBytes;
+                                }
+                        }
+                }
+        }
+}
+
+extern int UArray2bTiled_tilecount(T array2b)
+{
+        assert(array2b != NULL);
+        return UArray2bTiled_blockcount(array2b) * array2b->tilesWide
+               * array2b->tilesWide;
+}
+
+/*************UArray2bTiled_tile******************************************
+*
+* Function that describes one tile as UArray2bTiled_map_blocks would
+*
+* Parameters: T array2b: a UArray2bTiled that has been initialized
+*             int n: the tile, numbered in storage order
+*             int *col, *row, *width, *height, *colstride, *rowstride: set
+*                   to what map_blocks passes for the tile
+*
+* Return: a pointer to the tile's first cell
+*
+* Notes: tiles past the right or bottom edge of the array have a width or
+* height of 0 or less; map_blocks skips them, and so should the caller
+*
+*********************************************************************/
+extern void *UArray2bTiled_tile(T array2b, int n, int *col, int *row,
+        int *width, int *height, int *colstride, int *rowstride)
+{
+        assert(array2b != NULL);
+        assert(0 <= n && n < UArray2bTiled_tilecount(array2b));
+        int tiles = array2b->tilesWide * array2b->tilesWide;
+        int block = n / tiles, tile = n % tiles;
+        *col = block % array2b->blocksWide * array2b->blocksize
+               + tile % array2b->tilesWide * TILE;
+        *row = block / array2b->blocksWide * array2b->blocksize
+               + tile / array2b->tilesWide * TILE;
+        *width = min(TILE, array2b->width - *col);
+        *height = min(TILE, array2b->height - *row);
+        *colstride = array2b->size;
+        *rowstride = TILE * array2b->size;
+        return array2b->cells + (size_t)n * array2b->tileBytes;
+}
@@ -0,0 +1,67 @@
+/*
+ *     uarray2btiled.h
+ *     locality
+ *
+ *     A two dimensional array blocked at two levels. The outer blocks are
+ *     sized for the level 2 cache, like UArray2b's; each is divided into
+ *     8 x 8 tiles small enough that a source tile and a destination tile sit
+ *     in the level 1 cache together. Everything lives in one allocation:
+ *     outer blocks in row-major order of blocks, the tiles of a block in
+ *     row-major order of tiles, and the cells of a tile row by row. A map in
+ *     that order finishes a tile before it starts the next, so a rotation
+ *     whose source is tiled too reads from at most four source tiles per
+ *     destination tile.
+ */
+
+#ifndef UARRAY2BTILED_INCLUDED
+#define UARRAY2BTILED_INCLUDED
+
+#define T UArray2bTiled_T
+typedef struct T *T;
+
+/* the edge of a tile, in cells */
+#define UARRAY2BTILED_TILE 8
+
+/* new zeroed array; blocksize is the outer edge, rounded up to a whole
+   number of tiles */
+extern T    UArray2bTiled_new(int width, int height, int size, int blocksize);
+extern void UArray2bTiled_free(T *array2b);
+
+extern int  UArray2bTiled_width    (T array2b);
+extern int  UArray2bTiled_height   (T array2b);
+extern int  UArray2bTiled_size     (T array2b);
+extern int  UArray2bTiled_blocksize(T array2b);
+
+extern void *UArray2bTiled_at(T array2b, int col, int row);
+
+/* visits every cell in storage order: block by block, tile by tile within
+   a block, row by row within a tile */
+extern void  UArray2bTiled_map(T array2b, void apply(int col, int row,
+                               T array2b, void *elem, void *cl), void *cl);
+
+/* the number of outer blocks, counting partial blocks along the edges */
+extern int   UArray2bTiled_blockcount(T array2b);
+
+/* visits the outer blocks numbered [first, last) as UArray2bTiled_map
+   does; disjoint ranges can be mapped by different threads at once */
+extern void  UArray2bTiled_map_block_range(T array2b, int first, int last,
+                               void apply(int col, int row, T array2b,
+                                          void *elem, void *cl), void *cl);
+
+/* calls apply once per tile, in storage order, with the tile's origin, its
+   clipped extent and a pointer to its first cell */
+extern void  UArray2bTiled_map_blocks(T array2b, void apply(int col, int row,
+                               int width, int height, void *elems,
+                               int colstride, int rowstride, T array2b,
+                               void *cl), void *cl);
+
+/* the number of tiles, counting those wholly past the array's edges, and
+   what map_blocks passes for tile n in storage order: returns the pointer
+   and stores the rest. Tiles past the edges get no cells */
+extern int   UArray2bTiled_tilecount(T array2b);
+extern void *UArray2bTiled_tile(T array2b, int n, int *col, int *row,
+                                int *width, int *height, int *colstride,
+                                int *rowstride);
+
+#undef T
+#endif
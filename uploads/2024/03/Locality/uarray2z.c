@@ -0,0 +1,306 @@
+/*
+ *     uarray2z.c
+ *     locality
+ *
+ *     Implementation of a two dimensional array stored in Z (Morton) order
+ */
+#include "uarray2z.h"
+#include "bigalloc.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+#define T UArray2z_T
+
+/* even bits of a Morton index hold the column, odd bits hold the row */
+#define EVEN_BITS UINT64_C(0x5555555555555555)
+#define ODD_BITS  UINT64_C(0xAAAAAAAAAAAAAAAA)
+
+/*Structure storing the information accessed by the UArray2z interface. The
+padded dimensions are 1 << lgWidth by 1 << lgHeight. The low 2 * lgSquare
+bits of an index interleave the low lgSquare bits of col and row, where
+lgSquare is the smaller of lgWidth and lgHeight. The remaining high bits of
+whichever coordinate is longer sit above them*/
+struct T {
+        int width, height;
+        int size;
+        int lgWidth, lgHeight;
+        int lgSquare;
+        char *elems;
+};
+
+/*
+ * spread and gather the bits of a coordinate to and from every other bit
+ * position. PDEP/PEXT do this in one instruction where the compiler is
+ * allowed to use BMI2 (e.g. -mbmi2 or -march=native); elsewhere the usual
+ * shift-and-mask ladder is used.
+ */
+static inline uint64_t spread(uint32_t x)
+{
+#if defined(__BMI2__)
+        return _pdep_u64(x, EVEN_BITS);
+#else
+        uint64_t v = x;
+        v = (v | (v << 16)) & UINT64_C(0x0000FFFF0000FFFF);
+        v = (v | (v <<  8)) & UINT64_C(0x00FF00FF00FF00FF);
+        v = (v | (v <<  4)) & UINT64_C(0x0F0F0F0F0F0F0F0F);
+        v = (v | (v <<  2)) & UINT64_C(0x3333333333333333);
+        v = (v | (v <<  1)) & UINT64_C(0x5555555555555555);
+        return v;
+#endif
+}
+
+static inline uint32_t gather(uint64_t v)
+{
+#if defined(__BMI2__)
+        return (uint32_t)_pext_u64(v, EVEN_BITS);
+#else
+        v &= UINT64_C(0x5555555555555555);
+        v = (v | (v >>  1)) & UINT64_C(0x3333333333333333);
+        v = (v | (v >>  2)) & UINT64_C(0x0F0F0F0F0F0F0F0F);
+        v = (v | (v >>  4)) & UINT64_C(0x00FF00FF00FF00FF);
+        v = (v | (v >>  8)) & UINT64_C(0x0000FFFF0000FFFF);
+        v = (v | (v >> 16)) & UINT64_C(0x00000000FFFFFFFF);
+        return (uint32_t)v;
+#endif
+}
+
+/* bytes of storage behind the padded array */
+static inline size_t storage_bytes(T a)
+{
+        return ((size_t)1 << (a->lgWidth + a->lgHeight)) * a->size;
+}
+
+/* smallest lg such that 1 << lg >= n */
+static int ceil_lg(int n)
+{
+        int lg = 0;
+        while ((1L << lg) < n) {
+                lg++;
+        }
+        return lg;
+}
+
+/********************morton_index*****************************************
+*
+* Function that converts a (col, row) coordinate to its cell number in
+* storage order
+*
+* Parameters: T a: the array the coordinate belongs to
+*             int col: a column in the array
+*             int row: a row in the array
+*
+* Return: the cell number of (col, row)
+*
+*********************************************************************/
+static inline size_t morton_index(T a, int col, int row)
+{
+        uint32_t low = (1u << a->lgSquare) - 1;
+        uint64_t square = spread(col & low) | (spread(row & low) << 1);
+        uint64_t high = (uint64_t)((col | row) >> a->lgSquare);
+        return (size_t)(square | (high << (2 * a->lgSquare)));
+}
+
+/*************UArray2z_new**********************************************
+*
+* Function that initializes an empty UArray2z with the specified dimensions
+*
+* Parameters: int width: the width of the array
+*             int height: the height of the array
+*             int size: the size of an element in the array
+*
+* Return: the newly initialized UArray2z, with every cell zeroed
+*
+* Expects: dimensions are not negative and size > 0
+*
+* Notes: storage is padded up to a power of two in each dimension, so an
+* array can use up to four times the memory of its cells
+*
+*********************************************************************/
+extern T UArray2z_new(int width, int height, int size)
+{
+        assert(width >= 0 && height >= 0);
+        assert(size > 0);
+
+        T array = malloc(sizeof(*array));
+        assert(array != NULL);
+        array->width = width;
+        array->height = height;
+        array->size = size;
+        array->lgWidth = ceil_lg(width);
+        array->lgHeight = ceil_lg(height);
+        array->lgSquare = array->lgWidth < array->lgHeight ? array->lgWidth
+                                                           : array->lgHeight;
+
+        array->elems = BigAlloc_new(storage_bytes(array));
+        return array;
+}
+
+extern void UArray2z_free(T *array2z)
+{
+        assert(array2z != NULL && *array2z != NULL);
+        BigAlloc_free((*array2z)->elems, storage_bytes(*array2z));
+        free(*array2z);
+        *array2z = NULL;
+}
+
+extern int UArray2z_width(T array2z)
+{
+        assert(array2z != NULL);
+        return array2z->width;
+}
+
+extern int UArray2z_height(T array2z)
+{
+        assert(array2z != NULL);
+        return array2z->height;
+}
+
+extern int UArray2z_size(T array2z)
+{
+        assert(array2z != NULL);
+        return array2z->size;
+}
+
+/*************UArray2z_at***********************************************
+*
+* Function that gets an element at specified indices in the given array
+*
+* Parameters: T array2z: a UArray2z that has been initialized
+*             int col: col index of the element
+*             int row: row index of the element
+*
+* Return: void pointer of element at given index
+*
+* Expects: array2z is not NULL, indices are within bounds of array
+*
+*********************************************************************/
+extern void *UArray2z_at(T array2z, int col, int row)
+{
+        assert(array2z != NULL);
+        assert(col >= 0 && col < array2z->width);
+        assert(row >= 0 && row < array2z->height);
+        return array2z->elems + morton_index(array2z, col, row)
+                                * array2z->size;
+}
+
+/*************UArray2z_map**********************************************
+*
+* Traverses the elements of the array in Z order and calls the apply
+* function for each element
+*
+* Parameters: T array2z: a UArray2z that has been initialized
+*             void apply: function called for each element with its column,
+*                   row, the array, a pointer to the element and the closure
+*             void *cl: a closure statement for the map function
+*
+* Return: nothing, but apply function affects elements of array and closure
+*
+* Notes: walks the storage front to back and recovers (col, row) from each
+* cell number, so memory is touched strictly sequentially. Padding cells
+* outside the array are skipped.
+*
+*********************************************************************/
+extern void UArray2z_map(T array2z, void apply(int col, int row, T array2z,
+                         void *elem, void *cl), void *cl)
+{
+        assert(array2z != NULL);
+        int w = array2z->width;
+        int h = array2z->height;
+        int size = array2z->size;
+        int lgSquare = array2z->lgSquare;
+        bool wide = array2z->lgWidth > array2z->lgHeight;
+        size_t squareCells = (size_t)1 << (2 * lgSquare);
+        size_t squares = (size_t)1 << (array2z->lgWidth + array2z->lgHeight
+                                       - 2 * lgSquare);
+        char *elem = array2z->elems;
+
+        for (size_t s = 0; s < squares; s++) {
+                int col0 = wide ? (int)(s << lgSquare) : 0;
+                int row0 = wide ? 0 : (int)(s << lgSquare);
+                if (col0 >= w || row0 >= h) {
+                        break;  /* the remaining squares are all padding */
+                }
+                for (size_t cell = 0; cell < squareCells; cell++) {
+                        int col = col0 + gather(cell);
+                        int row = row0 + gather(cell >> 1);
+                        if (col < w && row < h) {
+                                apply(col, row, array2z, elem, cl);
+                        }
+                        elem += size;
+                }
+        }
+}
+
+/* squares up to the last one that holds a cell of the array */
+static size_t squares_used(T a)
+{
+        if (a->width == 0 || a->height == 0) {
+                return 0;
+        }
+        bool wide = a->lgWidth > a->lgHeight;
+        int cells = wide ? a->width : a->height;
+        return ((size_t)cells + ((size_t)1 << a->lgSquare) - 1)
+               >> a->lgSquare;
+}
+
+extern int UArray2z_quadcount(T array2z)
+{
+        assert(array2z != NULL);
+        if (array2z->lgSquare == 0) {
+                return squares_used(array2z) > 0 ? 1 : 0;
+        }
+        return (int)(squares_used(array2z) << (2 * array2z->lgSquare - 2));
+}
+
+/*************UArray2z_quad*********************************************
+*
+* Finds quad n, four consecutive cells of storage, for a cursor
+*
+* Parameters: T array2z: a UArray2z that has been initialized
+*             int n: a quad number, in [0, UArray2z_quadcount)
+*             int *col, *row, *width, *height, *colstride, *rowstride: set
+*                   as for A2Methods_runfun
+*
+* Return: the first cell of the quad
+*
+* Notes: the low two bits of a Morton index are the low bits of col and
+* row, so cells 4n to 4n + 3 are an aligned 2x2 square with the column
+* bit below the row bit: a run with colstride size and rowstride twice
+* that. Quads over the padding come back clipped to no cells. With a
+* single square of side 1 there are no quads, only the long dimension's
+* bits, so the array is one straight run
+*
+*********************************************************************/
+extern void *UArray2z_quad(T array2z, int n, int *col, int *row, int *width,
+                           int *height, int *colstride, int *rowstride)
+{
+        assert(array2z != NULL);
+        assert(0 <= n && n < UArray2z_quadcount(array2z));
+        int w = array2z->width;
+        int h = array2z->height;
+        *colstride = array2z->size;
+        if (array2z->lgSquare == 0) {
+                *col = *row = 0;
+                *width = w;
+                *height = h;
+                *rowstride = array2z->size;
+                return array2z->elems;
+        }
+        int lgSquare = array2z->lgSquare;
+        size_t cell = (size_t)n << 2;
+        size_t s = cell >> (2 * lgSquare);
+        size_t inSquare = cell & (((size_t)1 << (2 * lgSquare)) - 1);
+        bool wide = array2z->lgWidth > array2z->lgHeight;
+        *col = (wide ? (int)(s << lgSquare) : 0) + (int)gather(inSquare);
+        *row = (wide ? 0 : (int)(s << lgSquare)) + (int)gather(inSquare >> 1);
+        *width = *col + 2 <= w ? 2 : (*col < w ? w - *col : 0);
+        *height = *row + 2 <= h ? 2 : (*row < h ? h - *row : 0);
+        *rowstride = 2 * array2z->size;
+        return array2z->elems + cell * array2z->size;
+}
@@ -0,0 +1,45 @@
+/*
+ *     uarray2z.h
+ *     locality
+ *
+ *     A two dimensional unboxed array stored in Z (Morton) order. The
+ *     address of cell (col, row) comes from interleaving the bits of col and
+ *     row, so cells that are close in both dimensions are close in memory at
+ *     every scale, with no block size to choose. Traversing in storage order
+ *     visits the array in Z order.
+ *
+ *     Storage is padded to a power of two in each dimension.
+ */
+
+#ifndef UARRAY2Z_INCLUDED
+#define UARRAY2Z_INCLUDED
+
+#define T UArray2z_T
+typedef struct T *T;
+
+extern T    UArray2z_new (int width, int height, int size);
+extern void UArray2z_free(T *array2z);
+
+extern int  UArray2z_width (T array2z);
+extern int  UArray2z_height(T array2z);
+extern int  UArray2z_size  (T array2z);
+
+extern void *UArray2z_at(T array2z, int col, int row);
+
+/* visits every cell in Z order, which is also storage order */
+extern void  UArray2z_map(T array2z, void apply(int col, int row, T array2z,
+                          void *elem, void *cl), void *cl);
+
+/* the number of quads up to the last one that holds a cell of the array */
+extern int   UArray2z_quadcount(T array2z);
+
+/* the first cell of quad n, the nth run of four cells in storage order,
+   with its origin, its extent inside the array and the byte distance
+   between neighbouring columns and rows. A quad is an aligned 2x2 square
+   stored row by row; when the array is one cell wide or high its cells
+   are in a straight line, and the whole array is quad 0 */
+extern void *UArray2z_quad(T array2z, int n, int *col, int *row, int *width,
+                           int *height, int *colstride, int *rowstride);
+
+#undef T
+#endif
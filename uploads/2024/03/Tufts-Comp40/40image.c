@@ -3,13 +3,18 @@
 #include <stdio.h>
 #include "assert.h"
 #include "compress40.h"
+#include "bigalloc.h"
 
 static void (*compress_or_decompress)(FILE *input) = compress40;
 
+/* freed image arrays up to this size are kept for the next image */
+#define POOL_LIMIT ((size_t)1 << 30)
+
 int main(int argc, char *argv[])
 {
         int i;
 
+        BigAlloc_pool(POOL_LIMIT);
         for (i = 1; i < argc; i++) {
                 if (strcmp(argv[i], "-c") == 0) {
                         compress_or_decompress = compress40;
@@ -2,14 +2,16 @@
 
 #include <a2blocked.h>
 #include "uarray2b.h"
+#include "blocktune.h"
 
 // define a private version of each function in A2Methods_T that we implement
 
 typedef A2Methods_UArray2 A2;   // private abbreviation
 
+/* the block edge suits this machine's caches; see blocktune.h */
 static A2 new(int width, int height, int size)
 {
-        return UArray2b_new_64K_block(width, height, size);
+        return UArray2b_new(width, height, size, BlockTune_blocksize(size));
 }
 
 static A2 new_with_blocksize(int width, int height, int size, int blocksize)
@@ -51,25 +53,33 @@ static void map_block_major(A2 array2, A2Methods_applyfun apply, void *cl)
         UArray2b_map(array2, (applyfun *) apply, cl);
 }
 
-struct small_closure {
-        A2Methods_smallapplyfun *apply;
-        void *cl;
-};
+// the client's apply is called straight from the traversal loop
+static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
+                                  void *cl)
+{
+        UArray2b_small_map(a2, apply, cl);
+}
+
+typedef void blockapplyfun(int col, int row, int width, int height,
+                           void *elems, int colstride, int rowstride,
+                           UArray2b_T array2b, void *cl);
 
-static void apply_small(int i, int j, UArray2b_T array2, void *elem, void *vcl)
+static void map_blocks(A2 array2, A2Methods_blockapplyfun apply, void *cl)
 {
-        struct small_closure *cl = vcl;
-        (void)i;
-        (void)j;
-        (void)array2;
-        cl->apply(elem, cl->cl);
+        UArray2b_map_blocks(array2, (blockapplyfun *) apply, cl);
 }
 
-static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
-                                  void *cl)
+static A2 view(A2 array2, int i, int j, int width, int height)
+{
+        return UArray2b_view(array2, i, j, width, height);
+}
+
+/* cursors step down the columns of one block, then on to the next */
+static int begin(A2 array2, A2Methods_Cursor *cursor)
 {
-        struct small_closure mycl = { apply, cl };
-        UArray2b_map(a2, apply_small, &mycl);
+        return A2Methods_begin_runs(array2, UArray2b_blockcount(array2),
+                                    (A2Methods_runfun *)UArray2b_block,
+                                    cursor);
 }
 
 static struct A2Methods_T uarray2_methods_blocked_struct = {
@@ -89,6 +99,17 @@ static struct A2Methods_T uarray2_methods_blocked_struct = {
         NULL,                   // small_map_col_major
         small_map_block_major,
         small_map_block_major,  // small_map_default
+        map_blocks,
+        NULL,                   // map_row_major_parallel
+        NULL,                   // map_col_major_parallel
+        NULL,                   // map_block_major_parallel
+        NULL,                   // map_default_parallel
+        NULL,                   // new_first_touch
+        NULL,                   // block_node
+        view,
+        NULL,                   // map_recursive
+        NULL,                   // get
+        begin,
 };
 
 // finally the payoff: here is the exported pointer to the struct
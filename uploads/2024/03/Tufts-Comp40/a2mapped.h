@@ -0,0 +1,26 @@
+/*
+ *     a2mapped.h
+ *     locality
+ *
+ *     A2Methods suite for blocked arrays stored in a memory-mapped scratch
+ *     file (see uarray2bmapped.h), for images that do not fit in memory.
+ *     Supports the same operations as uarray2_methods_slab apart from the
+ *     parallel maps and first-touch placement.
+ */
+
+#ifndef A2MAPPED_INCLUDED
+#define A2MAPPED_INCLUDED
+
+#include <stddef.h>
+#include "a2methods.h"
+
+extern A2Methods_T uarray2_methods_mapped;
+
+/*
+ * the number of bytes of arrays above which a program should switch to
+ * uarray2_methods_mapped: half of physical memory, or
+ * $A2MAPPED_THRESHOLD_MB megabytes when that is set
+ */
+extern size_t a2mapped_threshold(void);
+
+#endif
@@ -0,0 +1,238 @@
+/*
+ *     a2methods.c
+ *     locality
+ *
+ *     Implementation of the functions that work across methods suites
+ */
+#include "a2methods.h"
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#define T A2Methods_UArray2
+
+/* blocks with an edge shorter than this are too small to visit one by one:
+   a view per block would cost more than the copy */
+#define MIN_TILE_EDGE 8
+
+/*
+ * the two sides of a conversion. tiles is the array whose runs are visited
+ * one by one; for each of them, a view of the same rectangle of cells is
+ * made in window, and window's runs are copied to or from the tile
+ */
+struct convert {
+        const struct A2Methods_T *window_methods;
+        T window;
+        size_t size;
+        int tiles_is_dst;
+};
+
+/* one run of the tile being copied, seen from the window's runs */
+struct tile {
+        char *elems;
+        int colstride, rowstride;
+        const struct convert *convert;
+};
+
+#define COPY_STRIDED(SIZE) do {                                              \
+        for (int j = 0; j < height; j++) {                                   \
+                char *d = dst + (ptrdiff_t)j * drow;                         \
+                const char *s = src + (ptrdiff_t)j * srow;                   \
+                for (int i = 0; i < width; i++) {                            \
+                        memcpy(d, s, (SIZE));                                \
+                        d += dcol;                                           \
+                        s += scol;                                           \
+                }                                                            \
+        }                                                                    \
+} while (0)
+
+/*
+ * copies width x height cells of size bytes; cell (i, j) is at
+ * i * col + j * row from each base. Rows or columns that are contiguous on
+ * both sides go through memcpy, which moves them at memory speed; anything
+ * else moves one cell at a time, with the common cell sizes fixed so that
+ * each move compiles to plain loads and stores
+ */
+static void copy_cells(char *dst, int dcol, int drow, const char *src,
+                       int scol, int srow, int width, int height, size_t size)
+{
+        if ((size_t)dcol == size && (size_t)scol == size) {
+                for (int j = 0; j < height; j++) {
+                        memcpy(dst + (ptrdiff_t)j * drow,
+                               src + (ptrdiff_t)j * srow, width * size);
+                }
+        } else if ((size_t)drow == size && (size_t)srow == size) {
+                for (int i = 0; i < width; i++) {
+                        memcpy(dst + (ptrdiff_t)i * dcol,
+                               src + (ptrdiff_t)i * scol, height * size);
+                }
+        } else {
+                switch (size) {
+                case 1:  COPY_STRIDED(1);  break;
+                case 2:  COPY_STRIDED(2);  break;
+                case 4:  COPY_STRIDED(4);  break;
+                case 8:  COPY_STRIDED(8);  break;
+                case 12: COPY_STRIDED(12); break;   /* struct Pnm_rgb */
+                case 16: COPY_STRIDED(16); break;
+                default: COPY_STRIDED(size); break;
+                }
+        }
+}
+
+/* copies one run of the window to or from the matching cells of a tile */
+static void copy_run(int col, int row, int width, int height, void *elems,
+                     int colstride, int rowstride, T window, void *cl)
+{
+        struct tile *tile = cl;
+        const struct convert *convert = tile->convert;
+        char *cells = tile->elems + (ptrdiff_t)col * tile->colstride
+                                  + (ptrdiff_t)row * tile->rowstride;
+        (void)window;
+        if (convert->tiles_is_dst) {
+                copy_cells(cells, tile->colstride, tile->rowstride, elems,
+                           colstride, rowstride, width, height,
+                           convert->size);
+        } else {
+                copy_cells(elems, colstride, rowstride, cells,
+                           tile->colstride, tile->rowstride, width, height,
+                           convert->size);
+        }
+}
+
+/* copies one run of the tiled array through a view of the other array */
+static void copy_tile(int col, int row, int width, int height, void *elems,
+                      int colstride, int rowstride, T tiles, void *cl)
+{
+        const struct convert *convert = cl;
+        const struct A2Methods_T *methods = convert->window_methods;
+        struct tile tile = { elems, colstride, rowstride, convert };
+        T view = methods->view(convert->window, col, row, width, height);
+        (void)tiles;
+        methods->map_blocks(view, copy_run, &tile);
+        methods->free(&view);
+}
+
+struct cell_copy {
+        const struct A2Methods_T *src_methods;
+        T src;
+        size_t size;
+};
+
+/* the fallback: one call per cell to the source's get, or its at when it
+   has no get */
+static void copy_at(int i, int j, T dst, void *elem, void *cl)
+{
+        struct cell_copy *copy = cl;
+        const struct A2Methods_T *methods = copy->src_methods;
+        (void)dst;
+        memcpy(elem, methods->get != NULL ? methods->get(copy->src, i, j)
+                                          : methods->at(copy->src, i, j),
+               copy->size);
+}
+
+/* nonzero when runs of tiles can be paired with views of window */
+static int can_tile(A2Methods_T tiles, A2Methods_T window)
+{
+        return tiles->map_blocks != NULL && window->map_blocks != NULL
+               && window->view != NULL;
+}
+
+T A2Methods_convert(A2Methods_T src_methods, T src, A2Methods_T dst_methods)
+{
+        assert(src_methods != NULL && src != NULL && dst_methods != NULL);
+        int width = src_methods->width(src);
+        int height = src_methods->height(src);
+        size_t size = src_methods->size(src);
+        T dst = dst_methods->new(width, height, size);
+
+        /*
+         * Visit the array with the larger blocks, so that each view covers
+         * a whole block of it. When both are close to unblocked, visit the
+         * one with rows instead, so that views stay few
+         */
+        int src_edge = src_methods->blocksize(src);
+        int dst_edge = dst_methods->blocksize(dst);
+        int larger = src_edge > dst_edge ? src_edge : dst_edge;
+        int tiles_is_dst = larger >= MIN_TILE_EDGE ? dst_edge >= src_edge
+                                                   : dst_edge <= src_edge;
+        if (tiles_is_dst ? !can_tile(dst_methods, src_methods)
+                         : !can_tile(src_methods, dst_methods)) {
+                tiles_is_dst = !tiles_is_dst;
+        }
+
+        if (tiles_is_dst && can_tile(dst_methods, src_methods)) {
+                struct convert convert = { src_methods, src, size, 1 };
+                dst_methods->map_blocks(dst, copy_tile, &convert);
+        } else if (!tiles_is_dst && can_tile(src_methods, dst_methods)) {
+                struct convert convert = { dst_methods, dst, size, 0 };
+                src_methods->map_blocks(src, copy_tile, &convert);
+        } else {
+                struct cell_copy copy = { src_methods, src, size };
+                dst_methods->map_default(dst, copy_at, &copy);
+        }
+        return dst;
+}
+
+/* puts cursor at the start of line cursor->line of its run */
+static void place_line(A2Methods_Cursor *cursor)
+{
+        cursor->ptr = cursor->first + (ptrdiff_t)cursor->line
+                                      * cursor->linestride;
+        cursor->col = cursor->col0 + cursor->drow * cursor->line;
+        cursor->row = cursor->row0 + cursor->dcol * cursor->line;
+        cursor->left = cursor->length - 1;
+}
+
+/*
+ * moves cursor to the first cell of the next run that has any, walking
+ * the run along its rows or its columns, whichever is contiguous, which
+ * is also the order map_default takes inside it. returns 0 past the last
+ */
+static int next_run(A2Methods_Cursor *cursor)
+{
+        while (++cursor->n < cursor->count) {
+                int col, row, width, height, colstride, rowstride;
+                char *elems = cursor->run(cursor->array2, cursor->n, &col,
+                                          &row, &width, &height, &colstride,
+                                          &rowstride);
+                if (width <= 0 || height <= 0) {
+                        continue;
+                }
+                int rows = colstride <= rowstride;
+                cursor->dcol = rows;
+                cursor->drow = !rows;
+                cursor->step = rows ? colstride : rowstride;
+                cursor->linestride = rows ? rowstride : colstride;
+                cursor->length = rows ? width : height;
+                cursor->lines = rows ? height : width;
+                cursor->col0 = col;
+                cursor->row0 = row;
+                cursor->first = elems;
+                cursor->line = 0;
+                place_line(cursor);
+                return 1;
+        }
+        return 0;
+}
+
+int A2Methods_begin_runs(T array2, int count, A2Methods_runfun *run,
+                         A2Methods_Cursor *cursor)
+{
+        assert(cursor != NULL && run != NULL && count >= 0);
+        cursor->array2 = array2;
+        cursor->run = run;
+        cursor->count = count;
+        cursor->n = -1;
+        cursor->left = 0;
+        return next_run(cursor);
+}
+
+int A2Methods_next_line(A2Methods_Cursor *cursor)
+{
+        assert(cursor != NULL);
+        if (++cursor->line < cursor->lines) {
+                place_line(cursor);
+                return 1;
+        }
+        return next_run(cursor);
+}
@@ -0,0 +1,230 @@
+#ifndef A2METHODS_INCLUDED
+#define A2METHODS_INCLUDED
+
+/*
+ * A2Methods: a suite of function pointers that operate on any
+ * two-dimensional unboxed array (plain, blocked, ...), so that clients can
+ * be written once and run over any representation.
+ *
+ * This is the course interface from /comp/40/build/include with extra
+ * members appended at the end of struct A2Methods_T. The leading members
+ * keep their order, so code compiled against the course header (such as
+ * Pnm_ppmread) still works with these suites. Include this header before
+ * pnm.h so that it, and not the course copy, defines the struct.
+ */
+
+#define T A2Methods_UArray2
+typedef void *T;               /* an unknown 2D array */
+
+typedef void A2Methods_Object; /* an unknown element of an array */
+
+/* apply functions and the maps that call them */
+typedef void A2Methods_applyfun(int i, int j, T array2,
+                                A2Methods_Object *ptr, void *cl);
+typedef void A2Methods_mapfun(T array2, A2Methods_applyfun apply, void *cl);
+
+typedef void A2Methods_smallapplyfun(A2Methods_Object *ptr, void *cl);
+typedef void A2Methods_smallmapfun(T array2, A2Methods_smallapplyfun apply,
+                                   void *cl);
+
+/*
+ * Block-granular traversal. apply is called once per contiguous run of
+ * storage, in storage order: once per block for blocked arrays and once
+ * per row for plain ones. A run covers the width x height cells whose upper
+ * left corner is (col, row); cell (col + i, row + j) is at
+ * (char *)elems + i * colstride + j * rowstride. Cells of edge blocks that
+ * fall outside the array are never part of a run.
+ */
+typedef void A2Methods_blockapplyfun(int col, int row, int width, int height,
+                                     A2Methods_Object *elems, int colstride,
+                                     int rowstride, T array2, void *cl);
+typedef void A2Methods_blockmapfun(T array2, A2Methods_blockapplyfun apply,
+                                   void *cl);
+
+/*
+ * Parallel traversal. The cells are split into independent pieces (row
+ * bands, column bands or blocks) and nthreads workers map the pieces at the
+ * same time, each piece in the order of the matching sequential map. Worker
+ * w passes cls[w] as the closure, so cls must have nthreads entries and an
+ * apply that only touches its own cell and its own closure needs no locks.
+ */
+typedef void A2Methods_parallelmapfun(T array2, A2Methods_applyfun apply,
+                                      void *cls[], int nthreads);
+
+/*
+ * Cursors. A cursor stands on one cell of an array and steps through the
+ * cells in storage order, the order of map_default, one at a time; col,
+ * row and ptr name the cell it is on, and clients read them directly. Two
+ * arrays made by one suite's new or new_with_blocksize with the same width,
+ * height and block size are stepped through in the same order (views need
+ * not be), so a loop can advance a cursor on each and never look a cell up
+ * by its coordinates:
+ *
+ *      A2Methods_Cursor s, d;
+ *      for (int more = methods->begin(src, &s) && methods->begin(dst, &d);
+ *           more; more = A2Methods_next(&s) && A2Methods_next(&d))
+ *              ... d.ptr, s.ptr ...
+ *
+ * A suite gets cursors by walking its runs of storage (the runs map_blocks
+ * visits) one at a time. Moving within a run is A2Methods_next's few
+ * adds; only moving to the next run calls into the suite.
+ */
+typedef struct A2Methods_Cursor A2Methods_Cursor;
+
+/* the run numbered n of the count that array2 is cut into, described as
+   for A2Methods_blockapplyfun; runs with no cells are skipped */
+typedef A2Methods_Object *A2Methods_runfun(T array2, int n, int *col,
+                                           int *row, int *width, int *height,
+                                           int *colstride, int *rowstride);
+
+struct A2Methods_Cursor {
+        int col, row;           /* the cell the cursor stands on */
+        A2Methods_Object *ptr;  /* and its element */
+
+        /* the rest is traversal state, for A2Methods_next only */
+        int left;               /* cells after this one in the current line */
+        int dcol, drow;         /* the step of col and row along a line */
+        int step;               /* bytes between cells of a line */
+        T array2;
+        A2Methods_runfun *run;
+        int n, count;           /* the current run and how many there are */
+        int line, lines;        /* a run is walked as lines, along its */
+        int length;             /* contiguous direction */
+        int col0, row0;
+        char *first;            /* the run's first cell */
+        int linestride;
+};
+
+struct A2Methods_T {
+        /* creates a distinct 2D array of memory cells, each of the given
+           'size'; if the array is blocked, the block size is given or is
+           chosen to suit the caches of the machine */
+        T    (*new)(int width, int height, int size);
+        T    (*new_with_blocksize)(int width, int height, int size,
+                                   int blocksize);
+        void (*free)(T *array2p);
+
+        /* observe properties of the array */
+        int (*width)    (T array2);
+        int (*height)   (T array2);
+        int (*size)     (T array2);
+        int (*blocksize)(T array2);     /* 1 for an unblocked array */
+
+        /* returns a pointer to the object at (i, j) */
+        A2Methods_Object *(*at)(T array2, int i, int j);
+
+        /* mapping functions; NULL when the suite does not support an order */
+        A2Methods_mapfun *map_row_major;
+        A2Methods_mapfun *map_col_major;
+        A2Methods_mapfun *map_block_major;
+        A2Methods_mapfun *map_default;  /* the order with the best locality */
+
+        A2Methods_smallmapfun *small_map_row_major;
+        A2Methods_smallmapfun *small_map_col_major;
+        A2Methods_smallmapfun *small_map_block_major;
+        A2Methods_smallmapfun *small_map_default;
+
+        /* ---- extensions to the course interface ---- */
+
+        /* one call per contiguous run of storage; may be NULL */
+        A2Methods_blockmapfun *map_blocks;
+
+        /* the full maps split across threads; NULL when not supported */
+        A2Methods_parallelmapfun *map_row_major_parallel;
+        A2Methods_parallelmapfun *map_col_major_parallel;
+        A2Methods_parallelmapfun *map_block_major_parallel;
+        A2Methods_parallelmapfun *map_default_parallel;
+
+        /*
+         * NUMA placement. new_first_touch makes an array like new, except
+         * that each block is first written by the pinned worker that
+         * map_*_parallel with the same nthreads will give it to, by a
+         * static split that both use, so its pages sit on that worker's
+         * node; may be NULL. block_node returns
+         * the node holding the block (or, for unblocked arrays, the cell)
+         * at (i, j), or -1 when unknown.
+         */
+        T   (*new_first_touch)(int width, int height, int size,
+                               int nthreads);
+        int (*block_node)(T array2, int i, int j);
+
+        /*
+         * a width x height window whose cell (0, 0) is cell (i, j) of
+         * array2 and which shares array2's storage, so making one costs
+         * O(1) whatever its size. A view works with every other method of
+         * the suite. Freeing it leaves array2 alone; using it after array2
+         * is freed is an unchecked runtime error. NULL when the suite has
+         * no views
+         */
+        T   (*view)(T array2, int i, int j, int width, int height);
+
+        /*
+         * visits every cell in a cache-oblivious order, splitting the
+         * array into quadrants recursively down to small tiles, so that
+         * an unblocked array gets close to the locality of a blocked one
+         * with no block size to choose. NULL when not supported
+         */
+        A2Methods_mapfun *map_recursive;
+
+        /*
+         * the object at (i, j), for reading only. Suites whose storage is
+         * made on first use make none for get: a cell nothing was written
+         * to reads as zero. NULL when at makes nothing either, so readers
+         * that do not write use get when there is one and at otherwise
+         */
+        const A2Methods_Object *(*get)(T array2, int i, int j);
+
+        /*
+         * puts cursor on the first cell of array2 and returns nonzero, or
+         * returns 0 when array2 has no cells; A2Methods_next moves it on.
+         * NULL when the suite has no cursors
+         */
+        int (*begin)(T array2, A2Methods_Cursor *cursor);
+};
+
+/* C++ allows no typedef named like a struct tag for another type, so there
+   the suite pointer is spelled struct A2Methods_T * (see uarray2.hpp) */
+#ifndef __cplusplus
+typedef struct A2Methods_T *A2Methods_T;
+#endif
+
+/*
+ * a new array made by dst_methods->new that holds a copy of every cell of
+ * src, an array of src_methods, so that an image can move between layouts
+ * (plain to blocked and back). Block by block, each run of storage is
+ * copied with memcpy where rows or columns are contiguous on both sides,
+ * not through one call to at per cell; that needs map_blocks in both
+ * suites and view in at least one of them, and suites without them are
+ * copied through at. src is left alone
+ */
+extern T A2Methods_convert(struct A2Methods_T *src_methods, T src,
+                           struct A2Methods_T *dst_methods);
+
+/*
+ * for the begin method of a suite whose storage is cut into count runs,
+ * which run returns one at a time in storage order
+ */
+extern int A2Methods_begin_runs(T array2, int count, A2Methods_runfun *run,
+                                A2Methods_Cursor *cursor);
+
+/* moves the cursor past the end of its line; called by A2Methods_next */
+extern int A2Methods_next_line(A2Methods_Cursor *cursor);
+
+/*
+ * moves cursor to the next cell and returns nonzero, or returns 0 when it
+ * was on the last one. A cursor must not be used after that
+ */
+static inline int A2Methods_next(A2Methods_Cursor *cursor)
+{
+        if (cursor->left > 0) {
+                cursor->left--;
+                cursor->ptr = (char *)cursor->ptr + cursor->step;
+                cursor->col += cursor->dcol;
+                cursor->row += cursor->drow;
+                return 1;
+        }
+        return A2Methods_next_line(cursor);
+}
+
+#undef T
+#endif
@@ -67,35 +67,52 @@ static void map_col_major(A2Methods_UArray2   uarray2,
         UArray2_map_col_major(uarray2, (UArray2_applyfun*)apply, cl);
 }
 
-struct small_closure {
-        A2Methods_smallapplyfun *apply; 
-        void                    *cl;
-};
-
-static void apply_small(int i, int j, UArray2_T uarray2,
-                        void *elem, void *vcl)
-{
-        struct small_closure *cl = vcl;
-        (void)i;
-        (void)j;
-        (void)uarray2;
-        cl->apply(elem, cl->cl);
-}
-
+// the client's apply is called straight from the traversal loop
 static void small_map_row_major(A2Methods_UArray2        a2,
                                 A2Methods_smallapplyfun  apply,
                                 void                    *cl)
 {
-        struct small_closure mycl = { apply, cl };
-        UArray2_map_row_major(a2, apply_small, &mycl);
+        UArray2_small_map_row_major(a2, apply, cl);
 }
 
 static void small_map_col_major(A2Methods_UArray2        a2,
                                 A2Methods_smallapplyfun  apply,
                                 void                    *cl)
 {
-        struct small_closure mycl = { apply, cl };
-        UArray2_map_col_major(a2, apply_small, &mycl);
+        UArray2_small_map_col_major(a2, apply, cl);
+}
+
+typedef void rowapplyfun(int col, int row, int width, int height,
+                         void *elems, int colstride, int rowstride,
+                         UArray2_T uarray2, void *cl);
+
+static void map_blocks(A2Methods_UArray2        uarray2,
+                       A2Methods_blockapplyfun  apply,
+                       void                    *cl)
+{
+        UArray2_map_rows(uarray2, (rowapplyfun *)apply, cl);
+}
+
+static A2Methods_UArray2 view(A2Methods_UArray2 uarray2, int i, int j,
+                              int width, int height)
+{
+        return UArray2_view(uarray2, i, j, width, height);
+}
+
+static void map_recursive(A2Methods_UArray2 uarray2,
+                          A2Methods_applyfun apply,
+                          void *cl)
+{
+        UArray2_map_recursive(uarray2, (UArray2_applyfun *)apply, cl);
+}
+
+/* cursors step along the rows map_blocks hands out */
+static int begin(A2Methods_UArray2 uarray2, A2Methods_Cursor *cursor)
+{
+        int rows = UArray2_width(uarray2) > 0 ? UArray2_height(uarray2) : 0;
+        return A2Methods_begin_runs(uarray2, rows,
+                                    (A2Methods_runfun *)UArray2_row_run,
+                                    cursor);
 }
 // elide stop
 
@@ -123,7 +140,18 @@ static struct A2Methods_T uarray2_methods_plain_struct = {
         small_map_row_major,
         small_map_col_major,
         NULL,
-        small_map_row_major
+        small_map_row_major,
+        map_blocks,
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+        view,
+        map_recursive,
+        NULL,
+        begin
 // elide stop
 };
 
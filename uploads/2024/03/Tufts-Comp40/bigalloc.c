@@ -0,0 +1,236 @@
+/*
+ *     bigalloc.c
+ *     locality
+ *
+ *     Implementation of the element buffer allocator
+ */
+#include "bigalloc.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/* the size and alignment of an x86-64 transparent huge page */
+#define HUGE_PAGE ((size_t)2 << 20)
+
+/* small buffers come from malloc aligned to a cache line */
+#define CACHE_LINE 64
+
+/* at most this many freed buffers wait in the pool */
+#define POOL_SLOTS 16
+
+static int hugepages = 0;
+
+/*
+ * freed large buffers kept for reuse. A buffer serves any later request
+ * whose mapped length is the same; pool_bytes never exceeds pool_limit.
+ * The lock is a spin flag, since the pool is only touched when an array
+ * is made or freed.
+ */
+static struct {
+        void *p;
+        size_t length;
+} pool[POOL_SLOTS];
+static size_t pool_limit = 0;
+static size_t pool_bytes = 0;
+static char pool_lock = 0;
+
+/*
+ * large buffers are mapped in size classes of whole huge pages, four
+ * classes per doubling, whatever the settings: the length to unmap then
+ * follows from nbytes alone, and a pooled buffer fits every request of its
+ * class. The rounding costs address space only, since pages past nbytes
+ * are never touched
+ */
+static size_t mapped_length(size_t nbytes)
+{
+        size_t pages = (nbytes + HUGE_PAGE - 1) / HUGE_PAGE;
+        size_t step = 1;
+        while (pages > 8 * step) {
+                step *= 2;
+        }
+        return (pages + step - 1) / step * step * HUGE_PAGE;
+}
+
+static void lock_pool(void)
+{
+        while (__atomic_test_and_set(&pool_lock, __ATOMIC_ACQUIRE)) {
+                ;
+        }
+}
+
+static void unlock_pool(void)
+{
+        __atomic_clear(&pool_lock, __ATOMIC_RELEASE);
+}
+
+/* a pooled buffer of exactly length bytes, or NULL */
+static void *pool_take(size_t length)
+{
+        void *p = NULL;
+        lock_pool();
+        for (int i = 0; i < POOL_SLOTS; i++) {
+                if (pool[i].p != NULL && pool[i].length == length) {
+                        p = pool[i].p;
+                        pool[i].p = NULL;
+                        pool_bytes -= length;
+                        break;
+                }
+        }
+        unlock_pool();
+        return p;
+}
+
+/* keeps p for reuse if the pool has room; returns whether it did */
+static int pool_put(void *p, size_t length)
+{
+        int kept = 0;
+        lock_pool();
+        if (pool_bytes + length <= pool_limit) {
+                for (int i = 0; i < POOL_SLOTS; i++) {
+                        if (pool[i].p == NULL) {
+                                pool[i].p = p;
+                                pool[i].length = length;
+                                pool_bytes += length;
+                                kept = 1;
+                                break;
+                        }
+                }
+        }
+        unlock_pool();
+        return kept;
+}
+
+/* maps one extra huge page and trims the ends so the start is aligned;
+   a failed mapping ends the program in every build */
+static void *map_aligned(size_t length)
+{
+        char *raw = mmap(NULL, length + HUGE_PAGE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+                perror("BigAlloc_new: mmap");
+                exit(EXIT_FAILURE);
+        }
+
+        uintptr_t start = ((uintptr_t)raw + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+        char *p = (char *)start;
+        size_t head = p - raw;
+        if (head > 0) {
+                munmap(raw, head);
+        }
+        munmap(p + length, HUGE_PAGE - head);
+        return p;
+}
+
+/* a malloc'd buffer aligned to a cache line; running out of memory ends
+   the program in every build */
+static void *small_buffer(size_t nbytes)
+{
+        void *p = NULL;
+        int failed = posix_memalign(&p, CACHE_LINE, nbytes);
+        if (failed != 0) {
+                fprintf(stderr, "BigAlloc_new: %s\n", strerror(failed));
+                exit(EXIT_FAILURE);
+        }
+        return p;
+}
+
+/* marks a mapped buffer for huge pages when they were asked for */
+static void ask_for_hugepages(void *p, size_t length)
+{
+#ifdef MADV_HUGEPAGE
+        if (hugepages) {
+                /* fails only where THP is compiled out; normal pages then */
+                (void)madvise(p, length, MADV_HUGEPAGE);
+        }
+#else
+        (void)p;
+        (void)length;
+#endif
+}
+
+extern void *BigAlloc_new(size_t nbytes)
+{
+        assert(nbytes > 0);
+        if (nbytes < HUGE_PAGE) {
+                void *p = small_buffer(nbytes);
+                memset(p, 0, nbytes);
+                return p;
+        }
+
+        size_t length = mapped_length(nbytes);
+        void *p = pool_take(length);
+        if (p != NULL) {
+                /* its pages are still there, so this faults nothing in */
+                memset(p, 0, nbytes);
+        } else {
+                p = map_aligned(length);
+        }
+        ask_for_hugepages(p, length);
+        return p;
+}
+
+extern void *BigAlloc_new_untouched(size_t nbytes)
+{
+        assert(nbytes > 0);
+        if (nbytes < HUGE_PAGE) {
+                return small_buffer(nbytes);
+        }
+
+        size_t length = mapped_length(nbytes);
+        void *p = map_aligned(length);
+        ask_for_hugepages(p, length);
+        return p;
+}
+
+extern void BigAlloc_free(void *p, size_t nbytes)
+{
+        if (p == NULL) {
+                return;
+        }
+        if (nbytes < HUGE_PAGE) {
+                free(p);
+        } else if (!pool_put(p, mapped_length(nbytes))) {
+                munmap(p, mapped_length(nbytes));
+        }
+}
+
+extern void BigAlloc_pool(size_t limit)
+{
+        lock_pool();
+        pool_limit = limit;
+        for (int i = 0; i < POOL_SLOTS && pool_bytes > pool_limit; i++) {
+                if (pool[i].p != NULL) {
+                        munmap(pool[i].p, pool[i].length);
+                        pool_bytes -= pool[i].length;
+                        pool[i].p = NULL;
+                }
+        }
+        unlock_pool();
+}
+
+/* THP is usable unless the kernel lacks it or it is set to "[never]" */
+static int thp_enabled(void)
+{
+#ifndef MADV_HUGEPAGE
+        return 0;
+#else
+        FILE *fp = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+        if (fp == NULL) {
+                return 0;
+        }
+        char line[128];
+        int enabled = fgets(line, sizeof(line), fp) != NULL
+                      && strstr(line, "[never]") == NULL;
+        fclose(fp);
+        return enabled;
+#endif
+}
+
+extern int BigAlloc_hugepages(int on)
+{
+        hugepages = on;
+        return thp_enabled();
+}
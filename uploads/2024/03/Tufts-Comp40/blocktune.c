@@ -0,0 +1,313 @@
+/*
+ *     blocktune.c
+ *     locality
+ *
+ *     Implementation of block edge selection from the cache hierarchy
+ */
+#include "blocktune.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "uarray2b.h"
+
+/* the block size when the level 2 cache cannot be found, as in
+   UArray2b_new_64K_block */
+#define DEFAULT_BLOCK_BYTES (64 * 1024)
+
+/* a block takes this share of the level 2 cache. A quarter was twice as
+   slow as a sixteenth on a 2 MB level 2, where every edge from an eighth
+   of L1 to a sixteenth of L2 rotated within noise of the best */
+#define L2_SHARE 16
+
+/* the smallest block calibration tries */
+#define MIN_BLOCK_BYTES (4 * 1024)
+
+/* each calibration array holds about this much, more than any level 2 */
+#define CALIBRATION_BYTES ((size_t)8 << 20)
+
+/* each candidate edge is timed this many times and the best time kept */
+#define CALIBRATION_RUNS 3
+
+/* at most this many element sizes are calibrated per program */
+#define MAX_SIZES 32
+
+#define SYSFS_CACHE "/sys/devices/system/cpu/cpu0/cache"
+#define CACHE_FILE "a2blocktune"
+
+static int calibrating = 0;
+
+/* calibrated edges, from the cache file and from this run */
+static struct {
+        int size, blocksize;
+} known[MAX_SIZES];
+static int nknown = 0;
+static int loaded = 0;
+
+/* the first line of the file must be this machine's cache sizes */
+static size_t cache_size[4];    /* indexed by level; 0 when unknown */
+static int detected = 0;
+
+/* reads the first line of a sysfs file into buf; 0 if it cannot */
+static int read_line(const char *path, char *buf, int len)
+{
+        FILE *fp = fopen(path, "r");
+        if (fp == NULL) {
+                return 0;
+        }
+        int ok = fgets(buf, len, fp) != NULL;
+        fclose(fp);
+        return ok;
+}
+
+/*
+ * fills cache_size from sysfs: index0, index1, ... each describe one
+ * cache of cpu0 by level, type and a size like "48K". The instruction
+ * cache is skipped. Levels sysfs leaves out are asked of sysconf, which
+ * glibc answers from cpuid
+ */
+static void detect(void)
+{
+        char path[128], line[64];
+        for (int index = 0; index < 16; index++) {
+                snprintf(path, sizeof(path), SYSFS_CACHE "/index%d/level",
+                         index);
+                if (!read_line(path, line, sizeof(line))) {
+                        break;
+                }
+                int level = atoi(line);
+                snprintf(path, sizeof(path), SYSFS_CACHE "/index%d/type",
+                         index);
+                if (level < 1 || level > 3
+                    || !read_line(path, line, sizeof(line))
+                    || strncmp(line, "Instruction", 11) == 0) {
+                        continue;
+                }
+                snprintf(path, sizeof(path), SYSFS_CACHE "/index%d/size",
+                         index);
+                if (!read_line(path, line, sizeof(line))) {
+                        continue;
+                }
+                char *unit;
+                size_t bytes = strtoul(line, &unit, 10);
+                if (*unit == 'K') {
+                        bytes <<= 10;
+                } else if (*unit == 'M') {
+                        bytes <<= 20;
+                }
+                cache_size[level] = bytes;
+        }
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+        long level_name[4] = { 0, _SC_LEVEL1_DCACHE_SIZE,
+                               _SC_LEVEL2_CACHE_SIZE, _SC_LEVEL3_CACHE_SIZE };
+        for (int level = 1; level <= 3; level++) {
+                long bytes = sysconf(level_name[level]);
+                if (cache_size[level] == 0 && bytes > 0) {
+                        cache_size[level] = bytes;
+                }
+        }
+#endif
+        detected = 1;
+}
+
+size_t BlockTune_cache(int level)
+{
+        assert(level >= 1 && level <= 3);
+        if (!detected) {
+                detect();
+        }
+        return cache_size[level];
+}
+
+void BlockTune_calibrate(int on)
+{
+        calibrating = on;
+}
+
+/* the largest edge whose square blocks of size-byte elements fit in bytes,
+   at least 1 */
+static int edge_for(size_t bytes, int size)
+{
+        int edge = (int)sqrt((double)bytes / size);
+        return edge > 0 ? edge : 1;
+}
+
+/* the edge from the cache sizes alone */
+static int estimate(int size)
+{
+        size_t l2 = BlockTune_cache(2);
+        return edge_for(l2 > 0 ? l2 / L2_SHARE : DEFAULT_BLOCK_BYTES, size);
+}
+
+/* writes the path of the cache file into path; 0 without a home */
+static int cache_path(char *path, int len, int directory_only)
+{
+        const char *xdg = getenv("XDG_CACHE_HOME");
+        const char *home = getenv("HOME");
+        int n;
+        if (xdg != NULL && *xdg != '\0') {
+                n = snprintf(path, len, "%s", xdg);
+        } else if (home != NULL && *home != '\0') {
+                n = snprintf(path, len, "%s/.cache", home);
+        } else {
+                return 0;
+        }
+        if (!directory_only) {
+                n += snprintf(path + n, len > n ? len - n : 0, "/" CACHE_FILE);
+        }
+        return n < len;
+}
+
+/* reads the calibrated edges of this machine, if the file has any */
+static void load(void)
+{
+        char path[4096];
+        loaded = 1;
+        if (!cache_path(path, sizeof(path), 0)) {
+                return;
+        }
+        FILE *fp = fopen(path, "r");
+        if (fp == NULL) {
+                return;
+        }
+        size_t l1, l2, l3;
+        if (fscanf(fp, "caches %zu %zu %zu", &l1, &l2, &l3) == 3
+            && l1 == BlockTune_cache(1) && l2 == BlockTune_cache(2)
+            && l3 == BlockTune_cache(3)) {
+                int size, blocksize;
+                while (nknown < MAX_SIZES
+                       && fscanf(fp, "%d %d", &size, &blocksize) == 2) {
+                        if (size > 0 && blocksize > 0) {
+                                known[nknown].size = size;
+                                known[nknown].blocksize = blocksize;
+                                nknown++;
+                        }
+                }
+        }
+        fclose(fp);
+}
+
+/* rewrites the file with every edge known; a failure only costs the next
+   run a calibration. The new file is renamed into place, so programs
+   starting at the same time never read half of it */
+static void save(void)
+{
+        char dir[4096], path[4096], tmp[4096 + 32];
+        if (!cache_path(dir, sizeof(dir), 1)
+            || !cache_path(path, sizeof(path), 0)) {
+                return;
+        }
+        mkdir(dir, 0700);
+        snprintf(tmp, sizeof(tmp), "%s.%ld", path, (long)getpid());
+        FILE *fp = fopen(tmp, "w");
+        if (fp == NULL) {
+                return;
+        }
+        fprintf(fp, "caches %zu %zu %zu\n", BlockTune_cache(1),
+                BlockTune_cache(2), BlockTune_cache(3));
+        for (int k = 0; k < nknown; k++) {
+                fprintf(fp, "%d %d\n", known[k].size, known[k].blocksize);
+        }
+        if (fclose(fp) != 0 || rename(tmp, path) != 0) {
+                remove(tmp);
+        }
+}
+
+struct rotation {
+        UArray2b_T source;
+        int size;
+};
+
+/* the 90 degree rotation ppmtrans does, on arrays of equal sides */
+static void rotate_cell(int col, int row, UArray2b_T array2b, void *elem,
+                        void *cl)
+{
+        struct rotation *rotation = cl;
+        int side = UArray2b_width(array2b);
+        memcpy(elem, UArray2b_at(rotation->source, row, side - 1 - col),
+               rotation->size);
+}
+
+static double seconds(void)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* the best time of a blocked rotation of side x side cells at edge */
+static double time_edge(int side, int size, int edge)
+{
+        UArray2b_T source = UArray2b_new(side, side, size, edge);
+        UArray2b_T destination = UArray2b_new(side, side, size, edge);
+        struct rotation rotation = { source, size };
+        double best = 0;
+        for (int run = 0; run < CALIBRATION_RUNS; run++) {
+                double start = seconds();
+                UArray2b_map(destination, rotate_cell, &rotation);
+                double elapsed = seconds() - start;
+                if (run == 0 || elapsed < best) {
+                        best = elapsed;
+                }
+        }
+        UArray2b_free(&source);
+        UArray2b_free(&destination);
+        return best;
+}
+
+/*
+ * times block sizes from MIN_BLOCK_BYTES up to the whole level 2 cache,
+ * doubling, and returns the fastest edge. Arrays too small to leave the
+ * level 2 cache would time nothing useful, so huge elements get the
+ * estimate
+ */
+static int calibrate(int size)
+{
+        int side = (int)sqrt((double)CALIBRATION_BYTES / size);
+        if (side < 64) {
+                return estimate(size);
+        }
+        size_t l2 = BlockTune_cache(2);
+        size_t largest = l2 > 0 ? l2 : (size_t)1 << 20;
+        int best_edge = 0, last_edge = 0;
+        double best = 0;
+        for (size_t bytes = MIN_BLOCK_BYTES; bytes <= largest; bytes *= 2) {
+                int edge = edge_for(bytes, size);
+                if (edge == last_edge || edge > side) {
+                        continue;
+                }
+                last_edge = edge;
+                double elapsed = time_edge(side, size, edge);
+                if (best_edge == 0 || elapsed < best) {
+                        best = elapsed;
+                        best_edge = edge;
+                }
+        }
+        return best_edge > 0 ? best_edge : estimate(size);
+}
+
+int BlockTune_blocksize(int size)
+{
+        assert(size > 0);
+        if (!loaded) {
+                load();
+        }
+        for (int k = 0; k < nknown; k++) {
+                if (known[k].size == size) {
+                        return known[k].blocksize;
+                }
+        }
+        if (!calibrating || nknown == MAX_SIZES) {
+                return estimate(size);
+        }
+        int blocksize = calibrate(size);
+        known[nknown].size = size;
+        known[nknown].blocksize = blocksize;
+        nknown++;
+        save();
+        return blocksize;
+}
@@ -0,0 +1,49 @@
+#!/bin/sh
+#
+#     checkcost.sh
+#     arith
+#
+#     Measures what the asserts cost 40image: builds it with make debug and
+#     with make fast, then compresses one image and decompresses the result
+#     with both builds and prints the best of three wall times of each.
+#
+#     Usage: ./checkcost.sh image.ppm
+#
+#     The directory is rebuilt twice and is left with the fast build. MAKE
+#     overrides the make command, e.g. MAKE="make -e" to take CFLAGS and
+#     the rest from the environment.
+#
+
+if [ $# -ne 1 ]; then
+        echo "Usage: $0 image.ppm" >&2
+        exit 1
+fi
+image=$1
+make=${MAKE:-make}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+$make -s debug > /dev/null && cp 40image-6 "$dir/debug" || exit 1
+$make -s fast > /dev/null && cp 40image-6 "$dir/fast" || exit 1
+"$dir/fast" -c "$image" > "$dir/compressed" || exit 1
+
+# prints the best wall time in milliseconds of three runs of one build
+run() {
+        for k in 1 2 3; do
+                start=$(date +%s%N)
+                "$dir/$1" "$2" "$3" > /dev/null || exit 1
+                echo $((($(date +%s%N) - start) / 1000000))
+        done | sort -n | head -1
+}
+
+echo "            | debug ms | fast ms | debug/fast"
+for step in compress decompress; do
+        if [ $step = compress ]; then
+                set -- $(run debug -c "$image") $(run fast -c "$image")
+        else
+                set -- $(run debug -d "$dir/compressed") \
+                       $(run fast -d "$dir/compressed")
+        fi
+        printf "%-12s| %8d | %7d | %6.2f\n" $step "$1" "$2" \
+               "$(echo "$1 $2" | awk '{ print $1 / $2 }')"
+done
@@ -11,9 +11,28 @@
  */
 
 #include "componentIMG.h"
+#include "a2blocked.h"
 
 #define BLOCK_SIZE 2
 
+/* the closure of apply_rgb_to_cv_planes: the PPM, and a cursor that walks
+ * it in step with the planes when their blocks match the PPM's */
+struct rgb_source {
+    Pnm_ppm ppm;
+    bool lockstep;
+    A2Methods_Cursor cursor;
+};
+
+static inline void rgb_to_ypbpr(float r, float g, float b, cv_ypbpr out);
+static inline void ypbpr_to_rgb(float y, float pb, float pr, float_rgb out);
+static inline void scale_to_rgb(float_rgb in, unsigned denominator, 
+                                Pnm_rgb out);
+static void cv_to_rgb_lockstep(cv_img cv, Pnm_ppm ppm);
+static void apply_rgb_to_cv_planes(int col, int row, int width, int height, 
+                                   void **elems, int colstride, 
+                                   int rowstride, UArray2bPlanar_T planes, 
+                                   void *source);
+
 /******************************************************************************\
 *                   Compression: PPM to Component Video Image                  *
 \******************************************************************************/
@@ -38,6 +57,21 @@ cv_img ppm_to_cv(Pnm_ppm ppm, A2Methods_T methods)
     int width = ((ppm->width) % 2 == 0) ? ppm->width : ppm->width - 1;
     int height = ((ppm->height) % 2 == 0) ? ppm->height : ppm->height - 1;
     
+    /* suites that hand out whole runs of storage skip the float image */
+    if (methods->map_blocks != NULL) {
+        cv_img componentIMG = malloc(sizeof(struct cv_img));
+        assert(componentIMG != NULL);
+        componentIMG->methods = methods;
+        componentIMG->width = width;
+        componentIMG->height = height;
+        componentIMG->planes = NULL;
+        componentIMG->pixels = methods->new_with_blocksize(width, height, 
+                                           sizeof(struct cv_ypbpr), BLOCK_SIZE);
+        assert(componentIMG->pixels != NULL);
+        methods->map_blocks(componentIMG->pixels, apply_rgb_run_to_cv, ppm);
+        return componentIMG;
+    }
+    
     /* create a floating-point version of the ppm image */
     float_img floatIMG = malloc(sizeof(struct float_img));
     assert(floatIMG != NULL);
@@ -58,6 +92,7 @@ cv_img ppm_to_cv(Pnm_ppm ppm, A2Methods_T methods)
     componentIMG->methods = methods;
     componentIMG->width = width;
     componentIMG->height = height;
+    componentIMG->planes = NULL;
     
     /* create and populate the component video pixel map */
     componentIMG->pixels = methods->new_with_blocksize(width, height, 
@@ -161,20 +196,181 @@ cv_ypbpr floatpix_to_cvpix(float_rgb pixel)
 {
     assert(pixel != NULL);
     
-    float r = pixel->red;
-    float g = pixel->green;
-    float b = pixel->blue;
-    
     cv_ypbpr newPix = malloc(sizeof(struct cv_ypbpr));
     assert(newPix != NULL);
     
-    newPix->y = (0.299 * r) + (0.587 * g) + (0.114 * b);
-    newPix->pb = (-0.168736 * r) - (0.331264 * g) + (0.5 * b);
-    newPix->pr = (0.5 * r) - (0.418688 * g) - (0.081312 * b);
+    rgb_to_ypbpr(pixel->red, pixel->green, pixel->blue, newPix);
     
     return newPix;
 }
 
+/* rgb_to_ypbpr
+ *     Purpose:  stores the Y/PB/PR values of a floating-point RGB color in a
+ *               given component video pixel
+ *  Parameters:  r, g, b – the color's red, green and blue values in [0, 1]
+ *               out - the component video pixel to fill in
+ *     Returns:  nothing
+ * Error cases:  none
+ */
+static inline void rgb_to_ypbpr(float r, float g, float b, cv_ypbpr out)
+{
+    out->y = (0.299 * r) + (0.587 * g) + (0.114 * b);
+    out->pb = (-0.168736 * r) - (0.331264 * g) + (0.5 * b);
+    out->pr = (0.5 * r) - (0.418688 * g) - (0.081312 * b);
+}
+
+/* apply_rgb_run_to_cv
+ *     Purpose:  block apply function that fills a run of component video 
+ *               pixels straight from the matching PPM pixels, with no 
+ *               intermediary floating-point image and no per-pixel allocation
+ *  Parameters:  col, row – the column and row of the run's upper left pixel
+ *               width, height - the extent of the run in pixels
+ *               elems - a pointer to the run's upper left cv pixel
+ *               colstride, rowstride - bytes between neighbouring columns 
+ *               and rows of the run
+ *               component - the pixel map of the component video image
+ *               ppm - a pointer to the PPM image we're using the RGB data from
+ *     Returns:  nothing
+ * Error cases:  checked runtime error if the ppm or its methods are null, or
+ *               if the RGB data from a ppm pixel is greater than the 
+ *               denominator
+ */
+void apply_rgb_run_to_cv(int col, int row, int width, int height, 
+                         void *elems, int colstride, int rowstride, 
+                         A2Methods_UArray2 component, void *ppm)
+{
+    (void) component;
+    assert(ppm != NULL);
+    
+    Pnm_ppm copyPPM = (Pnm_ppm) ppm;
+    A2Methods_T methods = (A2Methods_T) copyPPM->methods;
+    assert(methods != NULL);
+    float denominator = (float)copyPPM->denominator;
+    
+    for (int j = 0; j < height; j++) {
+        char *cv = (char *)elems + j * rowstride;
+        for (int i = 0; i < width; i++) {
+            Pnm_rgb ppmPixel = methods->at(copyPPM->pixels, col + i, row + j);
+            assert(ppmPixel->red <= copyPPM->denominator);
+            assert(ppmPixel->green <= copyPPM->denominator);
+            assert(ppmPixel->blue <= copyPPM->denominator);
+            
+            rgb_to_ypbpr((float)ppmPixel->red / denominator, 
+                         (float)ppmPixel->green / denominator, 
+                         (float)ppmPixel->blue / denominator, 
+                         (cv_ypbpr)cv);
+            cv += colstride;
+        }
+    }
+}
+
+/* ppm_to_cv_planar
+ *     Purpose:  transforms a given PPM image to a planar component video
+ *               representation, with the Y, PB and PR values of the pixels
+ *               each in a plane of their own, so that later stages can work
+ *               on one channel at a time
+ *  Parameters:  ppm – the PPM image to transform, held by the blocked suite
+ *     Returns:  a struct containing the planar component video image
+ * Error cases:  checked runtime error if the given ppm is null or not held
+ *               by uarray2_methods_blocked, or if allocating memory fails
+ *       Notes:  the planes are blocked like the PPM, rounded down to an even
+ *               block size so that every 2x2 block of the DCT lies in one
+ *               block. When that leaves the PPM's block size as it was, a
+ *               cursor walks a view of the trimmed PPM in the planes' order
+ *               and no pixel is looked up by position
+ */
+cv_img ppm_to_cv_planar(Pnm_ppm ppm)
+{
+    assert(ppm != NULL);
+    A2Methods_T methods = (A2Methods_T) ppm->methods;
+    assert(methods == uarray2_methods_blocked);
+    
+    /* trim edges if needed */
+    int width = ((ppm->width) % 2 == 0) ? ppm->width : ppm->width - 1;
+    int height = ((ppm->height) % 2 == 0) ? ppm->height : ppm->height - 1;
+    int ppmBlocksize = methods->blocksize(ppm->pixels);
+    int blocksize = ppmBlocksize > 1 ? ppmBlocksize / 2 * 2 : BLOCK_SIZE;
+    
+    cv_img componentIMG = malloc(sizeof(struct cv_img));
+    assert(componentIMG != NULL);
+    componentIMG->methods = methods;
+    componentIMG->width = width;
+    componentIMG->height = height;
+    componentIMG->pixels = NULL;
+    componentIMG->planes = UArray2bPlanar_new(width, height, CV_PLANES, 
+                                              sizeof(float), blocksize);
+    
+    struct rgb_source source;
+    source.ppm = ppm;
+    A2Methods_UArray2 trimmed = methods->view(ppm->pixels, 0, 0, width, 
+                                              height);
+    source.lockstep = blocksize == ppmBlocksize 
+                      && methods->begin(trimmed, &source.cursor);
+    UArray2bPlanar_map_blocks(componentIMG->planes, apply_rgb_to_cv_planes, 
+                              &source);
+    methods->free(&trimmed);
+    return componentIMG;
+}
+
+/* apply_rgb_to_cv_planes
+ *     Purpose:  planar block apply function that fills one block of the Y, 
+ *               PB and PR planes from the matching PPM pixels, a column of 
+ *               the block at a time
+ *  Parameters:  col, row – the column and row of the block's upper left pixel
+ *               width, height - the extent of the block in pixels
+ *               elems - the block's upper left value in each plane
+ *               colstride, rowstride - bytes between neighbouring columns 
+ *               and rows of the block, the same in every plane
+ *               planes - the planes of the component video image
+ *               source - a pointer to the struct rgb_source to read from
+ *     Returns:  nothing
+ * Error cases:  checked runtime error if the cursor is not on the pixel the
+ *               block needs, or if the RGB data from a ppm pixel is greater
+ *               than the denominator
+ */
+static void apply_rgb_to_cv_planes(int col, int row, int width, int height, 
+                                   void **elems, int colstride, 
+                                   int rowstride, UArray2bPlanar_T planes, 
+                                   void *source)
+{
+    (void) planes;
+    (void) rowstride;
+    assert(rowstride == sizeof(float));
+    
+    struct rgb_source *copySource = source;
+    Pnm_ppm copyPPM = copySource->ppm;
+    A2Methods_T methods = (A2Methods_T) copyPPM->methods;
+    float denominator = (float)copyPPM->denominator;
+    struct cv_ypbpr cv;
+    
+    for (int i = 0; i < width; i++) {
+        float *y = (float *)((char *)elems[CV_Y] + i * colstride);
+        float *pb = (float *)((char *)elems[CV_PB] + i * colstride);
+        float *pr = (float *)((char *)elems[CV_PR] + i * colstride);
+        for (int j = 0; j < height; j++) {
+            Pnm_rgb ppmPixel;
+            if (copySource->lockstep) {
+                A2Methods_Cursor *cursor = &copySource->cursor;
+                assert(cursor->col == col + i && cursor->row == row + j);
+                ppmPixel = cursor->ptr;
+                A2Methods_next(cursor);
+            } else {
+                ppmPixel = methods->at(copyPPM->pixels, col + i, row + j);
+            }
+            assert(ppmPixel->red <= copyPPM->denominator);
+            assert(ppmPixel->green <= copyPPM->denominator);
+            assert(ppmPixel->blue <= copyPPM->denominator);
+            
+            rgb_to_ypbpr((float)ppmPixel->red / denominator, 
+                         (float)ppmPixel->green / denominator, 
+                         (float)ppmPixel->blue / denominator, &cv);
+            y[j] = cv.y;
+            pb[j] = cv.pb;
+            pr[j] = cv.pr;
+        }
+    }
+}
+
 /******************************************************************************\
 *                 Decompression: Component Video to PPM Image                  *
 \******************************************************************************/
@@ -193,8 +389,29 @@ cv_ypbpr floatpix_to_cvpix(float_rgb pixel)
 Pnm_ppm cv_to_ppm(cv_img cv, A2Methods_T methods)
 {
     assert(cv != NULL);
+    assert(cv->planes == NULL);
     assert(methods != NULL);
 
+    /* suites with cursors walk the cv and PPM pixels side by side and skip
+     * the float image, as long as both maps get the same block size */
+    if (methods->begin != NULL && cv->methods == methods) {
+        Pnm_ppm ppm = malloc(sizeof(struct Pnm_ppm));
+        assert(ppm != NULL);
+        ppm->height = cv->height;
+        ppm->width = cv->width;
+        ppm->denominator = 255;
+        ppm->methods = methods;
+        ppm->pixels = methods->new_with_blocksize(cv->width, cv->height, 
+                                            sizeof(struct Pnm_rgb), BLOCK_SIZE);
+        assert(ppm->pixels != NULL);
+        if (methods->blocksize(ppm->pixels) == methods->blocksize(cv->pixels)) {
+            cv_to_rgb_lockstep(cv, ppm);
+            return ppm;
+        }
+        methods->free(&ppm->pixels);
+        free(ppm);
+    }
+
     /* component video to floating-point transformation */
     float_img floatIMG = malloc(sizeof(struct float_img));
     assert(floatIMG != NULL);
@@ -285,6 +502,7 @@ void apply_cv_to_float(int col, int row, A2Methods_UArray2 floatIMG,
 void apply_float_to_rgb(int col, int row, A2Methods_UArray2 ppm, void *pixel, 
                         void *floatIMG)
 {
+    (void) ppm;
     assert(floatIMG != NULL);
     assert(ppm != NULL);
     assert(pixel != NULL);
@@ -298,17 +516,60 @@ void apply_float_to_rgb(int col, int row, A2Methods_UArray2 ppm, void *pixel,
     float_rgb floatPixel = methods->at(pixels, col, row);
     assert(floatPixel != NULL);
     
-    unsigned r = floatPixel->red * copyFloat->denominator;
-    unsigned g = floatPixel->green * copyFloat->denominator;
-    unsigned b = floatPixel->blue * copyFloat->denominator;
+    scale_to_rgb(floatPixel, copyFloat->denominator, pixel);
+}
 
-    assert(r <= (unsigned)copyFloat->denominator);
-    assert(g <= (unsigned)copyFloat->denominator);
-    assert(b <= (unsigned)copyFloat->denominator);
+/* scale_to_rgb
+ *     Purpose:  stores the RGB values of a floating-point pixel, scaled up
+ *               to a denominator, in a given PPM pixel
+ *  Parameters:  in – the floating-point pixel, with values in [0, 1]
+ *               denominator - the PPM's denominator
+ *               out - the PPM pixel to fill in
+ *     Returns:  nothing
+ * Error cases:  checked runtime error if a scaled value is greater than the
+ *               denominator
+ */
+static inline void scale_to_rgb(float_rgb in, unsigned denominator, 
+                                Pnm_rgb out)
+{
+    unsigned r = in->red * denominator;
+    unsigned g = in->green * denominator;
+    unsigned b = in->blue * denominator;
+
+    assert(r <= denominator);
+    assert(g <= denominator);
+    assert(b <= denominator);
     
-    ((Pnm_rgb)pixel)->red = r;
-    ((Pnm_rgb)pixel)->green = g;
-    ((Pnm_rgb)pixel)->blue = b;
+    out->red = r;
+    out->green = g;
+    out->blue = b;
+}
+
+/* cv_to_rgb_lockstep
+ *     Purpose:  fills the pixels of a PPM from the matching pixels of a
+ *               component video image, stepping a cursor through each map
+ *               in the same order, so no pixel is looked up by position
+ *  Parameters:  cv – the component video image to read
+ *               ppm - the PPM image to fill, of the same suite, size and
+ *               block size as cv
+ *     Returns:  nothing
+ * Error cases:  checked runtime error if the two cursors ever disagree on
+ *               the pixel they stand on
+ */
+static void cv_to_rgb_lockstep(cv_img cv, Pnm_ppm ppm)
+{
+    A2Methods_T methods = (A2Methods_T) ppm->methods;
+    A2Methods_Cursor from, to;
+    struct float_rgb rgb;
+    
+    for (int more = methods->begin(cv->pixels, &from) 
+                    && methods->begin(ppm->pixels, &to);
+         more; more = A2Methods_next(&from) && A2Methods_next(&to)) {
+        assert(from.col == to.col && from.row == to.row);
+        cv_ypbpr pix = from.ptr;
+        ypbpr_to_rgb(pix->y, pix->pb, pix->pr, &rgb);
+        scale_to_rgb(&rgb, ppm->denominator, to.ptr);
+    }
 }
 
 /* cvpix_to_floatpix
@@ -324,32 +585,41 @@ float_rgb cvpix_to_floatpix(cv_ypbpr pixel)
 {
     assert(pixel != NULL);
     
-    float y = pixel->y;
-    float pb = pixel->pb;
-    float pr = pixel->pr;
-        
     float_rgb pix = malloc(sizeof(struct float_rgb));
     assert(pix != NULL);
     
-    pix->red = (1.0 * y) + (0.0 * pb) + (1.402 * pr);
-    pix->red = (pix->red < 0) ? 0 : ((pix->red > 1) ? 1 : pix->red);
-
-    pix->green = (1.0 * y) - (0.344136 * pb) - (0.714136 * pr);
-    pix->green = (pix->green < 0) ? 0 : ((pix->green > 1) ? 1 : pix->green);
-
-    pix->blue = (1.0 * y) + (1.772 * pb) + (0.0 * pr);
-    pix->blue = (pix->blue < 0) ? 0 : ((pix->blue > 1) ? 1 : pix->blue);
+    ypbpr_to_rgb(pixel->y, pixel->pb, pixel->pr, pix);
     
     return pix;
 }
 
+/* ypbpr_to_rgb
+ *     Purpose:  stores the floating-point RGB values of a Y/PB/PR color in a
+ *               given floating-point pixel, clamped to [0, 1]
+ *  Parameters:  y, pb, pr – the color's component video values
+ *               out - the floating-point pixel to fill in
+ *     Returns:  nothing
+ * Error cases:  none
+ */
+static inline void ypbpr_to_rgb(float y, float pb, float pr, float_rgb out)
+{
+    out->red = (1.0 * y) + (0.0 * pb) + (1.402 * pr);
+    out->red = (out->red < 0) ? 0 : ((out->red > 1) ? 1 : out->red);
+
+    out->green = (1.0 * y) - (0.344136 * pb) - (0.714136 * pr);
+    out->green = (out->green < 0) ? 0 : ((out->green > 1) ? 1 : out->green);
+
+    out->blue = (1.0 * y) + (1.772 * pb) + (0.0 * pr);
+    out->blue = (out->blue < 0) ? 0 : ((out->blue > 1) ? 1 : out->blue);
+}
+
 /******************************************************************************\
 *                     Memory Deallocation: Free Functions                      *
 \******************************************************************************/
 
 /* cv_imgfree
  *     Purpose:  clears and deallocates memory from a given component video
- *               image - including the pixel map within the struct itself
+ *               image - including the pixel map or planes within the struct
  *  Parameters:  a struct containing the component video image and its data
  *     Returns:  nothing
  * Error cases:  checked runtime error if the given cv image is null
@@ -357,6 +627,10 @@ float_rgb cvpix_to_floatpix(cv_ypbpr pixel)
 void cv_imgfree(cv_img *cv)
 {
     assert(cv != NULL);
+    if ((*cv)->planes != NULL) {
+        UArray2bPlanar_free(&(*cv)->planes);
+        return;
+    }
     assert((*cv)->pixels != NULL);
     (*cv)->methods->free(&(*cv)->pixels);
 }
@@ -17,10 +17,11 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include "a2methods.h"
+#include "uarray2bplanar.h"
 #include <pnm.h>
 #include <assert.h>
 #include "except.h"
-#include "a2methods.h"
 
 /* cv_img
  * Struct containing all information associated with a component video image:
@@ -28,14 +29,22 @@
  * blocked array with element type 'struct cv_ypbpr'. Methods suite is used 
  * to operate on the 'pixels' field.
  *
+ * An image made by ppm_to_cv_planar has no pixel map; 'planes' holds its Y,
+ * PB and PR values in three planes of floats instead, and is NULL for every
+ * other image. Only cv_to_quantized and cv_imgfree take planar images.
+ *
  * Based on the struct Pmn_ppm from pnm.h.
  */
 typedef struct cv_img {
         unsigned width, height;
         A2Methods_UArray2 pixels;
         const struct A2Methods_T *methods; 
+        UArray2bPlanar_T planes;
 } *cv_img;
 
+/* the planes of a planar cv_img */
+enum { CV_Y, CV_PB, CV_PR, CV_PLANES };
+
 /* cv_ypbpr
  * Struct containing the Y/PB/PR data of a component video pixel.
  * Based on the struct Pmn_rgb from pnm.h.
@@ -89,6 +98,20 @@ void apply_rgb_to_float(int col, int row, A2Methods_UArray2 floatIMG,
 void apply_float_to_cv(int col, int row, A2Methods_UArray2 component, 
                        void *pixel, void *floatIMG);
 
+/* 
+ * to be called with a run mapping function (map_blocks) - called on an empty
+ * cv_img, fills a whole run of cv pixels from the Pnm_ppm passed in
+ */
+void apply_rgb_run_to_cv(int col, int row, int width, int height, 
+                         void *elems, int colstride, int rowstride, 
+                         A2Methods_UArray2 component, void *ppm);
+
+/* 
+ * takes in a pnm_ppm read with uarray2_methods_blocked and converts it to a
+ * planar cv_img that gets returned
+ */
+cv_img ppm_to_cv_planar(Pnm_ppm ppm);
+
 /* takes in single floating-point rbg pixel and turns it into a cv pixel */
 cv_ypbpr floatpix_to_cvpix(float_rgb pixel);
 
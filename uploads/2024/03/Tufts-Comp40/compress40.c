@@ -12,18 +12,49 @@
  */
 
 #include <stdio.h>
+#include <sys/stat.h>
 #include "compress40.h"
 #include "assert.h"
 
-#include "pnm.h"
 #include "a2methods.h"
+#include "pnm.h"
 #include "a2plain.h"
 #include "a2blocked.h"
+#include "a2mapped.h"
 
 #include "componentIMG.h"
 #include "quantizedIMG.h"
 #include "compressedIMG.h"
 
+/*
+ * bytes of arrays per byte of input at the pipeline's peak: a raw PPM is 3
+ * bytes per pixel and a compressed image 1, while a Pnm_rgb and a component
+ * video pixel are 12 bytes each
+ */
+#define PPM_EXPANSION        8
+#define COMPRESSED_EXPANSION 24
+
+/* methods_for
+ *     Purpose:  picks the methods suite for the arrays of one image, using
+ *               the file-backed blocked suite when the arrays would not fit
+ *               comfortably in memory
+ *  Parameters:  the input file and the bytes of arrays per byte of input
+ *     Returns:  uarray2_methods_mapped for inputs whose arrays are estimated
+ *               to exceed a2mapped_threshold(), otherwise
+ *               uarray2_methods_blocked
+ *       Notes:  the estimate comes from the file's size, so input from a pipe
+ *               always gets the in-memory suite
+ */
+static A2Methods_T methods_for(FILE *input, size_t expansion)
+{
+    struct stat info;
+    if (fstat(fileno(input), &info) == 0 && S_ISREG(info.st_mode)
+        && (size_t)info.st_size * expansion > a2mapped_threshold()) {
+        return uarray2_methods_mapped;
+    }
+    return uarray2_methods_blocked;
+}
+
 /* compress40
  *     Purpose:  transforms a given PPM image to a compressed image, printing 
  *               the result to standard output
@@ -33,15 +64,18 @@
  */
 void compress40(FILE *input)
 {
-    /* set methods to the UArray2b methods suite so we can use blocked arrays*/
-    A2Methods_T methods = uarray2_methods_blocked;
+    /* use blocked arrays, kept in a scratch file if the image is huge */
+    A2Methods_T methods = methods_for(input, PPM_EXPANSION);
     assert(methods != NULL);
     
     /* read in the given file to a PPM */
     Pnm_ppm image = Pnm_ppmread(input, methods);
     
-    /* transform the PPM to a component video representation */
-    cv_img component_video = ppm_to_cv(image, methods);
+    /* transform the PPM to a component video representation, kept in 
+     * planes when the arrays are in memory */
+    cv_img component_video = methods == uarray2_methods_blocked 
+                             ? ppm_to_cv_planar(image) 
+                             : ppm_to_cv(image, methods);
     
     /* transform the component video image to a quantized representation */
     quantized_img quant = cv_to_quantized(component_video, methods);
@@ -77,7 +111,7 @@ void compress40(FILE *input)
 void decompress40(FILE *input)
 {
     
-    A2Methods_T methods = uarray2_methods_blocked;
+    A2Methods_T methods = methods_for(input, COMPRESSED_EXPANSION);
     assert(methods != NULL);
     
     /* read in the compressed image from the user */
@@ -112,6 +112,30 @@ uint64_t quantizedpix_to_compressedpix(quantized_pix pixel)
     return word;
 }
 
+/* map_codewords
+ *     Purpose:  visits the codewords of a compressed image in file order, 
+ *               column by column, whatever order the methods suite stores 
+ *               them in, so every suite reads and writes the same files
+ *  Parameters:  methods - the methods suite of the pixel map
+ *               pixels - the pixel map of the compressed image
+ *               apply - function called with each codeword's position and 
+ *                       a pointer to it
+ *               cl - the closure passed to apply
+ *     Returns:  nothing
+ */
+static void map_codewords(const struct A2Methods_T *methods, 
+                          A2Methods_UArray2 pixels, 
+                          A2Methods_applyfun apply, void *cl)
+{
+    int width = methods->width(pixels);
+    int height = methods->height(pixels);
+    for (int col = 0; col < width; col++) {
+        for (int row = 0; row < height; row++) {
+            apply(col, row, pixels, methods->at(pixels, col, row), cl);
+        }
+    }
+}
+
 /* compressed_write
  *     Purpose:  writes a given compressed image to standard output
  *  Parameters:  image – a struct containing a compressed image and its data
@@ -129,7 +153,7 @@ void compressed_write(compressed_img image)
      
      printf("COMP40 Compressed image format 2\n%u %u\n", og_width, og_height);
                                              
-     image->methods->map_block_major(image->pixels, apply_write, NULL);
+     map_codewords(image->methods, image->pixels, apply_write, NULL);
 }
 
 /* apply_write
@@ -181,6 +205,7 @@ compressed_img compressed_read(FILE *input, A2Methods_T methods)
     assert(read == 2);
     int c = getc(input);
     assert(c == '\n');
+    (void) read, (void) c;
     assert(width != 0 && height != 0);
     
     /* create a compressed image, populate the struct with relevant data */
@@ -194,7 +219,7 @@ compressed_img compressed_read(FILE *input, A2Methods_T methods)
     compressedIMG->pixels = methods->new_with_blocksize(compressedIMG->width, 
                             compressedIMG->height, sizeof(uint64_t), 1);
     assert(compressedIMG->pixels != NULL);
-    methods->map_block_major(compressedIMG->pixels, apply_read, input);
+    map_codewords(methods, compressedIMG->pixels, apply_read, input);
        
     return compressedIMG;
 }
@@ -212,7 +237,7 @@ compressed_img compressed_read(FILE *input, A2Methods_T methods)
 void apply_read(int col, int row, A2Methods_UArray2 compressed, void *pixel, 
                 void *input)
 {
-    (void) row, (void) col;
+    (void) row, (void) col, (void) compressed;
     assert(compressed != NULL);
     assert(input != NULL);
     assert(pixel != NULL);
@@ -16,6 +16,7 @@
  
 #include <stdlib.h>
 #include <stdio.h>
+#include "a2methods.h"
 #include <pnm.h>
 #include <assert.h>
 
@@ -6,8 +6,8 @@
 #include <math.h>
 
 #include "assert.h"
-#include "pnm.h"
 #include "a2methods.h"
+#include "pnm.h"
 #include "a2plain.h"
 
 double computeE(int height, int width, Pnm_ppm image1, Pnm_ppm image2);
@@ -25,6 +25,7 @@ double computeE(int height, int width, Pnm_ppm image1, Pnm_ppm image2);
 int main(int argc, char *argv[])
 {
     assert(argc == 3);
+    (void) argc;
     FILE *file_p1, *file_p2;
     bool stdinProvided = false;
 
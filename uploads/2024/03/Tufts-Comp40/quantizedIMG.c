@@ -16,6 +16,9 @@
 
 #define BLOCK_SIZE 2
 
+static inline void average_block(cv_ypbpr pix1, cv_ypbpr pix2, cv_ypbpr pix3,
+                                 cv_ypbpr pix4, blocked_pix out);
+
 /*****************************************************************************\
 *            Compression: Component Video Image to Quantized Image            *
 \*****************************************************************************/
@@ -60,8 +63,19 @@ quantized_img cv_to_quantized(cv_img cv, A2Methods_T methods)
     closure->pixels = blockIMG->pixels;
     closure->methods = methods;
     
-    /* populate the blocked pixel map */
-    methods->map_block_major(cv->pixels, apply_cv_to_blocked, closure);
+    /* populate the blocked pixel map; when every run of the cv image holds
+    whole 2x2 blocks, each run is averaged in place without the sequence,
+    and a planar image is averaged one channel at a time */
+    const struct A2Methods_T *cvMethods = cv->methods;
+    if (cv->planes != NULL) {
+        UArray2bPlanar_map_blocks(cv->planes, apply_cv_planes_to_blocked, 
+                                  closure);
+    } else if (cvMethods->map_blocks != NULL 
+        && cvMethods->blocksize(cv->pixels) % 2 == 0) {
+        cvMethods->map_blocks(cv->pixels, apply_cv_run_to_blocked, closure);
+    } else {
+        methods->map_block_major(cv->pixels, apply_cv_to_blocked, closure);
+    }
     
     
     /* create a quantized image to be populated with the blocked image */
@@ -113,6 +127,7 @@ quantized_img cv_to_quantized(cv_img cv, A2Methods_T methods)
 void apply_cv_to_blocked(int col, int row, A2Methods_UArray2 cv, void *pixel, 
                          void *passedIN)
 {
+    (void) cv;
     assert(cv != NULL);
     assert(pixel != NULL);
     assert(passedIN != NULL);
@@ -240,17 +255,160 @@ blocked_pix cvpix_to_blockedpix(Seq_T pixels)
     
     /* sets the created pixel's values based on the calculations done with 
     the cv pixels from the sequence */
-    newPix->a = (pix4->y + pix3->y + pix2->y + pix1->y) / 4.0;
-    newPix->b = (pix4->y + pix3->y - pix2->y - pix1->y) / 4.0;
-    newPix->c = (pix4->y - pix3->y + pix2->y - pix1->y) / 4.0;
-    newPix->d = (pix4->y - pix3->y - pix2->y + pix1->y) / 4.0;
-    newPix->pb = (pix1->pb + pix2->pb + pix3->pb + pix4->pb) / 4.0;
-    newPix->pr = (pix1->pr + pix2->pr + pix3->pr + pix4->pr) / 4.0;
+    average_block(pix1, pix2, pix3, pix4, newPix);
         
     return newPix;
 }
 
 
+/* average_block */
+/* Purpose:     Compression step. computes the blocked pixel values of one 2x2
+                block of cv pixels and stores them in the given blocked pixel */
+/* Parameters:  pix1, pix2 – the upper left and lower left cv pixels
+                pix3, pix4 – the upper right and lower right cv pixels
+                out – the blocked pixel to fill in */
+/* Return:      nothing */
+/* Error Cases: none */
+static inline void average_block(cv_ypbpr pix1, cv_ypbpr pix2, cv_ypbpr pix3,
+                                 cv_ypbpr pix4, blocked_pix out)
+{
+    out->a = (pix4->y + pix3->y + pix2->y + pix1->y) / 4.0;
+    out->b = (pix4->y + pix3->y - pix2->y - pix1->y) / 4.0;
+    out->c = (pix4->y - pix3->y + pix2->y - pix1->y) / 4.0;
+    out->d = (pix4->y - pix3->y - pix2->y + pix1->y) / 4.0;
+    out->pb = (pix1->pb + pix2->pb + pix3->pb + pix4->pb) / 4.0;
+    out->pr = (pix1->pr + pix2->pr + pix3->pr + pix4->pr) / 4.0;
+}
+
+
+/* apply_cv_run_to_blocked */
+/* Purpose:     Compression step to be run with a run mapping function 
+                (map_blocks). walks a run of cv pixels 2x2 block by 2x2 block
+                and stores each block's blocked pixel in the blocked image */
+/* Parameters:  col, row – the column and row of the run's upper left pixel,
+                        both even
+                width, height – the extent of the run, both even
+                elems – a pointer to the run's upper left cv pixel
+                colstride, rowstride – bytes between neighbouring columns and
+                        rows of the run
+                cv – a A2Methods_UArray2 that contains the cv pixels
+                passedIN – a pointer to a struct containing the blocked pixel 
+                array to populate and the methods suite */
+/* Return:      nothing */
+/* Error Cases: checked runtime error if the struct passed in, its methods
+                suite or its pixels are null, or if the run does not start on
+                a 2x2 block boundary */
+void apply_cv_run_to_blocked(int col, int row, int width, int height, 
+                             void *elems, int colstride, int rowstride, 
+                             A2Methods_UArray2 cv, void *passedIN)
+{
+    (void) cv;
+    assert(passedIN != NULL);
+    assert(col % 2 == 0 && row % 2 == 0);
+    assert(width % 2 == 0 && height % 2 == 0);
+
+    passIN copyPASS = (passIN)passedIN;
+    A2Methods_T methods = (A2Methods_T) copyPASS->methods;
+    assert(methods != NULL);
+    assert(copyPASS->pixels != NULL);
+    
+    char *base = elems;
+    for (int j = 0; j < height; j += 2) {
+        for (int i = 0; i < width; i += 2) {
+            char *pix1 = base + i * colstride + j * rowstride;
+            char *pix3 = pix1 + colstride;
+            average_block((cv_ypbpr)pix1, (cv_ypbpr)(pix1 + rowstride),
+                          (cv_ypbpr)pix3, (cv_ypbpr)(pix3 + rowstride),
+                          methods->at(copyPASS->pixels, (col + i) / 2, 
+                                      (row + j) / 2));
+        }
+    }
+}
+
+
+/* apply_cv_planes_to_blocked */
+/* Purpose:     Compression step to be run with UArray2bPlanar_map_blocks. 
+                averages a block of the Y, PB and PR planes 2x2 block by 2x2 
+                block, one pair of columns at a time, and stores each 2x2 
+                block's blocked pixel in the blocked image */
+/* Parameters:  col, row – the column and row of the block's upper left 
+                        pixel, both even
+                width, height – the extent of the block, both even
+                elems – the block's upper left value in each plane
+                colstride, rowstride – bytes between neighbouring columns and
+                        rows of the block, the same in every plane
+                planes – the planes of the cv image
+                passedIN – a pointer to a struct containing the blocked pixel 
+                array to populate and the methods suite */
+/* Return:      nothing */
+/* Error Cases: checked runtime error if the struct passed in, its methods
+                suite or its pixels are null, or if the block does not start
+                on a 2x2 block boundary */
+/* Notes:       each channel is worked out for the whole column pair before
+                the next, in loops over packed floats that the compiler can 
+                vectorize; the sums are the ones average_block does, in the 
+                same order, so the result is the same */
+void apply_cv_planes_to_blocked(int col, int row, int width, int height, 
+                                void **elems, int colstride, int rowstride, 
+                                UArray2bPlanar_T planes, void *passedIN)
+{
+    (void) planes;
+    (void) rowstride;
+    assert(passedIN != NULL);
+    assert(col % 2 == 0 && row % 2 == 0);
+    assert(width % 2 == 0 && height % 2 == 0);
+    assert(rowstride == sizeof(float));
+
+    passIN copyPASS = (passIN)passedIN;
+    A2Methods_T methods = (A2Methods_T) copyPASS->methods;
+    assert(methods != NULL);
+    assert(copyPASS->pixels != NULL);
+    
+    int half = height / 2;
+    float a[half], b[half], c[half], d[half], pb[half], pr[half];
+    for (int i = 0; i < width; i += 2) {
+        /* the left and right columns of the pair in each plane */
+        const float *y1 = (const float *)((char *)elems[CV_Y] 
+                                          + i * colstride);
+        const float *y3 = (const float *)((const char *)y1 + colstride);
+        const float *pb1 = (const float *)((char *)elems[CV_PB] 
+                                           + i * colstride);
+        const float *pb3 = (const float *)((const char *)pb1 + colstride);
+        const float *pr1 = (const float *)((char *)elems[CV_PR] 
+                                           + i * colstride);
+        const float *pr3 = (const float *)((const char *)pr1 + colstride);
+        
+        for (int k = 0; k < half; k++) {
+            float pix1 = y1[2 * k], pix2 = y1[2 * k + 1];
+            float pix3 = y3[2 * k], pix4 = y3[2 * k + 1];
+            a[k] = (pix4 + pix3 + pix2 + pix1) / 4.0;
+            b[k] = (pix4 + pix3 - pix2 - pix1) / 4.0;
+            c[k] = (pix4 - pix3 + pix2 - pix1) / 4.0;
+            d[k] = (pix4 - pix3 - pix2 + pix1) / 4.0;
+        }
+        for (int k = 0; k < half; k++) {
+            pb[k] = (pb1[2 * k] + pb1[2 * k + 1] + pb3[2 * k] 
+                     + pb3[2 * k + 1]) / 4.0;
+        }
+        for (int k = 0; k < half; k++) {
+            pr[k] = (pr1[2 * k] + pr1[2 * k + 1] + pr3[2 * k] 
+                     + pr3[2 * k + 1]) / 4.0;
+        }
+        
+        for (int k = 0; k < half; k++) {
+            blocked_pix out = methods->at(copyPASS->pixels, (col + i) / 2, 
+                                          row / 2 + k);
+            out->a = a[k];
+            out->b = b[k];
+            out->c = c[k];
+            out->d = d[k];
+            out->pb = pb[k];
+            out->pr = pr[k];
+        }
+    }
+}
+
+
 /* blockedpix_to_quantpix */
 /* Purpose:     Compression step. takes a blocked pixel and converts it into a
                 quantized pixel that gets returned*/
@@ -330,6 +488,7 @@ cv_img quantized_to_cv(quantized_img quantized, A2Methods_T methods)
     componentIMG->methods = methods;
     componentIMG->width = width * 2;
     componentIMG->height = height * 2;
+    componentIMG->planes = NULL;
     componentIMG->pixels = methods->new_with_blocksize(width * 2, height * 2, 
                                         sizeof(struct cv_ypbpr), BLOCK_SIZE);
     assert(componentIMG->pixels != NULL);
@@ -370,6 +529,7 @@ cv_img quantized_to_cv(quantized_img quantized, A2Methods_T methods)
 void apply_blocked_to_cv(int col, int row, A2Methods_UArray2 blocked, 
                                             void *pixel, void *componentIMG)
 {
+    (void) blocked;
     assert(blocked != NULL);
     assert(componentIMG != NULL);
     
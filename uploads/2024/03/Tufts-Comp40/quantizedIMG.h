@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <a2methods.h>
 #include <pnm.h>
 #include <assert.h>
 #include <seq.h>
@@ -28,7 +29,6 @@
 
 #include "except.h"
 #include "componentIMG.h"
-#include <a2methods.h>
 
 /* blocked_img
 * Struct containing all information associated with a blocked image: width,
@@ -104,6 +104,18 @@ gets populated using the cv_image passed in*/
 void apply_cv_to_blocked(int col, int row, A2Methods_UArray2 component, 
                                                 void *pixel, void *floatIMG);
 
+/*  to be called with a run mapping function (map_blocks). called on runs of
+the cv_img whose extents are even; populates the blocked_img passed in*/
+void apply_cv_run_to_blocked(int col, int row, int width, int height, 
+                             void *elems, int colstride, int rowstride, 
+                             A2Methods_UArray2 cv, void *passedIN);
+
+/*  to be called with UArray2bPlanar_map_blocks. called on blocks of the 
+planes of a planar cv_img; populates the blocked_img passed in*/
+void apply_cv_planes_to_blocked(int col, int row, int width, int height, 
+                                void **elems, int colstride, int rowstride, 
+                                UArray2bPlanar_T planes, void *passedIN);
+
 /* to be called with a mapping function. called on an empty pnm_ppm that gets 
 populated using the cv_img passed in*/
 void apply_blocked_to_quantized(int col, int row, A2Methods_UArray2 quant, 
@@ -1,120 +1,318 @@
-#line 50 "www/solutions/uarray2.nw"
+#include <stdlib.h>
+#include <string.h>
 #include "assert.h"
 #include "mem.h"
-#include "uarray.h"
 #include "uarray2.h"
-
-#include <stdlib.h>
+#include "bigalloc.h"
 #include <stdio.h>
 
+
 #define T UArray2_T
 
-/* 
+/* rows start on cache-line boundaries of the buffer */
+#define CACHE_LINE 64
+
+/*
+ * a row stride that is a multiple of this many bytes sends every row of a
+ * column to the same handful of cache sets, so such strides get one extra
+ * cache line of padding
+ */
+#define ALIAS_SPAN 512
+
+/*
+ * map_recursive stops splitting at tiles of at most this many cells on a
+ * side. Any small size gives the same locality; this one just keeps the
+ * cost of the recursion out of sight
+ */
+#define RECURSIVE_TILE 8
+
+/* rows column walks look ahead by default; see UArray2_prefetch */
+#define PREFETCH_ROWS 2
+
+/*
+ * column walks ask for the cell this many rows ahead, so its cache line is
+ * on its way before the walk reaches it. Set by UArray2_prefetch; 0 is off
+ */
+static int prefetch_rows = PREFETCH_ROWS;
+
+/*
  * Element (i, j) in the world of ideas maps to
- * rows[j][i] where the square brackets stand for access
- * to a Hanson UArray_T
+ * elems[j * stride + i * size] in a single flat buffer.
+ * Bytes between width * size and stride are padding.
  */
 struct T {
         int width, height;
         int size;
-        UArray_T rows; /* UArray_T of 'height' UArray_Ts,
-                          each of length 'width' and size 'size' */
+        size_t stride;  /* bytes from the start of one row to the next */
+        char *elems;    /* height rows of stride bytes each */
+        int owner;      /* 0 for a view into another array's rows */
 };
-#line 79 "www/solutions/uarray2.nw"
-static inline UArray_T row(T a, int j)
+
+static inline char *row(T a, int j)
 {
-        UArray_T *prow = UArray_at(a->rows, j);   /* Ramsey idiom */
-        return *prow;
+        return a->elems + (size_t)j * a->stride;
 }
-#line 92 "www/solutions/uarray2.nw"
-static int is_ok(T a)
+
+static inline int is_ok(T a)
 {
-        return a && UArray_length(a->rows) == a->height &&
-               UArray_size(a->rows) == sizeof(UArray_T) &&
-               (a->height == 0 || (UArray_length(row(a, 0)) == a->width
-                                   && UArray_size  (row(a, 0)) == a->size));
+        return a && a->width >= 0 && a->height >= 0 && a->size > 0 &&
+               a->stride >= (size_t)a->width * a->size &&
+               (a->elems != NULL || (size_t)a->height * a->stride == 0);
 }
-#line 109 "www/solutions/uarray2.nw"
+
+static size_t padded_stride(int width, int size)
+{
+        size_t stride = (size_t)width * size;
+        if (stride >= ALIAS_SPAN && stride % ALIAS_SPAN == 0)
+                stride += CACHE_LINE;
+        return stride;
+}
+
 T UArray2_new(int width, int height, int size)
 {
-        int i;  /* interates over row number */
         T array;
+        assert(width >= 0 && height >= 0 && size > 0);
         NEW(array);
         array->width  = width;
         array->height = height;
         array->size   = size;
-        array->rows   = UArray_new(height, sizeof(UArray_T));
-        for (i = 0; i < height; i++) {
-                UArray_T *rowp = UArray_at(array->rows, i);
-                *rowp = UArray_new(width, size);
-        }
+        array->stride = padded_stride(width, size);
+        array->elems  = NULL;
+        array->owner  = 1;
+
+        /* zeroed, cache-line aligned, and on huge pages when asked for */
+        size_t nbytes = (size_t)height * array->stride;
+        if (nbytes > 0)
+                array->elems = BigAlloc_new(nbytes);
         assert(is_ok(array));
         return array;
 }
-#line 131 "www/solutions/uarray2.nw"
+
 void UArray2_free(T *array2)
 {
-        int i;
-        assert(array2 && *array2);
-        for (i = 0; i < (*array2)->height; i++) {
-                UArray_T p = row(*array2, i);
-                UArray_free(&p);
-        }
-        UArray_free(&(*array2)->rows);
+        assert(array2 != NULL && *array2 != NULL);
+        if ((*array2)->owner)
+                BigAlloc_free((*array2)->elems,
+                              (size_t)(*array2)->height * (*array2)->stride);
         FREE(*array2);
 }
-#line 151 "www/solutions/uarray2.nw"
+
+T UArray2_view(T array2, int i, int j, int width, int height)
+{
+        assert(array2 != NULL);
+        assert(i >= 0 && j >= 0 && width >= 0 && height >= 0);
+        assert(i + width <= array2->width);
+        assert(j + height <= array2->height);
+        T view;
+        NEW(view);
+        *view = *array2;
+        view->width  = width;
+        view->height = height;
+        view->owner  = 0;
+        /* the rows keep their stride, so only the start moves */
+        if (array2->elems != NULL)
+                view->elems = row(array2, j) + (size_t)i * array2->size;
+        return view;
+}
+
 void *UArray2_at(T array2, int i, int j)
 {
-        assert(array2);
-        return UArray_at(row(array2, j), i);
+        assert(array2 != NULL);
+        assert(i >= 0 && i < array2->width);
+        assert(j >= 0 && j < array2->height);
+        return row(array2, j) + (size_t)i * array2->size;
 }
-#line 162 "www/solutions/uarray2.nw"
+
 int UArray2_height(T array2)
 {
-        assert(array2);
+        assert(array2 != NULL);
         return array2->height;
 }
 
 int UArray2_width(T array2)
 {
-        assert(array2);
+        assert(array2 != NULL);
         return array2->width;
 }
 
 int UArray2_size(T array2)
 {
-        assert(array2);
+        assert(array2 != NULL);
         return array2->size;
 }
-#line 193 "www/solutions/uarray2.nw"
-void UArray2_map_row_major(T array2, 
-                           void apply(int i, int j, T array2, 
-                                      void *elem, void *cl), 
+
+void UArray2_map_row_major(T array2,
+                           void apply(int i, int j, T array2,
+                                      void *elem, void *cl),
                            void *cl)
 {
+        assert(array2 != NULL);
+        UArray2_map_row_band(array2, 0, array2->height, apply, cl);
+}
 
-        assert(array2);
-        int h = array2->height;  /* keeping height and width in registers */
-        int w = array2->width;   /* avoids extra memory traffic           */
-        for (int j = 0; j < h; j++) {
-                /* don't want row/UArray_at in inner loop */
-                UArray_T thisrow = row(array2, j); 
-                for (int i = 0; i < w; i++)
-                        apply(i, j, array2, UArray_at(thisrow, i), cl);
+void UArray2_map_col_major(T array2,
+                           void apply(int i, int j, T array2,
+                                      void *elem, void *cl),
+                           void *cl)
+{
+        assert(array2 != NULL);
+        UArray2_map_col_band(array2, 0, array2->width, apply, cl);
+}
+
+/*
+ * The loops of the row-major and column-major maps, with VISIT the
+ * statement run for each cell in terms of i, j and elem. The full maps and
+ * the small maps expand the same loops, so a small map calls its client
+ * straight from the loop instead of through a full-map adapter
+ */
+#define ROW_BAND_LOOP(array2, row0, row1, VISIT)                             \
+        do {                                                                 \
+                int w = (array2)->width;   /* in registers, not memory */    \
+                int size = (array2)->size;                                   \
+                for (int j = (row0); j < (row1); j++) {                      \
+                        char *elem = row((array2), j);                       \
+                        for (int i = 0; i < w; i++) {                        \
+                                VISIT;                                       \
+                                elem += size;                                \
+                        }                                                    \
+                }                                                            \
+        } while (0)
+
+/* a prefetch past the end of the rows is harmless */
+#define COL_BAND_LOOP(array2, col0, col1, VISIT)                             \
+        do {                                                                 \
+                int h = (array2)->height;                                    \
+                size_t stride = (array2)->stride;                            \
+                size_t ahead = (size_t)prefetch_rows * stride;               \
+                for (int i = (col0); i < (col1); i++) {                      \
+                        char *elem = (array2)->elems                         \
+                                     + (size_t)i * (array2)->size;           \
+                        if (ahead == 0) {                                    \
+                                for (int j = 0; j < h; j++) {                \
+                                        VISIT;                               \
+                                        elem += stride;                      \
+                                }                                            \
+                                continue;                                    \
+                        }                                                    \
+                        for (int j = 0; j < h; j++) {                        \
+                                __builtin_prefetch(elem + ahead, 1);         \
+                                VISIT;                                       \
+                                elem += stride;                              \
+                        }                                                    \
+                }                                                            \
+        } while (0)
+
+void UArray2_map_row_band(T array2, int row0, int row1,
+                          void apply(int i, int j, T array2,
+                                     void *elem, void *cl),
+                          void *cl)
+{
+        assert(array2 != NULL);
+        assert(0 <= row0 && row0 <= row1 && row1 <= array2->height);
+        ROW_BAND_LOOP(array2, row0, row1, apply(i, j, array2, elem, cl));
+}
+
+void UArray2_map_col_band(T array2, int col0, int col1,
+                          void apply(int i, int j, T array2,
+                                     void *elem, void *cl),
+                          void *cl)
+{
+        assert(array2 != NULL);
+        assert(0 <= col0 && col0 <= col1 && col1 <= array2->width);
+        COL_BAND_LOOP(array2, col0, col1, apply(i, j, array2, elem, cl));
+}
+
+void UArray2_small_map_row_major(T array2,
+                                 void apply(void *elem, void *cl),
+                                 void *cl)
+{
+        assert(array2 != NULL);
+        ROW_BAND_LOOP(array2, 0, array2->height, apply(elem, cl));
+}
+
+void UArray2_small_map_col_major(T array2,
+                                 void apply(void *elem, void *cl),
+                                 void *cl)
+{
+        assert(array2 != NULL);
+        COL_BAND_LOOP(array2, 0, array2->width, apply(elem, cl));
+}
+
+#undef ROW_BAND_LOOP
+#undef COL_BAND_LOOP
+
+void UArray2_map_rows(T array2,
+                      void apply(int col, int row, int width, int height,
+                                 void *elems, int colstride, int rowstride,
+                                 T array2, void *cl),
+                      void *cl)
+{
+        assert(array2 != NULL);
+        int h = array2->height;
+        int w = array2->width;
+        if (w == 0)
+                return;
+        for (int j = 0; j < h; j++)
+                apply(0, j, w, 1, row(array2, j), array2->size,
+                      (int)array2->stride, array2, cl);
+}
+
+void *UArray2_row_run(T array2, int j, int *col, int *rowp, int *width,
+                      int *height, int *colstride, int *rowstride)
+{
+        assert(array2 != NULL);
+        assert(j >= 0 && j < array2->height);
+        *col = 0;
+        *rowp = j;
+        *width = array2->width;
+        *height = 1;
+        *colstride = array2->size;
+        *rowstride = (int)array2->stride;
+        return row(array2, j);
+}
+
+/*
+ * visits the w x h cells whose upper left is (i0, j0), splitting the
+ * longer side in half until the piece is a tile. Two splits turn a square
+ * into four quadrants visited in Z order, so at every scale the cells
+ * visited close together in time sit in a few rows and columns
+ */
+static void map_quadrant(T array2, int i0, int j0, int w, int h,
+                         void apply(int i, int j, T array2, void *elem,
+                                    void *cl),
+                         void *cl)
+{
+        if (w <= RECURSIVE_TILE && h <= RECURSIVE_TILE) {
+                int size = array2->size;
+                for (int j = j0; j < j0 + h; j++) {
+                        char *elem = row(array2, j) + (size_t)i0 * size;
+                        for (int i = i0; i < i0 + w; i++) {
+                                apply(i, j, array2, elem, cl);
+                                elem += size;
+                        }
+                }
+        } else if (w >= h) {
+                map_quadrant(array2, i0, j0, w / 2, h, apply, cl);
+                map_quadrant(array2, i0 + w / 2, j0, w - w / 2, h, apply, cl);
+        } else {
+                map_quadrant(array2, i0, j0, w, h / 2, apply, cl);
+                map_quadrant(array2, i0, j0 + h / 2, w, h - h / 2, apply, cl);
         }
 }
-#line 211 "www/solutions/uarray2.nw"
-void UArray2_map_col_major(T array2, 
-                           void apply(int i, int j, T array2, 
-                                      void *elem, void *cl), 
+
+void UArray2_map_recursive(T array2,
+                           void apply(int i, int j, T array2,
+                                      void *elem, void *cl),
                            void *cl)
 {
+        assert(array2 != NULL);
+        if (array2->width == 0 || array2->height == 0)
+                return;
+        map_quadrant(array2, 0, 0, array2->width, array2->height, apply, cl);
+}
 
-        assert(array2);
-        int h = array2->height;  /* keeping height and width in registers */
-        int w = array2->width;   /* avoids extra memory traffic           */
-        for (int i = 0; i < w; i++)
-                for (int j = 0; j < h; j++)
-                        apply(i, j, array2, UArray_at(row(array2, j), i), cl);
-}
\ No newline at end of file
+void UArray2_prefetch(int rows)
+{
+        assert(rows >= 0);
+        prefetch_rows = rows;
+}
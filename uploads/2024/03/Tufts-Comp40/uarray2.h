@@ -0,0 +1,72 @@
+/*
+ *     uarray2.h
+ *     by Rolando Ortega (rorteg02) Jason Singer (jsinge02), 2/11/2024
+ *     iii
+ *
+ *     A two dimensional unboxed array has the ability to store data using the 
+ *     index (column, row). Clients can create a new UArray2 that has the 
+ *     ability to get elements within the 2-D array, get the array's height, 
+ *     width, and element size, and traverse elements in the array by rows and
+ *     column.  
+ */
+
+#ifndef UARRAY2_INCLUDED
+#define UARRAY2_INCLUDED
+
+#define T UArray2_T
+typedef struct T *T;
+
+typedef void UArray2_applyfun(int i, int j, UArray2_T a, void *p1, void *p2);
+ 
+void *UArray2_at(UArray2_T a, int col, int row);
+int UArray2_height(UArray2_T a);
+int UArray2_width(UArray2_T a);
+int UArray2_size(UArray2_T a);
+UArray2_T UArray2_new(int DIM1, int DIM2, int ELEMENT_SIZE);
+void UArray2_map_col_major(UArray2_T a, void apply(int i, int j, UArray2_T a, 
+        void *p1, void *p2), void *cl);
+void UArray2_map_row_major(UArray2_T a, void apply(int i, int j, UArray2_T a, 
+        void *p1, void *p2), void *c);
+void UArray2_free(UArray2_T *a);
+
+/* row-major over rows [row0, row1), col-major over columns [col0, col1);
+   disjoint bands can be mapped by different threads at the same time */
+void UArray2_map_row_band(UArray2_T a, int row0, int row1, void apply(int i,
+        int j, UArray2_T a, void *p1, void *p2), void *cl);
+void UArray2_map_col_band(UArray2_T a, int col0, int col1, void apply(int i,
+        int j, UArray2_T a, void *p1, void *p2), void *cl);
+
+/* the row-major and column-major maps for clients that need only the
+   element: the same order, with apply called straight from the loop */
+void UArray2_small_map_row_major(UArray2_T a, void apply(void *elem,
+        void *cl), void *cl);
+void UArray2_small_map_col_major(UArray2_T a, void apply(void *elem,
+        void *cl), void *cl);
+
+/* calls apply once per row with a pointer to the row's first cell; the run
+   is width x 1 cells, colstride is the element size */
+void UArray2_map_rows(UArray2_T a, void apply(int col, int row, int width,
+        int height, void *elems, int colstride, int rowstride, UArray2_T a,
+        void *cl), void *cl);
+
+/* what UArray2_map_rows passes for row j: returns the pointer and stores
+   the rest */
+void *UArray2_row_run(UArray2_T a, int j, int *col, int *row, int *width,
+        int *height, int *colstride, int *rowstride);
+
+/* visits every cell once in a cache-oblivious order: the array is split
+   into quadrants, recursively, down to tiles of a few cells on a side that
+   are visited row by row */
+void UArray2_map_recursive(UArray2_T a, void apply(int i, int j, UArray2_T a,
+        void *p1, void *p2), void *cl);
+
+/* column-major maps prefetch the cell rows ahead of the one they visit;
+   0 turns prefetching off. The setting is program-wide */
+void UArray2_prefetch(int rows);
+
+/* a width x height window whose (0, 0) is (col, row) of a, sharing a's
+   storage; freeing it leaves a alone */
+UArray2_T UArray2_view(UArray2_T a, int col, int row, int width, int height);
+
+#undef T
+#endif
@@ -1,9 +1,8 @@
-#line 59 "www/solutions/uarray2b.nw"
 #include <math.h>
+#include <stdbool.h>
 #include "assert.h"
 #include "mem.h"
-#include "uarray.h"
-#include "uarray2.h"
+#include "bigalloc.h"
 #include "uarray2b.h"
 
 #define T UArray2b_T
@@ -12,25 +11,77 @@ struct T { /* represents a 2D array of cells each of size 'size' */
         int width, height;
         unsigned blocksize;
         unsigned size;
-        UArray2_T blocks;
+        int blocksWide, blocksHigh;
+        size_t blockBytes;
+        char *cells;
+        int col0, row0;
+        bool owner;
         /*
-         * matrix of blocks, each blocksize * blocksize 
+         * blocksWide * blocksHigh blocks, each blocksize * blocksize cells
+         * of 'size' bytes, back to back in a single buffer
          *
-         * matrix dimensions are width and height divided by blocksize,
-         * rounded up
+         * block (bx, by) is block number bx * blocksHigh + by, so blocks
+         * are stored in the order UArray2b_map visits them
          *
-         * a block is a Uarray_T of length blocksize * blocksize 
-         * and size 'size'
+         * cell (i, j) is cell (i % blocksize) * blocksize + j % blocksize
+         * of block (i / blocksize, j / blocksize): cells within a block
+         * are stored column by column
          *
-         * invariant relating cells in blocks to cells in the abstraction
-         *  described in section on coordinate transformations below
+         * one buffer instead of one UArray_T per block means a 1 x 1 block
+         * of one 64-bit word costs 8 bytes, not two heap objects
+         *
+         * a view shares the cells of the array it looks into: its cell
+         * (i, j) is cell (col0 + i, row0 + j) of that array, and only the
+         * array that made the buffer (the owner) frees it
          */
 };
-#line 94 "www/solutions/uarray2b.nw"
-#include <stdio.h>  /* include so we can print diagnostics */
+
+static inline size_t total_bytes(T array)
+{
+        return array->blockBytes * array->blocksWide * array->blocksHigh;
+}
+
+static inline char *block_at(T array, int bx, int by)
+{
+        return array->cells
+               + ((size_t)bx * array->blocksHigh + by) * array->blockBytes;
+}
+
+/* sets [*bx0, *bx1) x [*by0, *by1) to the blocks holding array's cells */
+static void block_span(T array, int *bx0, int *bx1, int *by0, int *by1)
+{
+        int b = array->blocksize;
+        *bx0 = array->col0 / b;
+        *by0 = array->row0 / b;
+        *bx1 = array->width  == 0 ? *bx0
+                                  : (array->col0 + array->width  - 1) / b + 1;
+        *by1 = array->height == 0 ? *by0
+                                  : (array->row0 + array->height - 1) / b + 1;
+}
+
+/* finds the part of block (bx, by) inside array: its first cell is (*i, *j)
+   of array and it is *cols x *rows cells. returns a pointer to that cell */
+static char *clip_block(T array, int bx, int by,
+                        int *i, int *j, int *cols, int *rows)
+{
+        int b  = array->blocksize;
+        int i0 = bx * b > array->col0 ? bx * b : array->col0;
+        int j0 = by * b > array->row0 ? by * b : array->row0;
+        int i1 = bx * b + b < array->col0 + array->width
+                 ? bx * b + b : array->col0 + array->width;
+        int j1 = by * b + b < array->row0 + array->height
+                 ? by * b + b : array->row0 + array->height;
+        *i    = i0 - array->col0;
+        *j    = j0 - array->row0;
+        *cols = i1 - i0;
+        *rows = j1 - j0;
+        return block_at(array, bx, by)
+               + ((size_t)(i0 - bx * b) * b + (j0 - by * b)) * array->size;
+}
 
 T UArray2b_new(int width, int height, int size, int blocksize)
 {
+        assert(width >= 0 && height >= 0 && size > 0);
         assert(blocksize > 0);
         T array;
         NEW(array);
@@ -38,46 +89,44 @@ T UArray2b_new(int width, int height, int size, int blocksize)
         array->height = height;
         array->size   = size;
         array->blocksize = blocksize;
-        array->blocks = UArray2_new((width  + blocksize - 1) / blocksize,
-                                    (height + blocksize - 1) / blocksize,
-                                    sizeof(UArray_T));
-        int xblocks = UArray2_width (array->blocks); 
-        int yblocks = UArray2_height(array->blocks);
-        for (int i = 0; i < xblocks; i++) {
-                for (int j = 0; j < yblocks; j++) {
-                        UArray_T *block = UArray2_at(array->blocks, i, j);
-                        *block = UArray_new(blocksize * blocksize, size);
-                        
-#line 169 "www/solutions/uarray2b.nw"
-if (0) {
-        fprintf(stderr, "Allocated %p; put %p at %p\n",
-                (void *)*block, (void *)*(UArray_T*)UArray2_at(array->blocks, i, j),
-                UArray2_at(array->blocks, i, j));
-}
-#line 115 "www/solutions/uarray2b.nw"
-                                  }
-        }
+        array->blocksWide = (width  + blocksize - 1) / blocksize;
+        array->blocksHigh = (height + blocksize - 1) / blocksize;
+        array->blockBytes = (size_t)blocksize * blocksize * size;
+        array->col0  = 0;
+        array->row0  = 0;
+        array->owner = true;
+
+        size_t nbytes = total_bytes(array);
+        array->cells = nbytes > 0 ? BigAlloc_new(nbytes) : NULL;
         return array;
 }
-#line 124 "www/solutions/uarray2b.nw"
+
 void UArray2b_free(T *array2b)
 {
-        int i;
         assert(array2b && *array2b);
-        T array = *array2b;
-        int xblocks = UArray2_width (array->blocks);
-        int yblocks = UArray2_height(array->blocks);
-        assert(UArray2_size(array->blocks) == sizeof(UArray_T));
-        for (i = 0; i < xblocks; i++) {
-                for (int j = 0; j < yblocks; j++) {
-                        UArray_T *p = UArray2_at(array->blocks, i, j);
-                        UArray_free(p);
-                }
+        if ((*array2b)->owner) {
+                BigAlloc_free((*array2b)->cells, total_bytes(*array2b));
         }
-        UArray2_free(&(*array2b)->blocks);
         FREE(*array2b);
 }
-#line 148 "www/solutions/uarray2b.nw"
+
+T UArray2b_view(T array2b, int col, int row, int width, int height)
+{
+        assert(array2b);
+        assert(col >= 0 && row >= 0 && width >= 0 && height >= 0);
+        assert(col + width  <= array2b->width);
+        assert(row + height <= array2b->height);
+        T view;
+        NEW(view);
+        *view = *array2b;
+        view->width  = width;
+        view->height = height;
+        view->col0   = array2b->col0 + col;
+        view->row0   = array2b->row0 + row;
+        view->owner  = false;
+        return view;
+}
+
 T UArray2b_new_64K_block(int width, int height, int size)
 {
         int blocksize = (int) floor(sqrt((double) (64 * 1024)
@@ -88,58 +137,124 @@ T UArray2b_new_64K_block(int width, int height, int size)
         /*  assert as big as possible */
         assert((blocksize + 1) * (blocksize + 1) * size > 64 * 1024);
         if (size <= 64 * 1024) { /* but no bigger */
-                assert(blocksize * blocksize * size <= 64 * 1024); 
+                assert(blocksize * blocksize * size <= 64 * 1024);
         }
         return UArray2b_new(width, height, size, blocksize);
 }
-#line 200 "www/solutions/uarray2b.nw"
+
 void *UArray2b_at(T array2b, int i, int j)
 {
         assert(i >= 0 && j >= 0);
         /* avoid unused cells */
         assert(i < array2b->width && j < array2b->height);
+        i += array2b->col0;
+        j += array2b->row0;
         int b  = array2b->blocksize;
         int bx = i / b;   /* block x coordinate */
         int by = j / b;   /* block y coordinate */
-        UArray_T *blockp = UArray2_at(array2b->blocks, bx, by);
-        return UArray_at(*blockp, (i % b) * b + j % b);
+        return block_at(array2b, bx, by)
+               + (size_t)((i % b) * b + j % b) * array2b->size;
 }
-#line 222 "www/solutions/uarray2b.nw"
-void UArray2b_map(T array2b, 
+
+/*
+ * the loops of the block maps, with VISIT run for each cell in terms of
+ * i0 + i, j0 + j and elem; UArray2b_map and UArray2b_small_map both
+ * expand them, so each calls its client straight from the inner loop
+ */
+#define MAP_CELLS(array2b, VISIT)                                            \
+        do {                                                                 \
+                int b    = (array2b)->blocksize;                             \
+                int size = (array2b)->size;                                  \
+                int bx0, bx1, by0, by1;                                      \
+                block_span((array2b), &bx0, &bx1, &by0, &by1);               \
+                                                                             \
+                for (int bx = bx0; bx < bx1; bx++) {                         \
+                        for (int by = by0; by < by1; by++) {                 \
+                                /* (i0, j0) is the first cell of block */    \
+                                /* (bx, by) inside array2b             */    \
+                                int i0, j0, cols, rows;                      \
+                                char *first = clip_block((array2b), bx, by,  \
+                                                         &i0, &j0, &cols,    \
+                                                         &rows);             \
+                                for (int i = 0; i < cols; i++) {             \
+                                        char *elem = first                   \
+                                                + (size_t)i * b * size;      \
+                                        for (int j = 0; j < rows; j++) {     \
+                                                VISIT;                       \
+                                                elem += size;                \
+                                        }                                    \
+                                }                                            \
+                        }                                                    \
+                }                                                            \
+        } while (0)
+
+void UArray2b_map(T array2b,
                   void apply(int col, int row, T array2b,
                              void *elem, void *cl),
                   void *cl)
 {
         assert(array2b);
-        int       h      = array2b->height;
-        int       w      = array2b->width;
-        int       b      = array2b->blocksize;
-        UArray2_T blocks = array2b->blocks;
-        int       bw     = UArray2_width(blocks);
-        int       bh     = UArray2_height(blocks);
-
-        for (int bx = 0; bx < bw; bx++) {
-                for (int by = 0; by < bh; by++) {
-                        UArray_T *blockp = UArray2_at(blocks, bx, by);
-                        UArray_T  block  = *blockp;
-                        int       len    = UArray_length(block);
-                        /* (i0, j0) correspond to upper left */
-                        /* corner of block (bx, by)          */
-                        int i0 = b * bx; 
-                        int j0 = b * by; 
-                        for (int cell = 0; cell < len; cell++) {
-                                int i = i0 + cell / b;
-                                int j = j0 + cell % b;
-                                /* measured overhead 0.5% to 1.5% */
-                                if (i < w && j < h) {
-                                        apply(i, j, array2b, 
-                                              UArray_at(block, cell), cl);
-                                }
-                        }
+        MAP_CELLS(array2b, apply(i0 + i, j0 + j, array2b, elem, cl));
+}
+
+void UArray2b_small_map(T array2b, void apply(void *elem, void *cl),
+                        void *cl)
+{
+        assert(array2b);
+        MAP_CELLS(array2b, apply(elem, cl));
+}
+
+#undef MAP_CELLS
+
+/* Cells within a block are stored column by column, so a step to the next
+   column skips a whole block column and a step to the next row is one cell */
+void UArray2b_map_blocks(T array2b,
+                         void apply(int col, int row, int width, int height,
+                                    void *elems, int colstride, int rowstride,
+                                    T array2b, void *cl),
+                         void *cl)
+{
+        assert(array2b);
+        int b    = array2b->blocksize;
+        int size = array2b->size;
+        int bx0, bx1, by0, by1;
+        block_span(array2b, &bx0, &bx1, &by0, &by1);
+
+        for (int bx = bx0; bx < bx1; bx++) {
+                for (int by = by0; by < by1; by++) {
+                        int i0, j0, cols, rows;
+                        char *first = clip_block(array2b, bx, by,
+                                                 &i0, &j0, &cols, &rows);
+                        apply(i0, j0, cols, rows, first,
+                              b * size, size, array2b, cl);
                 }
         }
 }
-#line 269 "www/solutions/uarray2b.nw"
+
+/* the number of blocks, including partial blocks along the edges */
+int UArray2b_blockcount(T array2b)
+{
+        assert(array2b);
+        int bx0, bx1, by0, by1;
+        block_span(array2b, &bx0, &bx1, &by0, &by1);
+        return (bx1 - bx0) * (by1 - by0);
+}
+
+/* block n of UArray2b_map_blocks, counting in the order it visits them:
+   down each column of blocks, left to right */
+void *UArray2b_block(T array2b, int n, int *col, int *row, int *width,
+                     int *height, int *colstride, int *rowstride)
+{
+        assert(array2b);
+        assert(0 <= n && n < UArray2b_blockcount(array2b));
+        int bx0, bx1, by0, by1;
+        block_span(array2b, &bx0, &bx1, &by0, &by1);
+        *colstride = array2b->blocksize * array2b->size;
+        *rowstride = array2b->size;
+        return clip_block(array2b, bx0 + n / (by1 - by0),
+                          by0 + n % (by1 - by0), col, row, width, height);
+}
+
 int UArray2b_height(T array2b)
 {
         assert(array2b);
@@ -162,5 +277,3 @@ int UArray2b_blocksize(T array2b)
         assert(array2b);
         return array2b->blocksize;
 }
-#line 296 "www/solutions/uarray2b.nw"
-int UArray2b_version_uses_UArray2_T = 1;
\ No newline at end of file
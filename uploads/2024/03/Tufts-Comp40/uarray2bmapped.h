@@ -0,0 +1,85 @@
+/*
+ *     uarray2bmapped.h
+ *     locality
+ *
+ *     A two dimensional blocked array whose blocks live in a memory-mapped
+ *     scratch file instead of anonymous memory, for images larger than RAM.
+ *     The kernel can write the array's pages back to the file and drop
+ *     them, rather than pushing the rest of the machine into swap.
+ *
+ *     The layout is the slab layout of uarray2bslab.h: cells within a block
+ *     row by row, blocks in row-major order of blocks, all back to back.
+ *     Blocks of a page or more start on a page boundary and cover whole
+ *     pages; smaller blocks are padded to a power of two, so no block
+ *     straddles a page. The maps ask the kernel to read ahead of the
+ *     traversal; at() leaves paging to the kernel's own read-around.
+ *
+ *     The scratch file is created in $TMPDIR (or /tmp) and unlinked at
+ *     once, so it disappears with the array or the process. That directory
+ *     should be on a disk rather than tmpfs. Running out of disk space while
+ *     writing to the array kills the program with SIGBUS.
+ *
+ *     An array can also be saved as a snapshot: a 64K header holding its
+ *     dimensions, element size, blocksize and one word for the client,
+ *     followed by the blocks exactly as they lie in memory. Loading a
+ *     snapshot maps the file copy-on-write instead of reading it, so cells
+ *     come in from the page cache as they are touched and writes to the
+ *     loaded array never reach the file. Snapshots are only portable between
+ *     machines of the same byte order.
+ */
+
+#ifndef UARRAY2BMAPPED_INCLUDED
+#define UARRAY2BMAPPED_INCLUDED
+
+#include <stdio.h>
+
+#define T UArray2bMapped_T
+typedef struct T *T;
+
+/* zeroed arrays; failing to create, reserve space for or map the scratch
+   file is a checked runtime error in every build, reported on stderr */
+extern T    UArray2bMapped_new(int width, int height, int size,
+                               int blocksize);
+extern T    UArray2bMapped_new_64K_block(int width, int height, int size);
+extern void UArray2bMapped_free(T *array2b);
+
+extern int  UArray2bMapped_width    (T array2b);
+extern int  UArray2bMapped_height   (T array2b);
+extern int  UArray2bMapped_size     (T array2b);
+extern int  UArray2bMapped_blocksize(T array2b);
+
+extern void *UArray2bMapped_at(T array2b, int col, int row);
+
+/* visits every cell in storage order: block by block, rows within a block */
+extern void  UArray2bMapped_map(T array2b, void apply(int col, int row,
+                                T array2b, void *elem, void *cl), void *cl);
+
+/* calls apply once per block, in storage order, with the block's origin,
+   its clipped extent and a pointer to its first cell */
+extern void  UArray2bMapped_map_blocks(T array2b, void apply(int col,
+                                int row, int width, int height, void *elems,
+                                int colstride, int rowstride, T array2b,
+                                void *cl), void *cl);
+
+/* the number of blocks, counting partial blocks along the edges */
+extern int   UArray2bMapped_blockcount(T array2b);
+
+/* what UArray2bMapped_map_blocks passes for block n, in storage order:
+   returns the pointer and stores the rest */
+extern void *UArray2bMapped_block(T array2b, int n, int *col, int *row,
+                                  int *width, int *height, int *colstride,
+                                  int *rowstride);
+
+/* writes array2b to fp as a snapshot, with tag kept alongside the cells.
+   returns 0 if a write or the flush failed, 1 otherwise */
+extern int   UArray2bMapped_save(T array2b, unsigned tag, FILE *fp);
+
+/* the array saved in the snapshot fp is open on, with its tag stored in
+   *tag; fp's position is not used or moved. returns NULL, reading nothing
+   through fp, when fp is not a regular file starting with a snapshot
+   header. a header that does not fit the file, or a failed mapping, is
+   reported on stderr and exits, with or without NDEBUG */
+extern T     UArray2bMapped_load(FILE *fp, unsigned *tag);
+
+#undef T
+#endif
@@ -0,0 +1,149 @@
+#include "assert.h"
+#include "mem.h"
+#include "uarray2bplanar.h"
+
+#define T UArray2bPlanar_T
+
+struct T { /* 'planes' UArray2bs of one shape, one per channel */
+        int planes;
+        UArray2b_T *plane;
+        /*
+         * none of the planes is a view, and all have the same width,
+         * height, size and blocksize, so a cell lies at the same byte
+         * offset from the start of every plane's buffer
+         */
+};
+
+T UArray2bPlanar_new(int width, int height, int planes, int size,
+                     int blocksize)
+{
+        assert(planes > 0);
+        T planar;
+        NEW(planar);
+        planar->planes = planes;
+        planar->plane = ALLOC(planes * sizeof(*planar->plane));
+        for (int p = 0; p < planes; p++) {
+                planar->plane[p] = UArray2b_new(width, height, size,
+                                                blocksize);
+        }
+        return planar;
+}
+
+void UArray2bPlanar_free(T *planar)
+{
+        assert(planar && *planar);
+        for (int p = 0; p < (*planar)->planes; p++) {
+                UArray2b_free(&(*planar)->plane[p]);
+        }
+        FREE((*planar)->plane);
+        FREE(*planar);
+}
+
+int UArray2bPlanar_width(T planar)
+{
+        assert(planar);
+        return UArray2b_width(planar->plane[0]);
+}
+
+int UArray2bPlanar_height(T planar)
+{
+        assert(planar);
+        return UArray2b_height(planar->plane[0]);
+}
+
+int UArray2bPlanar_planes(T planar)
+{
+        assert(planar);
+        return planar->planes;
+}
+
+int UArray2bPlanar_size(T planar)
+{
+        assert(planar);
+        return UArray2b_size(planar->plane[0]);
+}
+
+int UArray2bPlanar_blocksize(T planar)
+{
+        assert(planar);
+        return UArray2b_blocksize(planar->plane[0]);
+}
+
+UArray2b_T UArray2bPlanar_plane(T planar, int p)
+{
+        assert(planar);
+        assert(p >= 0 && p < planar->planes);
+        return planar->plane[p];
+}
+
+void UArray2bPlanar_map_plane(T planar, int p,
+                              void apply(int col, int row, UArray2b_T plane,
+                                         void *elem, void *cl),
+                              void *cl)
+{
+        UArray2b_map(UArray2bPlanar_plane(planar, p), apply, cl);
+}
+
+void UArray2bPlanar_map_plane_blocks(T planar, int p,
+                                     void apply(int col, int row,
+                                                int width, int height,
+                                                void *elems, int colstride,
+                                                int rowstride,
+                                                UArray2b_T plane, void *cl),
+                                     void *cl)
+{
+        UArray2b_map_blocks(UArray2bPlanar_plane(planar, p), apply, cl);
+}
+
+/* the closure of UArray2bPlanar_map_blocks' walk over plane 0 */
+struct planes_closure {
+        T planar;
+        char **first;   /* block 0's first cell in each plane */
+        void **elems;   /* the current block's first cell in each plane */
+        void (*apply)(int col, int row, int width, int height, void **elems,
+                      int colstride, int rowstride, T planar, void *cl);
+        void *cl;
+};
+
+static void apply_planes(int col, int row, int width, int height,
+                         void *elems, int colstride, int rowstride,
+                         UArray2b_T plane, void *cl)
+{
+        (void)plane;
+        struct planes_closure *pcl = cl;
+        size_t offset = (char *)elems - pcl->first[0];
+        for (int p = 0; p < pcl->planar->planes; p++) {
+                pcl->elems[p] = pcl->first[p] + offset;
+        }
+        pcl->apply(col, row, width, height, pcl->elems, colstride,
+                   rowstride, pcl->planar, pcl->cl);
+}
+
+/* plane 0 is walked block by block, and the other planes' blocks are found
+   at the same offsets, rather than walking every plane */
+void UArray2bPlanar_map_blocks(T planar,
+                               void apply(int col, int row,
+                                          int width, int height,
+                                          void **elems, int colstride,
+                                          int rowstride, T planar,
+                                          void *cl),
+                               void *cl)
+{
+        assert(planar);
+        if (UArray2b_blockcount(planar->plane[0]) == 0) {
+                return;
+        }
+        int planes = planar->planes;
+        char **first = ALLOC(planes * sizeof(*first));
+        void **elems = ALLOC(planes * sizeof(*elems));
+        for (int p = 0; p < planes; p++) {
+                int col, row, width, height, colstride, rowstride;
+                first[p] = UArray2b_block(planar->plane[p], 0, &col, &row,
+                                          &width, &height, &colstride,
+                                          &rowstride);
+        }
+        struct planes_closure pcl = { planar, first, elems, apply, cl };
+        UArray2b_map_blocks(planar->plane[0], apply_planes, &pcl);
+        FREE(elems);
+        FREE(first);
+}
@@ -0,0 +1,63 @@
+#ifndef UARRAY2BPLANAR_INCLUDED
+#define UARRAY2BPLANAR_INCLUDED
+
+/*
+ * UArray2bPlanar: a two dimensional array of pixels with several channels,
+ * each channel kept in a plane of its own. Every plane is a UArray2b of the
+ * same width, height, element size and block size, so a block of one plane
+ * covers the same cells as that block of every other plane, and the values
+ * of one channel in a block are packed together instead of interleaved
+ * with the other channels.
+ *
+ * A plane can be used on its own, with the UArray2b functions or as an
+ * A2Methods_UArray2 of uarray2_methods_blocked, but belongs to the planar
+ * array: it must not be freed, and it goes away with the planar array.
+ */
+
+#include "uarray2b.h"
+
+#define T UArray2bPlanar_T
+typedef struct T *T;
+
+/* planes > 0 planes of size-byte cells, all blocked with blocksize */
+extern T    UArray2bPlanar_new(int width, int height, int planes, int size,
+                               int blocksize);
+extern void UArray2bPlanar_free(T *planar);
+
+extern int  UArray2bPlanar_width    (T planar);
+extern int  UArray2bPlanar_height   (T planar);
+extern int  UArray2bPlanar_planes   (T planar);
+extern int  UArray2bPlanar_size     (T planar);
+extern int  UArray2bPlanar_blocksize(T planar);
+
+/* plane p, for 0 <= p < planes */
+extern UArray2b_T UArray2bPlanar_plane(T planar, int p);
+
+/* the maps of plane p alone, with UArray2b_map's and UArray2b_map_blocks'
+   order and arguments */
+extern void UArray2bPlanar_map_plane(T planar, int p,
+                                     void apply(int col, int row,
+                                                UArray2b_T plane, void *elem,
+                                                void *cl),
+                                     void *cl);
+extern void UArray2bPlanar_map_plane_blocks(T planar, int p,
+                                            void apply(int col, int row,
+                                                int width, int height,
+                                                void *elems, int colstride,
+                                                int rowstride,
+                                                UArray2b_T plane, void *cl),
+                                            void *cl);
+
+/* calls apply once per block, in UArray2b_map_blocks order, with elems[p]
+   pointing to the block's first cell in plane p; the strides are the same
+   in every plane */
+extern void UArray2bPlanar_map_blocks(T planar,
+                                      void apply(int col, int row,
+                                                 int width, int height,
+                                                 void **elems, int colstride,
+                                                 int rowstride, T planar,
+                                                 void *cl),
+                                      void *cl);
+
+#undef T
+#endif